@@ -0,0 +1,55 @@
+#include "bench/allocation_counter.h"
+#include <cstdlib>
+#include <new>
+
+namespace authservice {
+namespace bench {
+namespace {
+thread_local uint64_t allocations = 0;
+}  // namespace
+
+void CountAllocation() { ++allocations; }
+
+uint64_t AllocationCount() { return allocations; }
+
+AllocationCounter::AllocationCounter(benchmark::State &state)
+    : state_(state), start_(AllocationCount()) {}
+
+AllocationCounter::~AllocationCounter() {
+  state_.counters["allocs"] =
+      benchmark::Counter(static_cast<double>(AllocationCount() - start_),
+                         benchmark::Counter::kAvgIterations);
+}
+
+}  // namespace bench
+}  // namespace authservice
+
+// Replace the global allocation functions so every allocation made by the
+// code under benchmark is counted.
+void *operator new(std::size_t size) {
+  authservice::bench::CountAllocation();
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  authservice::bench::CountAllocation();
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
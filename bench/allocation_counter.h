@@ -0,0 +1,37 @@
+#ifndef AUTHSERVICE_BENCH_ALLOCATION_COUNTER_H_
+#define AUTHSERVICE_BENCH_ALLOCATION_COUNTER_H_
+#include <cstdint>
+#include "benchmark/benchmark.h"
+
+namespace authservice {
+namespace bench {
+
+/**
+ * CountAllocation records a heap allocation made by the calling thread. Called from the replacement operator new.
+ */
+void CountAllocation();
+
+/**
+ * AllocationCount returns the number of heap allocations made through operator new by the calling thread.
+ * @return the number of allocations.
+ */
+uint64_t AllocationCount();
+
+/**
+ * AllocationCounter reports the average number of heap allocations per benchmark iteration as the `allocs`
+ * counter. Construct it immediately before the benchmark loop; the counter is reported when it goes out of scope.
+ */
+class AllocationCounter {
+ private:
+  benchmark::State &state_;
+  uint64_t start_;
+
+ public:
+  explicit AllocationCounter(benchmark::State &state);
+  ~AllocationCounter();
+};
+
+}  // namespace bench
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_BENCH_ALLOCATION_COUNTER_H_
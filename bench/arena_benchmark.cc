@@ -0,0 +1,51 @@
+#include <memory>
+#include "benchmark/benchmark.h"
+#include "bench/allocation_counter.h"
+#include "bench/fixtures.h"
+#include "src/common/utilities/arena.h"
+#include "src/service/service_impl.h"
+
+namespace authservice {
+namespace bench {
+
+// Each call's messages deserialized into, and built on, the heap.
+void BM_CheckHeapMessages(benchmark::State &state) {
+  service::AuthServiceImpl service(BenchmarkConfig());
+  auto wire = TypicalRequest().SerializeAsString();
+
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    ::envoy::service::auth::v2::CheckRequest request;
+    request.ParseFromString(wire);
+    ::envoy::service::auth::v2::CheckResponse response;
+    benchmark::DoNotOptimize(service.TryCheck(nullptr, &request, &response));
+  }
+}
+BENCHMARK(BM_CheckHeapMessages);
+
+// Each call's messages allocated from a recycled arena, as the async server
+// does.
+void BM_CheckArenaMessages(benchmark::State &state) {
+  service::AuthServiceImpl service(BenchmarkConfig());
+  auto wire = TypicalRequest().SerializeAsString();
+  std::unique_ptr<char[]> block(new char[16 * 1024]);
+  google::protobuf::ArenaOptions options;
+  options.initial_block = block.get();
+  options.initial_block_size = 16 * 1024;
+  google::protobuf::Arena arena(options);
+
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    auto request = common::utilities::CreateOnArena<
+        ::envoy::service::auth::v2::CheckRequest>(&arena);
+    request->ParseFromString(wire);
+    auto response = common::utilities::CreateOnArena<
+        ::envoy::service::auth::v2::CheckResponse>(&arena);
+    benchmark::DoNotOptimize(service.TryCheck(nullptr, request, response));
+    arena.Reset();
+  }
+}
+BENCHMARK(BM_CheckArenaMessages);
+
+}  // namespace bench
+}  // namespace authservice
@@ -0,0 +1,66 @@
+#include <memory>
+#include <string>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "bench/fixtures.h"
+#include "src/filters/chain_index.h"
+#include "src/filters/filter_chain.h"
+
+namespace authservice {
+namespace bench {
+namespace {
+// A configuration of the given number of chains without filters, alternating
+// equality and prefix matches on the tenant header. The last chain expects the
+// benchmark tenant, so finding it visits every chain in a linear scan.
+config::Config DispatchConfig(int64_t count) {
+  config::Config config;
+  for (int64_t i = 0; i < count; ++i) {
+    auto chain = config.add_chains();
+    chain->set_name("chain" + std::to_string(i));
+    chain->mutable_match()->set_header("x-tenant-identifier");
+    if (i == count - 1) {
+      chain->mutable_match()->set_equality("tenant1");
+    } else if (i % 2 == 0) {
+      chain->mutable_match()->set_equality("other" + std::to_string(i));
+    } else {
+      chain->mutable_match()->set_prefix("group" + std::to_string(i) + "-");
+    }
+  }
+  return config;
+}
+}  // namespace
+
+// Checks each chain in order, which is how chains were selected before the
+// index.
+void BM_DispatchLinear(benchmark::State &state) {
+  auto config = DispatchConfig(state.range(0));
+  std::vector<std::unique_ptr<filters::FilterChainImpl>> chains;
+  for (const auto &chain : config.chains()) {
+    chains.emplace_back(new filters::FilterChainImpl(chain));
+  }
+  auto request = CookieRequest();
+  for (auto _ : state) {
+    filters::FilterChain *found = nullptr;
+    for (const auto &chain : chains) {
+      if (chain->Matches(&request)) {
+        found = chain.get();
+        break;
+      }
+    }
+    benchmark::DoNotOptimize(found);
+  }
+}
+BENCHMARK(BM_DispatchLinear)->Arg(1)->Arg(100)->Arg(10000);
+
+void BM_DispatchIndexed(benchmark::State &state) {
+  auto config = DispatchConfig(state.range(0));
+  filters::ChainIndex index(config.chains());
+  auto request = CookieRequest();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(index.Find(&request));
+  }
+}
+BENCHMARK(BM_DispatchIndexed)->Arg(1)->Arg(100)->Arg(10000);
+
+}  // namespace bench
+}  // namespace authservice
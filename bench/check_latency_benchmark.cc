@@ -0,0 +1,55 @@
+#include <future>
+#include <thread>
+#include "benchmark/benchmark.h"
+#include "bench/fixtures.h"
+#include "bench/latency_recorder.h"
+#include "src/service/service_impl.h"
+
+namespace authservice {
+namespace bench {
+
+// Every request handed to a co-routine on an io_context worker thread, which
+// is how all requests were processed before the synchronous fast path.
+void BM_CookieCheckSpawned(benchmark::State &state) {
+  service::AuthServiceImpl service(BenchmarkConfig());
+  auto request = CookieRequest();
+  boost::asio::io_context ioc;
+  auto work = std::make_shared<boost::asio::io_context::work>(ioc);
+  std::thread worker([&ioc]() { ioc.run(); });
+
+  common::utilities::Deadline deadline;
+  LatencyRecorder latencies(state);
+  for (auto _ : state) {
+    auto start = std::chrono::steady_clock::now();
+    std::promise<::grpc::Status> done;
+    boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+      ::envoy::service::auth::v2::CheckResponse response;
+      done.set_value(service.Check(nullptr, &request, &response, deadline, ioc, yield));
+    });
+    benchmark::DoNotOptimize(done.get_future().get());
+    latencies.Record(std::chrono::steady_clock::now() - start);
+  }
+
+  work.reset();
+  worker.join();
+}
+BENCHMARK(BM_CookieCheckSpawned)->UseRealTime();
+
+// Requests decided on the calling thread, as the completion queue threads now
+// do for requests that need no I/O.
+void BM_CookieCheckInline(benchmark::State &state) {
+  service::AuthServiceImpl service(BenchmarkConfig());
+  auto request = CookieRequest();
+
+  LatencyRecorder latencies(state);
+  for (auto _ : state) {
+    auto start = std::chrono::steady_clock::now();
+    ::envoy::service::auth::v2::CheckResponse response;
+    benchmark::DoNotOptimize(service.TryCheck(nullptr, &request, &response));
+    latencies.Record(std::chrono::steady_clock::now() - start);
+  }
+}
+BENCHMARK(BM_CookieCheckInline)->UseRealTime();
+
+}  // namespace bench
+}  // namespace authservice
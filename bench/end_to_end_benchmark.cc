@@ -0,0 +1,116 @@
+// Checks of each kind of request a browser sends, made through the service
+// and filter chains built from bench/load-config.json, with the OIDC
+// Provider replaced by an in-memory one so that no time is spent on I/O.
+// Each benchmark runs on 1 up to as many threads as there are cores, sharing
+// one service as the server's threads do, so contention between checks shows
+// up as throughput that stops growing with the number of threads.
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "absl/strings/match.h"
+#include "bench/allocation_counter.h"
+#include "bench/in_memory_idp.h"
+#include "bench/requests.h"
+#include "spdlog/spdlog.h"
+#include "src/common/http/headers.h"
+#include "src/config/get_config.h"
+#include "src/service/service_impl.h"
+
+namespace authservice {
+namespace bench {
+namespace {
+const char *config_path = "bench/load-config.json";
+
+bool HasHeader(const ::google::protobuf::RepeatedPtrField<::envoy::api::v2::core::HeaderValueOption> &headers,
+               absl::string_view name, absl::string_view containing = "") {
+  return std::any_of(headers.begin(), headers.end(), [name, containing](const auto &header) {
+    return header.header().key() == name && absl::StrContains(header.header().value(), containing);
+  });
+}
+
+// Whether the response is the one a request of the kind should get, so that no benchmark measures a failure.
+bool Succeeded(RequestKind kind, const ::envoy::service::auth::v2::CheckResponse &response) {
+  switch (kind) {
+    case RequestKind::cookie:
+      return HasHeader(response.ok_response().headers(), common::http::headers::Authorization);
+    case RequestKind::callback:
+      return HasHeader(response.denied_response().headers(), common::http::headers::SetCookie, "-id-token-cookie=") &&
+             !HasHeader(response.denied_response().headers(), common::http::headers::SetCookie,
+                        "-id-token-cookie=deleted");
+    default:
+      return HasHeader(response.denied_response().headers(), common::http::headers::Location);
+  }
+}
+
+// The service and the requests it is sent, built once and shared by every benchmark and thread.
+struct Server {
+  std::unique_ptr<config::Config> config;
+  std::unique_ptr<RequestFactory> requests;
+  std::unique_ptr<service::AuthServiceImpl> service;
+
+  Server() : config(config::GetConfig(config_path)), requests(new RequestFactory(*config)) {
+    spdlog::set_level(config::GetConfiguredLogLevel(*config));
+    // Stands in for the IdP of the chain the requests are built for.
+    std::shared_ptr<InMemoryIdp> idp;
+    for (const auto &chain : config->chains()) {
+      for (const auto &filter : chain.filters()) {
+        if (idp == nullptr && filter.has_oidc()) {
+          idp = std::make_shared<InMemoryIdp>(filter.oidc(), std::vector<std::string>{callback_code});
+        }
+      }
+    }
+    service.reset(new service::AuthServiceImpl(*config, idp));
+
+    // The chain fetches the IdP's keys in the background, and callbacks fail until it has them.
+    auto callback = requests->Build(RequestKind::callback);
+    for (int i = 0; i < 500; ++i) {
+      ::envoy::service::auth::v2::CheckResponse response;
+      service->Check(nullptr, &callback, &response);
+      if (Succeeded(RequestKind::callback, response)) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+};
+
+Server &GetServer() {
+  static Server server;
+  return server;
+}
+
+int MaxThreads() { return static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); }
+}  // namespace
+
+void BM_Check(benchmark::State &state, RequestKind kind) {
+  auto &server = GetServer();
+  auto request = server.requests->Build(kind);
+  ::envoy::service::auth::v2::CheckResponse first;
+  server.service->Check(nullptr, &request, &first);
+  if (!Succeeded(kind, first)) {
+    // The loop still runs, without iterating, so that the other threads are not left waiting for this one.
+    state.SkipWithError("the check did not take the expected path");
+  }
+
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    ::envoy::service::auth::v2::CheckResponse response;
+    benchmark::DoNotOptimize(server.service->Check(nullptr, &request, &response));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+// Allowed with the session cookies, decrypted once and then served from the session cache.
+BENCHMARK_CAPTURE(BM_Check, cookie, RequestKind::cookie)->ThreadRange(1, MaxThreads())->UseRealTime();
+// Redirected to the IdP with a new state and nonce in an encrypted state cookie.
+BENCHMARK_CAPTURE(BM_Check, redirect, RequestKind::redirect)->ThreadRange(1, MaxThreads())->UseRealTime();
+// Exchanges the authorization code for tokens, verifies the id token and sets the session cookies. Made in a
+// co-routine on an io_context of the check's own, as the synchronous Check does.
+BENCHMARK_CAPTURE(BM_Check, callback, RequestKind::callback)->ThreadRange(1, MaxThreads())->UseRealTime();
+// Deletes the session cookies and redirects to the logout page.
+BENCHMARK_CAPTURE(BM_Check, logout, RequestKind::logout)->ThreadRange(1, MaxThreads())->UseRealTime();
+
+}  // namespace bench
+}  // namespace authservice
@@ -0,0 +1,36 @@
+#include "benchmark/benchmark.h"
+#include "bench/allocation_counter.h"
+#include "bench/fixtures.h"
+#include "src/filters/filter_chain.h"
+#include "src/service/service_impl.h"
+
+namespace authservice {
+namespace bench {
+
+// Builds the chain's filters for every request, which is what each Check did
+// before chains were built once at configuration time.
+void BM_CheckWithPerRequestFilters(benchmark::State &state) {
+  auto config = BenchmarkConfig();
+  auto request = CookieRequest();
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    ::envoy::service::auth::v2::CheckResponse response;
+    filters::FilterChainImpl chain(config.chains(0));
+    benchmark::DoNotOptimize(chain.Instance().Process(&request, &response));
+  }
+}
+BENCHMARK(BM_CheckWithPerRequestFilters);
+
+void BM_CheckWithPrebuiltFilters(benchmark::State &state) {
+  service::AuthServiceImpl service(BenchmarkConfig());
+  auto request = CookieRequest();
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    ::envoy::service::auth::v2::CheckResponse response;
+    benchmark::DoNotOptimize(service.Check(nullptr, &request, &response));
+  }
+}
+BENCHMARK(BM_CheckWithPrebuiltFilters);
+
+}  // namespace bench
+}  // namespace authservice
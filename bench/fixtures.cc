@@ -0,0 +1,132 @@
+#include "bench/fixtures.h"
+#include <algorithm>
+#include "absl/strings/str_cat.h"
+#include "src/common/http/headers.h"
+#include "src/common/session/token_encryptor.h"
+
+namespace authservice {
+namespace bench {
+namespace {
+const char *tenant_header = "x-tenant-identifier";
+const char *tenant = "tenant1";
+const char *cryptor_secret = "some-secret";
+
+void SetEndpoint(config::common::Endpoint *endpoint, const char *path) {
+  endpoint->set_scheme("https");
+  endpoint->set_hostname("acme-idp.tld");
+  endpoint->set_port(443);
+  endpoint->set_path(path);
+}
+}  // namespace
+
+config::Config BenchmarkConfig() {
+  config::Config config;
+  auto chain = config.add_chains();
+  chain->set_name("benchmark-chain");
+  chain->mutable_match()->set_header(tenant_header);
+  chain->mutable_match()->set_equality(tenant);
+  auto oidc = chain->add_filters()->mutable_oidc();
+  SetEndpoint(oidc->mutable_authorization(), "/authorization");
+  SetEndpoint(oidc->mutable_token(), "/token");
+  SetEndpoint(oidc->mutable_callback(), "/callback");
+  oidc->set_jwks("some-jwks");
+  oidc->set_client_id("example-app");
+  oidc->set_client_secret("example-app-secret");
+  oidc->set_cryptor_secret(cryptor_secret);
+  oidc->set_landing_page("/landing-page");
+  oidc->set_cookie_name_prefix("benchmark");
+  oidc->mutable_id_token()->set_header("authorization");
+  oidc->mutable_id_token()->set_preamble("Bearer");
+  oidc->set_timeout(300);
+  return config;
+}
+
+::envoy::service::auth::v2::CheckRequest CookieRequest() {
+  auto cryptor = common::session::TokenEncryptor::Create(
+      cryptor_secret, common::session::EncryptionAlg::AES256GCM,
+      common::session::HKDFHash::SHA512);
+  ::envoy::service::auth::v2::CheckRequest request;
+  auto http = request.mutable_attributes()->mutable_request()->mutable_http();
+  http->set_scheme("https");
+  http->set_host("me.tld");
+  http->set_path("/resource");
+  auto headers = http->mutable_headers();
+  headers->insert({tenant_header, tenant});
+  headers->insert({common::http::headers::Cookie,
+                   "__Host-benchmark-authservice-id-token-cookie=" +
+                       cryptor->Encrypt("header.payload.signature")});
+  return request;
+}
+
+::envoy::service::auth::v2::CheckRequest TypicalRequest() {
+  auto request = CookieRequest();
+  auto headers = request.mutable_attributes()
+                     ->mutable_request()
+                     ->mutable_http()
+                     ->mutable_headers();
+  headers->insert({":authority", "me.tld"});
+  headers->insert({":method", "GET"});
+  headers->insert({":path", "/resource"});
+  headers->insert({":scheme", "https"});
+  headers->insert({"accept",
+                   "text/html,application/xhtml+xml,application/xml;q=0.9,"
+                   "image/webp,*/*;q=0.8"});
+  headers->insert({"accept-encoding", "gzip, deflate, br"});
+  headers->insert({"accept-language", "en-US,en;q=0.5"});
+  headers->insert({"cache-control", "max-age=0"});
+  headers->insert({"connection", "keep-alive"});
+  headers->insert({"dnt", "1"});
+  headers->insert({"referer", "https://me.tld/landing-page"});
+  headers->insert({"sec-fetch-dest", "document"});
+  headers->insert({"sec-fetch-mode", "navigate"});
+  headers->insert({"sec-fetch-site", "same-origin"});
+  headers->insert({"sec-fetch-user", "?1"});
+  headers->insert({"upgrade-insecure-requests", "1"});
+  headers->insert({"user-agent",
+                   "Mozilla/5.0 (X11; Linux x86_64; rv:72.0) Gecko/20100101 "
+                   "Firefox/72.0"});
+  headers->insert({"x-b3-parentspanid", "8b5d6f2a1c3e4f70"});
+  headers->insert({"x-b3-sampled", "1"});
+  headers->insert({"x-b3-spanid", "5e0c7d9a3b1f2468"});
+  headers->insert({"x-b3-traceid", "463ac35c9f6413ad48485a3953bb6124"});
+  headers->insert({"x-envoy-expected-rq-timeout-ms", "15000"});
+  headers->insert({"x-envoy-internal", "true"});
+  headers->insert({"x-forwarded-for", "10.0.0.1"});
+  headers->insert({"x-forwarded-proto", "https"});
+  headers->insert({"x-request-id", "1b4e28ba-2fa1-11d2-883f-0016d3cca427"});
+  headers->insert({"x-real-ip", "10.0.0.1"});
+  headers->insert({"pragma", "no-cache"});
+  return request;
+}
+
+std::string Jwt(size_t size) {
+  // The header is as short as real ones, the signature as long as an RS256 one, and the payload takes the rest.
+  const size_t header = 36;
+  const size_t signature = 342;
+  if (size < header + signature + 3) {
+    auto third = (size - 2) / 3;
+    return std::string(third, 'h') + "." + std::string(size - 2 - 2 * third, 'p') + "." + std::string(third, 's');
+  }
+  return std::string(header, 'h') + "." + std::string(size - header - signature - 2, 'p') + "." +
+         std::string(signature, 's');
+}
+
+std::string CookieHeader(size_t size) {
+  auto cryptor = common::session::TokenEncryptor::Create(
+      cryptor_secret, common::session::EncryptionAlg::AES256GCM,
+      common::session::HKDFHash::SHA512);
+  auto header = absl::StrCat(
+      "__Host-benchmark-authservice-id-token-cookie=", cryptor->Encrypt(Jwt(1536)),
+      "; __Host-benchmark-authservice-access-token-cookie=", cryptor->Encrypt(Jwt(768)));
+  for (int i = 0; header.size() < size; ++i) {
+    auto name = absl::StrCat("; app-preference-", i, "=");
+    // The last value is cut short to make the header the size, when there is room for one.
+    auto remaining = size - header.size();
+    auto value = remaining > name.size() ? std::min<size_t>(48, remaining - name.size()) : 1;
+    absl::StrAppend(&header, name, std::string(value, 'v'));
+  }
+  return header;
+}
+
+}  // namespace bench
+}  // namespace authservice
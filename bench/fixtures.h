@@ -0,0 +1,54 @@
+#ifndef AUTHSERVICE_BENCH_FIXTURES_H_
+#define AUTHSERVICE_BENCH_FIXTURES_H_
+#include <string>
+#include "config/config.pb.h"
+#include "envoy/service/auth/v2/external_auth.grpc.pb.h"
+
+namespace authservice {
+namespace bench {
+
+/**
+ * BenchmarkConfig returns a configuration with a single OIDC filter chain
+ * matching requests from the benchmark tenant.
+ * @return the configuration.
+ */
+config::Config BenchmarkConfig();
+
+/**
+ * CookieRequest returns a request for the benchmark tenant carrying a valid
+ * id token cookie, the most common request seen in production.
+ * @return the request.
+ */
+::envoy::service::auth::v2::CheckRequest CookieRequest();
+
+/**
+ * TypicalRequest returns CookieRequest with further headers of the kind a
+ * browser and the Envoy proxy add, 30 in total.
+ * @return the request.
+ */
+::envoy::service::auth::v2::CheckRequest TypicalRequest();
+
+/**
+ * Jwt returns a string shaped like a JWT, three base64url segments separated
+ * by dots, of the given size. Id tokens carrying a user's groups and profile
+ * are commonly around 1.5 KB.
+ * @param size the size in bytes, at least 5.
+ * @return the token.
+ */
+std::string Jwt(size_t size);
+
+/**
+ * CookieHeader returns a Cookie header value of the given size, as a browser
+ * sends it to an application behind the benchmark tenant's chain: the id token
+ * and access token session cookies, encrypted, followed by the application's
+ * own cookies. Headers near the common 4 KB limit are typical.
+ * @param size the size in bytes.
+ * @return the header value, which is longer than size when the session cookies
+ * do not fit.
+ */
+std::string CookieHeader(size_t size);
+
+}  // namespace bench
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_BENCH_FIXTURES_H_
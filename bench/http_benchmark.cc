@@ -0,0 +1,68 @@
+#include "benchmark/benchmark.h"
+#include "bench/allocation_counter.h"
+#include "bench/fixtures.h"
+#include "src/common/http/http.h"
+
+namespace authservice {
+namespace bench {
+namespace {
+const char *callback_path =
+    "/oauth/callback?code=SplxlOBeZQQYbYS6WxSbIA.mK8Y2hN3vDq7wTfR5cJ1pLg&"
+    "state=9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08&"
+    "session_state=5b2c3e1f-8a4d-4b7e-9c6a-2d1f0e3b4a59.c2Vzc2lvbg&"
+    "scope=openid%20profile%20email";
+const char *return_url = "https://me.tld/dashboard/projects/1234/settings?tab=members&filter=active&sort=name";
+}  // namespace
+
+// Every check decodes the Cookie header to find the session cookies.
+void BM_DecodeCookies(benchmark::State &state) {
+  auto header = CookieHeader(state.range(0));
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(common::http::http::DecodeCookies(header));
+  }
+  state.SetBytesProcessed(state.iterations() * header.size());
+}
+BENCHMARK(BM_DecodeCookies)->Arg(4096)->Arg(8192);
+
+// Every check decodes its path to see whether it is a callback or a logout.
+void BM_DecodePath(benchmark::State &state) {
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(common::http::http::DecodePath(callback_path));
+  }
+}
+BENCHMARK(BM_DecodePath);
+
+void BM_DecodeQueryData(benchmark::State &state) {
+  auto query = common::http::http::DecodePath(callback_path)[1];
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(common::http::http::DecodeQueryData(query));
+  }
+}
+BENCHMARK(BM_DecodeQueryData);
+
+// Sets the id token cookie after a callback, whose value is about 2 KB once a 1.5 KB id token is encrypted.
+void BM_EncodeSetCookie(benchmark::State &state) {
+  auto value = std::string(state.range(0), 'v');
+  std::set<absl::string_view> directives = {"HttpOnly", "Max-Age=300", "Path=/", "SameSite=Lax", "Secure"};
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        common::http::http::EncodeSetCookie("__Host-benchmark-authservice-id-token-cookie", value, directives));
+  }
+}
+BENCHMARK(BM_EncodeSetCookie)->Arg(2048);
+
+// Encodes the redirect URI and the like into the query of a redirect to the IdP.
+void BM_UrlSafeEncode(benchmark::State &state) {
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(common::http::http::UrlSafeEncode(return_url));
+  }
+}
+BENCHMARK(BM_UrlSafeEncode);
+
+}  // namespace bench
+}  // namespace authservice
@@ -0,0 +1,73 @@
+#include "bench/in_memory_idp.h"
+#include <stdexcept>
+#include "absl/strings/str_cat.h"
+
+namespace authservice {
+namespace bench {
+namespace {
+common::http::response_t Respond(beast::http::status status, absl::string_view body) {
+  common::http::response_t response(new beast::http::response<beast::http::string_body>(status, 11));
+  response->set(beast::http::field::content_type, "application/json");
+  response->body() = std::string(body);
+  response->prepare_payload();
+  return response;
+}
+
+// The issuer of an IdP's tokens is the origin of its endpoints.
+std::string Issuer(const config::common::Endpoint &endpoint) {
+  return absl::StrCat(endpoint.scheme(), "://", endpoint.hostname(), ":", endpoint.port());
+}
+
+bool SameEndpoint(const config::common::Endpoint &lhs, const config::common::Endpoint &rhs) {
+  return lhs.hostname() == rhs.hostname() && lhs.port() == rhs.port() && lhs.path() == rhs.path();
+}
+}  // namespace
+
+InMemoryIdp::InMemoryIdp(const config::oidc::OIDCConfig &config, const std::vector<std::string> &codes)
+    : config_(config), issuer_(Issuer(config.token()), config.client_id()) {
+  if (!config.has_jwks_uri()) {
+    throw std::runtime_error("the OIDC filter must fetch its keys from jwks_uri to trust the in-memory IdP's");
+  }
+  for (const auto &code : codes) {
+    token_responses_[code] = absl::StrCat(
+        "{\"access_token\":\"in-memory-access-token\",\"token_type\":\"Bearer\",\"id_token\":\"",
+        issuer_.IdToken(code), "\",\"expires_in\":", TokenIssuer::token_lifetime_seconds, "}");
+  }
+}
+
+common::http::response_t InMemoryIdp::Post(const config::common::Endpoint &endpoint,
+                                           const std::map<absl::string_view, absl::string_view> &,
+                                           absl::string_view body) const {
+  if (!SameEndpoint(endpoint, config_.token())) {
+    return Respond(beast::http::status::not_found, "{\"error\":\"not_found\"}");
+  }
+  auto form = common::http::http::DecodeFormData(body);
+  if (!form.has_value() || form->count("code") == 0) {
+    return Respond(beast::http::status::bad_request, "{\"error\":\"invalid_request\"}");
+  }
+  auto token_response = token_responses_.find(form->find("code")->second);
+  if (token_response == token_responses_.end()) {
+    return Respond(beast::http::status::bad_request, "{\"error\":\"invalid_grant\"}");
+  }
+  return Respond(beast::http::status::ok, token_response->second);
+}
+
+common::http::response_t InMemoryIdp::Post(const config::common::Endpoint &endpoint,
+                                           const std::map<absl::string_view, absl::string_view> &headers,
+                                           absl::string_view body, const common::utilities::Deadline &,
+                                           boost::asio::io_context &, boost::asio::yield_context) const {
+  return Post(endpoint, headers, body);
+}
+
+common::http::response_t InMemoryIdp::Get(const config::common::Endpoint &endpoint,
+                                          const std::map<absl::string_view, absl::string_view> &,
+                                          const common::utilities::Deadline &, boost::asio::io_context &,
+                                          boost::asio::yield_context) const {
+  if (!SameEndpoint(endpoint, config_.jwks_uri())) {
+    return Respond(beast::http::status::not_found, "{\"error\":\"not_found\"}");
+  }
+  return Respond(beast::http::status::ok, issuer_.Jwks());
+}
+
+}  // namespace bench
+}  // namespace authservice
@@ -0,0 +1,58 @@
+#ifndef AUTHSERVICE_BENCH_IN_MEMORY_IDP_H_
+#define AUTHSERVICE_BENCH_IN_MEMORY_IDP_H_
+#include <map>
+#include <string>
+#include <vector>
+#include "bench/token_issuer.h"
+#include "config/oidc/config.pb.h"
+#include "src/common/http/http.h"
+
+namespace authservice {
+namespace bench {
+
+/**
+ * InMemoryIdp stands in for the HTTP client of OIDC filters, answering their
+ * requests as the configured OIDC Provider would without any I/O: the token
+ * endpoint exchanges authorization codes for tokens, and the jwks_uri serves
+ * the keys the tokens are signed with.
+ *
+ * Each authorization code is exchanged for an id token whose nonce is the
+ * code, as RequestFactory's callback requests expect. The token responses are
+ * signed when the IdP is constructed, so that exchanges cost the filter no
+ * more than receiving a response from a remote IdP would. Thread safe.
+ */
+class InMemoryIdp final : public common::http::http {
+ public:
+  /**
+   * @param config the configuration of the OIDC filter whose IdP to stand in for.
+   * @param codes the authorization codes the token endpoint accepts.
+   * @throw std::runtime_error if the filter does not fetch its keys from
+   * jwks_uri, or the tokens cannot be signed.
+   */
+  InMemoryIdp(const config::oidc::OIDCConfig &config, const std::vector<std::string> &codes);
+
+  common::http::response_t Post(const config::common::Endpoint &endpoint,
+                                const std::map<absl::string_view, absl::string_view> &headers,
+                                absl::string_view body) const override;
+
+  common::http::response_t Post(const config::common::Endpoint &endpoint,
+                                const std::map<absl::string_view, absl::string_view> &headers,
+                                absl::string_view body, const common::utilities::Deadline &deadline,
+                                boost::asio::io_context &ioc, boost::asio::yield_context yield) const override;
+
+  common::http::response_t Get(const config::common::Endpoint &endpoint,
+                               const std::map<absl::string_view, absl::string_view> &headers,
+                               const common::utilities::Deadline &deadline, boost::asio::io_context &ioc,
+                               boost::asio::yield_context yield) const override;
+
+ private:
+  config::oidc::OIDCConfig config_;
+  TokenIssuer issuer_;
+  // Token responses by authorization code
+  std::map<std::string, std::string> token_responses_;
+};
+
+}  // namespace bench
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_BENCH_IN_MEMORY_IDP_H_
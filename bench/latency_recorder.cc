@@ -0,0 +1,32 @@
+#include "bench/latency_recorder.h"
+#include <algorithm>
+
+namespace authservice {
+namespace bench {
+namespace {
+double PercentileMicros(std::vector<std::chrono::nanoseconds> &sorted,
+                        double percentile) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  auto index = static_cast<size_t>(percentile * (sorted.size() - 1));
+  return std::chrono::duration<double, std::micro>(sorted[index]).count();
+}
+}  // namespace
+
+LatencyRecorder::LatencyRecorder(benchmark::State &state) : state_(state) {
+  samples_.reserve(state.max_iterations);
+}
+
+LatencyRecorder::~LatencyRecorder() {
+  std::sort(samples_.begin(), samples_.end());
+  state_.counters["p50_us"] = PercentileMicros(samples_, 0.50);
+  state_.counters["p99_us"] = PercentileMicros(samples_, 0.99);
+}
+
+void LatencyRecorder::Record(std::chrono::nanoseconds latency) {
+  samples_.push_back(latency);
+}
+
+}  // namespace bench
+}  // namespace authservice
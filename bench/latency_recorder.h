@@ -0,0 +1,34 @@
+#ifndef AUTHSERVICE_BENCH_LATENCY_RECORDER_H_
+#define AUTHSERVICE_BENCH_LATENCY_RECORDER_H_
+#include <chrono>
+#include <vector>
+#include "benchmark/benchmark.h"
+
+namespace authservice {
+namespace bench {
+
+/**
+ * LatencyRecorder collects per-iteration latencies and reports their median
+ * and 99th percentile, in microseconds, as the `p50_us` and `p99_us` counters
+ * when it goes out of scope.
+ */
+class LatencyRecorder {
+ private:
+  benchmark::State &state_;
+  std::vector<std::chrono::nanoseconds> samples_;
+
+ public:
+  explicit LatencyRecorder(benchmark::State &state);
+  ~LatencyRecorder();
+
+  /**
+   * Record the latency of one iteration.
+   * @param latency the latency to record.
+   */
+  void Record(std::chrono::nanoseconds latency);
+};
+
+}  // namespace bench
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_BENCH_LATENCY_RECORDER_H_
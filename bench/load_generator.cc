@@ -0,0 +1,330 @@
+// Drives Authorization.Check on a running authservice over gRPC and reports
+// throughput, latency percentiles and status codes as JSON, so that runs of
+// different builds can be diffed.
+//
+// Requests are built from the server's own configuration file, so cookies
+// and callbacks are accepted as a browser's would be. Load is either closed
+// loop, keeping --concurrency calls outstanding, or open loop, starting
+// --rate calls per second whether or not earlier calls have completed. Open
+// loop latencies are measured from when each call was due to start, so a
+// server that falls behind is not hidden by the generator waiting for it.
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "bench/requests.h"
+#include "envoy/service/auth/v2/external_auth.grpc.pb.h"
+#include "google/rpc/code.pb.h"
+#include "src/config/get_config.h"
+#include <grpcpp/grpcpp.h>
+
+ABSL_FLAG(std::string, filter_config, "/etc/authservice/config.json",
+          "path to the filter config of the server, from which requests are built");
+ABSL_FLAG(std::string, address, "",
+          "address of the server, defaults to the one in the filter config");
+ABSL_FLAG(std::string, mix, "cookie=90,redirect=6,logout=3,unmatched=1",
+          "relative weights of each kind of request: cookie, redirect, callback, logout and unmatched; callbacks "
+          "need the server's token endpoint to be reachable");
+ABSL_FLAG(double, rate, 0, "calls started per second in total, open loop; 0 for closed loop");
+ABSL_FLAG(int32_t, concurrency, 16, "calls kept outstanding in total, closed loop");
+ABSL_FLAG(int32_t, threads, 1, "client threads, each with its own connection");
+ABSL_FLAG(double, duration, 10, "seconds to measure for");
+ABSL_FLAG(double, warmup, 1, "seconds to run before measuring");
+ABSL_FLAG(int32_t, timeout_ms, 5000, "deadline of each call in milliseconds");
+
+namespace authservice {
+namespace bench {
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+  std::string address;
+  std::vector<std::pair<RequestKind, double>> mix;
+  double rate;
+  int concurrency;
+  int threads;
+  Clock::duration duration;
+  Clock::duration warmup;
+  std::chrono::milliseconds timeout;
+};
+
+// The results of the calls of one kind.
+struct Results {
+  std::vector<std::chrono::nanoseconds> latencies;
+  // By gRPC status code
+  std::map<std::string, uint64_t> grpc_codes;
+  // By the status the filters decided on, for calls that succeeded
+  std::map<std::string, uint64_t> check_codes;
+
+  void Merge(const Results &other) {
+    latencies.insert(latencies.end(), other.latencies.begin(), other.latencies.end());
+    for (const auto &code : other.grpc_codes) {
+      grpc_codes[code.first] += code.second;
+    }
+    for (const auto &code : other.check_codes) {
+      check_codes[code.first] += code.second;
+    }
+  }
+};
+
+// A call in flight, which is its own completion queue tag.
+struct Call {
+  grpc::ClientContext context;
+  ::envoy::service::auth::v2::CheckResponse response;
+  grpc::Status status;
+  std::unique_ptr<grpc::ClientAsyncResponseReaderInterface<::envoy::service::auth::v2::CheckResponse>> reader;
+  RequestKind kind;
+  // When the call was due to start
+  Clock::time_point start;
+};
+
+std::string GrpcCodeName(grpc::StatusCode code) {
+  switch (code) {
+    case grpc::StatusCode::OK:
+      return "OK";
+    case grpc::StatusCode::CANCELLED:
+      return "CANCELLED";
+    case grpc::StatusCode::INVALID_ARGUMENT:
+      return "INVALID_ARGUMENT";
+    case grpc::StatusCode::DEADLINE_EXCEEDED:
+      return "DEADLINE_EXCEEDED";
+    case grpc::StatusCode::RESOURCE_EXHAUSTED:
+      return "RESOURCE_EXHAUSTED";
+    case grpc::StatusCode::INTERNAL:
+      return "INTERNAL";
+    case grpc::StatusCode::UNAVAILABLE:
+      return "UNAVAILABLE";
+    default:
+      return std::to_string(code);
+  }
+}
+
+std::vector<std::pair<RequestKind, double>> ParseMix(const std::string &mix) {
+  std::vector<std::pair<RequestKind, double>> weights;
+  for (absl::string_view entry : absl::StrSplit(mix, ',', absl::SkipEmpty())) {
+    std::pair<std::string, std::string> parts = absl::StrSplit(entry, absl::MaxSplits('=', 1));
+    auto kind = ParseRequestKind(parts.first);
+    double weight;
+    if (!kind.has_value() || !absl::SimpleAtod(parts.second, &weight) || weight < 0) {
+      throw std::runtime_error("invalid request mix entry: " + std::string(entry));
+    }
+    if (weight > 0) {
+      weights.emplace_back(*kind, weight);
+    }
+  }
+  if (weights.empty()) {
+    throw std::runtime_error("the request mix is empty");
+  }
+  return weights;
+}
+
+// Run one client thread until the measurement ends and every call it started has completed.
+std::map<RequestKind, Results> RunClient(
+    const Options &options, const std::map<RequestKind, ::envoy::service::auth::v2::CheckRequest> &requests,
+    int index, Clock::time_point measure_from, Clock::time_point end) {
+  // A channel of its own, so each thread has its own connection.
+  grpc::ChannelArguments arguments;
+  arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+  auto stub = ::envoy::service::auth::v2::Authorization::NewStub(
+      grpc::CreateCustomChannel(options.address, grpc::InsecureChannelCredentials(), arguments));
+  grpc::CompletionQueue cq;
+
+  std::mt19937 random(index);
+  std::vector<double> weights;
+  for (const auto &entry : options.mix) {
+    weights.push_back(entry.second);
+  }
+  std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+
+  // Spread the load evenly over the threads.
+  int concurrency = options.concurrency / options.threads + (index < options.concurrency % options.threads ? 1 : 0);
+  Clock::duration interval{};
+  if (options.rate > 0) {
+    interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options.threads / options.rate));
+  }
+
+  std::map<RequestKind, Results> results;
+  int outstanding = 0;
+  auto next = Clock::now();
+  auto send = [&](Clock::time_point start) {
+    auto call = new Call;
+    call->kind = options.mix[pick(random)].first;
+    call->start = start;
+    call->context.set_deadline(std::chrono::system_clock::now() + options.timeout);
+    call->reader = stub->AsyncCheck(&call->context, requests.at(call->kind), &cq);
+    call->reader->Finish(&call->response, &call->status, call);
+    ++outstanding;
+  };
+
+  while (true) {
+    auto now = Clock::now();
+    if (now < end) {
+      if (options.rate > 0) {
+        while (next <= now) {
+          send(next);
+          next += interval;
+        }
+      } else {
+        while (outstanding < concurrency) {
+          send(now);
+        }
+      }
+    } else if (outstanding == 0) {
+      break;
+    }
+
+    void *tag;
+    bool ok;
+    if (now >= end) {
+      // Only waiting for the calls still in flight, which end by their deadlines.
+      if (!cq.Next(&tag, &ok)) {
+        break;
+      }
+    } else {
+      auto wait = std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          (options.rate > 0 ? std::min(next, end) : end) - now);
+      if (cq.AsyncNext(&tag, &ok, std::chrono::system_clock::now() + wait) != grpc::CompletionQueue::GOT_EVENT) {
+        continue;
+      }
+    }
+    std::unique_ptr<Call> call(static_cast<Call *>(tag));
+    --outstanding;
+    if (call->start < measure_from || call->start >= end) {
+      continue;
+    }
+    auto &result = results[call->kind];
+    result.latencies.push_back(Clock::now() - call->start);
+    result.grpc_codes[GrpcCodeName(call->status.error_code())]++;
+    if (call->status.ok()) {
+      auto code = static_cast<google::rpc::Code>(call->response.status().code());
+      result.check_codes[google::rpc::Code_IsValid(code) ? google::rpc::Code_Name(code) : "UNKNOWN"]++;
+    }
+  }
+  return results;
+}
+
+double Percentile(const std::vector<std::chrono::nanoseconds> &sorted, double percentile) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  auto index = std::min(sorted.size() - 1, static_cast<size_t>(percentile / 100 * sorted.size()));
+  return sorted[index].count() / 1e3;
+}
+
+void WriteCodes(std::ostream &out, const std::map<std::string, uint64_t> &codes) {
+  out << '{';
+  auto separator = "";
+  for (const auto &code : codes) {
+    out << separator << '"' << code.first << "\":" << code.second;
+    separator = ",";
+  }
+  out << '}';
+}
+
+// Write the results of a set of calls, sorting their latencies.
+void WriteResults(std::ostream &out, Results &results, double seconds) {
+  auto &latencies = results.latencies;
+  std::sort(latencies.begin(), latencies.end());
+  double sum = 0;
+  for (auto latency : latencies) {
+    sum += latency.count() / 1e3;
+  }
+  out << "{\"requests\":" << latencies.size() << ",\"throughput\":" << latencies.size() / seconds
+      << ",\"latency_us\":{\"mean\":" << (latencies.empty() ? 0 : sum / latencies.size())
+      << ",\"p50\":" << Percentile(latencies, 50) << ",\"p90\":" << Percentile(latencies, 90)
+      << ",\"p99\":" << Percentile(latencies, 99) << ",\"p999\":" << Percentile(latencies, 99.9)
+      << ",\"max\":" << (latencies.empty() ? 0 : latencies.back().count() / 1e3) << "},\"grpc_codes\":";
+  WriteCodes(out, results.grpc_codes);
+  out << ",\"check_codes\":";
+  WriteCodes(out, results.check_codes);
+  out << '}';
+}
+
+void Run(const Options &options, const config::Config &config) {
+  RequestFactory factory(config);
+  std::map<RequestKind, ::envoy::service::auth::v2::CheckRequest> requests;
+  for (const auto &entry : options.mix) {
+    requests.emplace(entry.first, factory.Build(entry.first));
+  }
+
+  auto measure_from = Clock::now() + options.warmup;
+  auto end = measure_from + options.duration;
+  std::vector<std::map<RequestKind, Results>> thread_results(options.threads);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.threads; ++i) {
+    threads.emplace_back([&, i]() { thread_results[i] = RunClient(options, requests, i, measure_from, end); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  Results total;
+  std::map<RequestKind, Results> by_kind;
+  for (const auto &results : thread_results) {
+    for (const auto &entry : results) {
+      by_kind[entry.first].Merge(entry.second);
+      total.Merge(entry.second);
+    }
+  }
+
+  auto seconds = std::chrono::duration<double>(options.duration).count();
+  std::ostringstream out;
+  out << "{\"address\":\"" << options.address << "\",\"mode\":\"" << (options.rate > 0 ? "open" : "closed")
+      << "\",\"rate\":" << options.rate << ",\"concurrency\":" << options.concurrency
+      << ",\"threads\":" << options.threads << ",\"duration_seconds\":" << seconds << ",\"total\":";
+  WriteResults(out, total, seconds);
+  out << ",\"by_kind\":{";
+  auto separator = "";
+  for (auto &entry : by_kind) {
+    out << separator << '"' << RequestKindName(entry.first) << "\":";
+    WriteResults(out, entry.second, seconds);
+    separator = ",";
+  }
+  out << "}}";
+  std::cout << out.str() << std::endl;
+}
+}  // namespace
+}  // namespace bench
+}  // namespace authservice
+
+int main(int argc, char **argv) {
+  absl::SetProgramUsageMessage(absl::StrCat("drive an auth server with Check calls:\n", argv[0]));
+  absl::ParseCommandLine(argc, argv);
+
+  try {
+    auto config = authservice::config::GetConfig(absl::GetFlag(FLAGS_filter_config));
+    authservice::bench::Options options;
+    options.address = absl::GetFlag(FLAGS_address);
+    if (options.address.empty()) {
+      options.address = authservice::config::GetConfiguredAddress(*config);
+    }
+    options.mix = authservice::bench::ParseMix(absl::GetFlag(FLAGS_mix));
+    options.rate = absl::GetFlag(FLAGS_rate);
+    options.concurrency = absl::GetFlag(FLAGS_concurrency);
+    options.threads = absl::GetFlag(FLAGS_threads);
+    if (options.threads < 1 || (options.rate <= 0 && options.concurrency < options.threads)) {
+      throw std::runtime_error("need at least one thread, and at least one outstanding call per thread");
+    }
+    options.duration = std::chrono::duration_cast<authservice::bench::Clock::duration>(
+        std::chrono::duration<double>(absl::GetFlag(FLAGS_duration)));
+    options.warmup = std::chrono::duration_cast<authservice::bench::Clock::duration>(
+        std::chrono::duration<double>(absl::GetFlag(FLAGS_warmup)));
+    options.timeout = std::chrono::milliseconds(absl::GetFlag(FLAGS_timeout_ms));
+    authservice::bench::Run(options, *config);
+  } catch (const std::exception &e) {
+    std::cerr << argv[0] << ": " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+#include "benchmark/benchmark.h"
+#include "bench/fixtures.h"
+#include "spdlog/async.h"
+#include "spdlog/sinks/basic_file_sink.h"
+#include "spdlog/spdlog.h"
+#include "src/common/http/headers.h"
+#include "src/service/service_impl.h"
+
+namespace authservice {
+namespace bench {
+namespace {
+// Logs are written to /dev/null so that the cost measured is that of
+// formatting and writing rather than of a terminal.
+spdlog::sink_ptr NullFileSink() {
+  return std::make_shared<spdlog::sinks::basic_file_sink_mt>("/dev/null");
+}
+
+// A request without a session cookie, which is redirected to the IdP and
+// logs the most of any request that needs no I/O.
+::envoy::service::auth::v2::CheckRequest RedirectRequest() {
+  auto request = CookieRequest();
+  request.mutable_attributes()->mutable_request()->mutable_http()->mutable_headers()->erase(
+      common::http::headers::Cookie);
+  return request;
+}
+
+void CheckWithLogger(benchmark::State &state, std::shared_ptr<spdlog::logger> logger) {
+  logger->set_level(static_cast<spdlog::level::level_enum>(state.range(0)));
+  auto previous = spdlog::default_logger();
+  spdlog::set_default_logger(logger);
+
+  service::AuthServiceImpl service(BenchmarkConfig());
+  auto request = RedirectRequest();
+  for (auto _ : state) {
+    ::envoy::service::auth::v2::CheckResponse response;
+    benchmark::DoNotOptimize(service.TryCheck(nullptr, &request, &response));
+  }
+  spdlog::set_default_logger(previous);
+}
+}  // namespace
+
+// Every message is formatted and written on the calling thread under the
+// sink's mutex, as with the logger main installed before.
+void BM_CheckSyncLogging(benchmark::State &state) {
+  CheckWithLogger(state, std::make_shared<spdlog::logger>("bench_sync", NullFileSink()));
+}
+BENCHMARK(BM_CheckSyncLogging)
+    ->Arg(spdlog::level::debug)
+    ->Arg(spdlog::level::info)
+    ->Arg(spdlog::level::off);
+
+// Messages are queued for a background thread, as main now does.
+void BM_CheckAsyncLogging(benchmark::State &state) {
+  static auto pool = std::make_shared<spdlog::details::thread_pool>(8192, 1);
+  CheckWithLogger(state, std::make_shared<spdlog::async_logger>("bench_async", NullFileSink(), pool,
+                                                                spdlog::async_overflow_policy::overrun_oldest));
+}
+BENCHMARK(BM_CheckAsyncLogging)
+    ->Arg(spdlog::level::debug)
+    ->Arg(spdlog::level::info)
+    ->Arg(spdlog::level::off);
+
+}  // namespace bench
+}  // namespace authservice
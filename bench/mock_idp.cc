@@ -0,0 +1,338 @@
+// A mock OIDC provider for measuring the callback path without a real IdP.
+// It serves the token endpoint and the JWKS of the first OIDC filter in a
+// filter config over TLS, issuing id tokens signed with a key generated at
+// startup. The nonce of each id token is the authorization code it was
+// exchanged for, as sent by //bench:load_generator.
+//
+// The TLS certificate is self-signed and generated at startup too, and is
+// written to --ca_file so the server can be told to trust it:
+//
+//   bazel-bin/bench/mock_idp --filter_config=bench/load-config.json &
+//   SSL_CERT_FILE=/tmp/mock_idp_ca.pem bazel-bin/src/main/auth_server
+//       --filter_config=bench/load-config.json &
+//   bazel-bin/bench/load_generator --filter_config=bench/load-config.json
+//       --mix=callback=1
+//
+// Latency, errors and closed connections can be injected to see how the
+// server copes with a slow or unreliable IdP. Counts of the requests served
+// and the faults injected are printed as JSON on exit.
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <boost/asio/spawn.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/strings/str_cat.h"
+#include "bench/token_issuer.h"
+#include "openssl/evp.h"
+#include "openssl/pem.h"
+#include "openssl/x509.h"
+#include "openssl/x509v3.h"
+#include "spdlog/spdlog.h"
+#include "src/common/http/http.h"
+#include "src/config/get_config.h"
+
+ABSL_FLAG(std::string, filter_config, "bench/load-config.json",
+          "path to the filter config of the server, whose first OIDC filter's token endpoint and jwks_uri are served");
+ABSL_FLAG(std::string, address, "127.0.0.1", "address to listen on");
+ABSL_FLAG(std::string, ca_file, "/tmp/mock_idp_ca.pem", "where to write the self-signed TLS certificate");
+ABSL_FLAG(int32_t, threads, 1, "threads serving requests");
+ABSL_FLAG(int32_t, latency_ms, 0, "delay before each response in milliseconds");
+ABSL_FLAG(int32_t, latency_jitter_ms, 0, "further delay before each response, uniformly distributed up to this");
+ABSL_FLAG(double, error_rate, 0, "fraction of token requests answered with a 500 error");
+ABSL_FLAG(double, close_rate, 0, "fraction of responses after which the connection is closed");
+ABSL_FLAG(double, drop_rate, 0, "fraction of requests whose connection is closed without a response");
+
+namespace beast = boost::beast;    // from <boost/beast.hpp>
+namespace http = beast::http;      // from <boost/beast/http.hpp>
+namespace ssl = boost::asio::ssl;  // from <boost/asio/ssl.hpp>
+using tcp = boost::asio::ip::tcp;  // from <boost/asio/ip/tcp.hpp>
+
+namespace authservice {
+namespace bench {
+namespace {
+const char *json_content_type = "application/json";
+// How long the certificate is valid for.
+const long certificate_lifetime_seconds = 30 * 24 * 3600;
+
+struct Options {
+  std::string address;
+  uint16_t port;
+  std::string hostname;
+  std::string token_path;
+  std::string jwks_path;
+  std::string client_id;
+  int threads;
+  std::chrono::milliseconds latency;
+  std::chrono::milliseconds latency_jitter;
+  double error_rate;
+  double close_rate;
+  double drop_rate;
+};
+
+struct Counts {
+  std::atomic<uint64_t> token_requests{0};
+  std::atomic<uint64_t> jwks_requests{0};
+  std::atomic<uint64_t> errors{0};
+  std::atomic<uint64_t> closes{0};
+  std::atomic<uint64_t> drops{0};
+};
+
+void Require(int result, const char *what) {
+  if (result != 1) {
+    throw std::runtime_error(std::string("failed to ") + what);
+  }
+}
+
+void AddExtension(X509 *certificate, int nid, const std::string &value) {
+  X509V3_CTX context;
+  X509V3_set_ctx_nodb(&context);
+  X509V3_set_ctx(&context, certificate, certificate, nullptr, nullptr, 0);
+  bssl::UniquePtr<X509_EXTENSION> extension(
+      X509V3_EXT_conf_nid(nullptr, &context, nid, const_cast<char *>(value.c_str())));
+  if (extension == nullptr) {
+    throw std::runtime_error("failed to create a certificate extension");
+  }
+  Require(X509_add_ext(certificate, extension.get(), -1), "add a certificate extension");
+}
+
+// A certificate for the hostname that is its own certificate authority, so that trusting it is enough to verify it.
+bssl::UniquePtr<X509> SelfSign(EVP_PKEY *key, const std::string &hostname) {
+  bssl::UniquePtr<X509> certificate(X509_new());
+  Require(X509_set_version(certificate.get(), 2), "set the certificate version");
+  Require(ASN1_INTEGER_set(X509_get_serialNumber(certificate.get()), 1), "set the certificate serial number");
+  X509_gmtime_adj(X509_get_notBefore(certificate.get()), -3600);
+  X509_gmtime_adj(X509_get_notAfter(certificate.get()), certificate_lifetime_seconds);
+  auto name = X509_get_subject_name(certificate.get());
+  Require(X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const uint8_t *>(hostname.c_str()),
+                                   -1, -1, 0),
+        "set the certificate subject");
+  Require(X509_set_issuer_name(certificate.get(), name), "set the certificate issuer");
+  Require(X509_set_pubkey(certificate.get(), key), "set the certificate key");
+  AddExtension(certificate.get(), NID_basic_constraints, "critical,CA:TRUE");
+  AddExtension(certificate.get(), NID_subject_alt_name, "DNS:" + hostname + ",IP:127.0.0.1");
+  if (X509_sign(certificate.get(), key, EVP_sha256()) == 0) {
+    throw std::runtime_error("failed to sign the certificate");
+  }
+  return certificate;
+}
+
+void WriteCertificate(X509 *certificate, const std::string &path) {
+  bssl::UniquePtr<BIO> bio(BIO_new(BIO_s_mem()));
+  Require(PEM_write_bio_X509(bio.get(), certificate), "encode the certificate");
+  const uint8_t *contents;
+  size_t length;
+  Require(BIO_mem_contents(bio.get(), &contents, &length), "encode the certificate");
+  std::ofstream file(path, std::ios::trunc);
+  file.write(reinterpret_cast<const char *>(contents), length);
+  if (!file) {
+    throw std::runtime_error("failed to write the certificate to " + path);
+  }
+}
+
+class MockIdp {
+ public:
+  MockIdp(const Options &options, Counts &counts)
+      : options_(options),
+        counts_(counts),
+        issuer_(absl::StrCat("https://", options.hostname, ":", options.port), options.client_id),
+        tls_(ssl::context::tlsv12_server),
+        acceptor_(ioc_, tcp::endpoint(boost::asio::ip::make_address(options.address), options.port)) {
+    auto certificate = SelfSign(issuer_.Key(), options_.hostname);
+    WriteCertificate(certificate.get(), absl::GetFlag(FLAGS_ca_file));
+    Require(SSL_CTX_use_certificate(tls_.native_handle(), certificate.get()), "use the certificate");
+    Require(SSL_CTX_use_PrivateKey(tls_.native_handle(), issuer_.Key()), "use the private key");
+  }
+
+  // Serve until interrupted.
+  void Run() {
+    boost::asio::signal_set signals(ioc_, SIGINT, SIGTERM);
+    signals.async_wait([this](const boost::system::error_code &, int) { ioc_.stop(); });
+    boost::asio::spawn(ioc_, [this](boost::asio::yield_context yield) { Accept(yield); });
+    spdlog::info("{}: serving {} and {} on https://{}:{}", __func__, options_.token_path, options_.jwks_path,
+                 options_.address, options_.port);
+    std::vector<std::thread> threads;
+    for (int i = 1; i < options_.threads; ++i) {
+      threads.emplace_back([this]() { ioc_.run(); });
+    }
+    ioc_.run();
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+
+ private:
+  void Accept(boost::asio::yield_context yield) {
+    while (true) {
+      boost::system::error_code ec;
+      tcp::socket socket(ioc_);
+      acceptor_.async_accept(socket, yield[ec]);
+      if (ec == boost::asio::error::operation_aborted) {
+        return;
+      }
+      if (ec) {
+        spdlog::error("{}: failed to accept connection: {}", __func__, ec.message());
+        continue;
+      }
+      // The socket is moved into the co-routine, which owns it from then on.
+      auto connection = std::make_shared<tcp::socket>(std::move(socket));
+      boost::asio::spawn(ioc_, [this, connection](boost::asio::yield_context yield) {
+        Serve(std::move(*connection), yield);
+      });
+    }
+  }
+
+  void Serve(tcp::socket socket, boost::asio::yield_context yield) {
+    static thread_local std::mt19937 random(std::random_device{}());
+    std::uniform_real_distribution<double> chance(0, 1);
+
+    beast::ssl_stream<tcp::socket> stream(std::move(socket), tls_);
+    boost::system::error_code ec;
+    stream.async_handshake(ssl::stream_base::server, yield[ec]);
+    if (ec) {
+      spdlog::info("{}: TLS handshake failed: {}", __func__, ec.message());
+      return;
+    }
+
+    beast::flat_buffer buffer;
+    while (true) {
+      http::request<http::string_body> request;
+      http::async_read(stream, buffer, request, yield[ec]);
+      if (ec) {
+        // Includes the client closing the connection.
+        return;
+      }
+      if (chance(random) < options_.drop_rate) {
+        ++counts_.drops;
+        return;
+      }
+
+      auto delay = options_.latency;
+      if (options_.latency_jitter.count() > 0) {
+        delay += std::chrono::milliseconds(
+            std::uniform_int_distribution<int64_t>(0, options_.latency_jitter.count())(random));
+      }
+      if (delay.count() > 0) {
+        boost::asio::steady_timer timer(ioc_, delay);
+        timer.async_wait(yield[ec]);
+      }
+
+      http::response<http::string_body> response(http::status::ok, request.version());
+      response.set(http::field::content_type, json_content_type);
+      if (request.method() == http::verb::post && request.target() == options_.token_path) {
+        ++counts_.token_requests;
+        Token(request, response, chance(random) < options_.error_rate);
+      } else if (request.method() == http::verb::get && request.target() == options_.jwks_path) {
+        ++counts_.jwks_requests;
+        response.body() = issuer_.Jwks();
+      } else {
+        response.result(http::status::not_found);
+        response.body() = "{\"error\":\"not_found\"}";
+      }
+
+      auto close = chance(random) < options_.close_rate;
+      if (close) {
+        ++counts_.closes;
+      }
+      response.keep_alive(request.keep_alive() && !close);
+      response.prepare_payload();
+      http::async_write(stream, response, yield[ec]);
+      if (ec || !response.keep_alive()) {
+        stream.async_shutdown(yield[ec]);
+        return;
+      }
+    }
+  }
+
+  void Token(const http::request<http::string_body> &request, http::response<http::string_body> &response,
+             bool fail) {
+    if (fail) {
+      ++counts_.errors;
+      response.result(http::status::internal_server_error);
+      response.body() = "{\"error\":\"server_error\"}";
+      return;
+    }
+    auto form = common::http::http::DecodeFormData(request.body());
+    if (!form.has_value() || form->find("code") == form->end()) {
+      response.result(http::status::bad_request);
+      response.body() = "{\"error\":\"invalid_request\"}";
+      return;
+    }
+    // The code is the nonce the caller expects, as the load generator sends it.
+    auto code = form->find("code");
+    response.body() = absl::StrCat("{\"access_token\":\"mock-access-token\",\"token_type\":\"Bearer\",\"id_token\":\"",
+                                   issuer_.IdToken(code->second), "\",\"expires_in\":",
+                                   TokenIssuer::token_lifetime_seconds, "}");
+  }
+
+  const Options &options_;
+  Counts &counts_;
+  TokenIssuer issuer_;
+  ssl::context tls_;
+  boost::asio::io_context ioc_;
+  tcp::acceptor acceptor_;
+};
+
+Options GetOptions(const config::Config &config) {
+  for (const auto &chain : config.chains()) {
+    for (const auto &filter : chain.filters()) {
+      if (!filter.has_oidc()) {
+        continue;
+      }
+      const auto &oidc = filter.oidc();
+      if (!oidc.has_jwks_uri()) {
+        throw std::runtime_error("the OIDC filter must fetch its keys from jwks_uri to trust the mock IdP's");
+      }
+      if (oidc.jwks_uri().hostname() != oidc.token().hostname() || oidc.jwks_uri().port() != oidc.token().port()) {
+        throw std::runtime_error("the OIDC filter's token endpoint and jwks_uri must be on the same host and port");
+      }
+      Options options;
+      options.address = absl::GetFlag(FLAGS_address);
+      options.port = static_cast<uint16_t>(oidc.token().port());
+      options.hostname = oidc.token().hostname();
+      options.token_path = oidc.token().path();
+      options.jwks_path = oidc.jwks_uri().path();
+      options.client_id = oidc.client_id();
+      options.threads = std::max(1, absl::GetFlag(FLAGS_threads));
+      options.latency = std::chrono::milliseconds(absl::GetFlag(FLAGS_latency_ms));
+      options.latency_jitter = std::chrono::milliseconds(absl::GetFlag(FLAGS_latency_jitter_ms));
+      options.error_rate = absl::GetFlag(FLAGS_error_rate);
+      options.close_rate = absl::GetFlag(FLAGS_close_rate);
+      options.drop_rate = absl::GetFlag(FLAGS_drop_rate);
+      return options;
+    }
+  }
+  throw std::runtime_error("no filter chain has an OIDC filter");
+}
+}  // namespace
+}  // namespace bench
+}  // namespace authservice
+
+int main(int argc, char **argv) {
+  absl::SetProgramUsageMessage(absl::StrCat("serve a mock OIDC provider:\n", argv[0]));
+  absl::ParseCommandLine(argc, argv);
+
+  try {
+    auto config = authservice::config::GetConfig(absl::GetFlag(FLAGS_filter_config));
+    auto options = authservice::bench::GetOptions(*config);
+    authservice::bench::Counts counts;
+    authservice::bench::MockIdp idp(options, counts);
+    idp.Run();
+    std::cout << "{\"token_requests\":" << counts.token_requests << ",\"jwks_requests\":" << counts.jwks_requests
+              << ",\"errors\":" << counts.errors << ",\"closes\":" << counts.closes << ",\"drops\":" << counts.drops
+              << "}" << std::endl;
+  } catch (const std::exception &e) {
+    spdlog::error("{}: {}", __func__, e.what());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#include "benchmark/benchmark.h"
+#include "absl/strings/str_cat.h"
+#include "bench/allocation_counter.h"
+#include "bench/token_issuer.h"
+#include "src/filters/oidc/state_cookie_codec.h"
+#include "src/filters/oidc/token_response.h"
+
+namespace authservice {
+namespace bench {
+namespace {
+const char *client_id = "example-app";
+const char *state_value = "9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08";
+const char *nonce = "2c26b46b68ffc68ff99b453c1d30413413422d706483bfa0f98a5e886266e7ae";
+
+// An id token of about the given size, padded with the groups claim that makes real ones large.
+std::string IdToken(const TokenIssuer &issuer, size_t size) {
+  std::string claims = "\"email\":\"jane.doe@example.com\",\"name\":\"Jane Doe\",\"groups\":[";
+  auto token = issuer.IdToken(nonce, absl::StrCat(claims, "]"));
+  for (int i = 0; token.size() < size; ++i) {
+    absl::StrAppend(&claims, i == 0 ? "" : ",", "\"engineering-team-", i, "\"");
+    token = issuer.IdToken(nonce, absl::StrCat(claims, "]"));
+  }
+  return token;
+}
+}  // namespace
+
+void BM_StateCookieCodecEncode(benchmark::State &state) {
+  filters::oidc::StateCookieCodec codec;
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(codec.Encode(state_value, nonce));
+  }
+}
+BENCHMARK(BM_StateCookieCodecEncode);
+
+void BM_StateCookieCodecDecode(benchmark::State &state) {
+  filters::oidc::StateCookieCodec codec;
+  auto value = codec.Encode(state_value, nonce);
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(codec.Decode(value));
+  }
+}
+BENCHMARK(BM_StateCookieCodecDecode);
+
+// Parses and verifies the token endpoint's response to a callback, including the RS256 signature of its id token.
+void BM_TokenResponseParse(benchmark::State &state) {
+  TokenIssuer issuer("https://acme-idp.tld", client_id);
+  auto keys = google::jwt_verify::Jwks::createFrom(issuer.Jwks(), google::jwt_verify::Jwks::JWKS);
+  if (keys->getStatus() != google::jwt_verify::Status::Ok) {
+    state.SkipWithError("the issuer's JWKS is invalid");
+    return;
+  }
+  filters::oidc::TokenResponseParserImpl parser(std::move(keys));
+  auto response = absl::StrCat(
+      "{\"access_token\":\"", std::string(state.range(0) / 2, 'a'), "\",\"token_type\":\"Bearer\",\"id_token\":\"",
+      IdToken(issuer, state.range(0)), "\",\"expires_in\":3600}");
+  if (!parser.Parse(client_id, nonce, response).has_value()) {
+    state.SkipWithError("the token response is invalid");
+    return;
+  }
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(parser.Parse(client_id, nonce, response));
+  }
+}
+BENCHMARK(BM_TokenResponseParse)->Arg(1536);
+
+}  // namespace bench
+}  // namespace authservice
@@ -0,0 +1,83 @@
+#ifndef AUTHSERVICE_BENCH_REQUESTS_H_
+#define AUTHSERVICE_BENCH_REQUESTS_H_
+#include <array>
+#include <string>
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "config/config.pb.h"
+#include "envoy/service/auth/v2/external_auth.grpc.pb.h"
+
+namespace authservice {
+namespace bench {
+
+/**
+ * The kinds of request a browser sends through the OIDC filter.
+ */
+enum class RequestKind {
+  // Carries valid session cookies, so is allowed without I/O
+  cookie,
+  // Carries no session cookies, so is redirected to the IdP
+  redirect,
+  // Returns from the IdP with an authorization code to exchange for tokens
+  callback,
+  // Asks to log out
+  logout,
+  // Matches no filter chain
+  unmatched,
+};
+
+const std::array<RequestKind, 5> request_kinds = {{RequestKind::cookie, RequestKind::redirect, RequestKind::callback,
+                                                  RequestKind::logout, RequestKind::unmatched}};
+
+/**
+ * The authorization code, and so the nonce, of every callback request.
+ */
+const char *const callback_code = "load-generator-nonce";
+
+/**
+ * @return the name of a kind of request.
+ */
+const char *RequestKindName(RequestKind kind);
+
+/**
+ * Parse the name of a kind of request.
+ * @param name the name.
+ * @return the kind, or absl::nullopt if the name is unknown.
+ */
+absl::optional<RequestKind> ParseRequestKind(absl::string_view name);
+
+/**
+ * RequestFactory builds requests of each kind for the first filter chain of a
+ * configuration with an OIDC filter, as that chain's users would send them.
+ * Cookies are encrypted with the filter's secret, so the server accepts them.
+ *
+ * The authorization code of a callback request is its nonce, so that a mock
+ * IdP can issue an id token bound to the nonce without having seen the
+ * authorization request.
+ */
+class RequestFactory {
+ public:
+  /**
+   * @param config the configuration of the server the requests are for.
+   * @throw std::runtime_error if no filter chain has an OIDC filter.
+   */
+  explicit RequestFactory(const config::Config &config);
+
+  /**
+   * @param kind the kind of request.
+   * @return the request.
+   */
+  ::envoy::service::auth::v2::CheckRequest Build(RequestKind kind) const;
+
+ private:
+  // The name of one of the filter's cookies.
+  std::string CookieName(absl::string_view cookie) const;
+
+  config::FilterChain chain_;
+  config::oidc::OIDCConfig oidc_;
+};
+
+}  // namespace bench
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_BENCH_REQUESTS_H_
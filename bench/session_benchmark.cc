@@ -0,0 +1,101 @@
+#include "benchmark/benchmark.h"
+#include "bench/allocation_counter.h"
+#include "bench/fixtures.h"
+#include "src/common/session/gcm_encryptor.h"
+#include "src/common/session/hkdf_deriver.h"
+#include "src/common/session/token_encryptor.h"
+#include "src/common/utilities/random.h"
+
+namespace authservice {
+namespace bench {
+namespace {
+const char *secret = "some-secret";
+
+// The encryptor for the format of the benchmark's second argument: 0 for V1 tokens, 1 for V2.
+common::session::TokenEncryptorPtr NewTokenEncryptor(const benchmark::State &state) {
+  auto format = state.range(1) == 0 ? common::session::TokenFormat::V1 : common::session::TokenFormat::V2;
+  return common::session::TokenEncryptor::Create(secret, common::session::EncryptionAlg::AES256GCM,
+                                                 common::session::HKDFHash::SHA512, format);
+}
+
+std::vector<unsigned char> Bytes(size_t size) {
+  auto random = common::utilities::RandomGenerator().Generate(size);
+  return std::vector<unsigned char>(random.Begin(), random.End());
+}
+}  // namespace
+
+// Encrypts an id token into its cookie.
+void BM_TokenEncryptorEncrypt(benchmark::State &state) {
+  auto cryptor = NewTokenEncryptor(state);
+  auto token = Jwt(state.range(0));
+  state.counters["cookie_bytes"] = cryptor->Encrypt(token).size();
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cryptor->Encrypt(token));
+  }
+  state.SetBytesProcessed(state.iterations() * token.size());
+}
+BENCHMARK(BM_TokenEncryptorEncrypt)->ArgNames({"bytes", "format"})->Args({1536, 0})->Args({1536, 1});
+
+// Decrypts an id token from its cookie, which every check with a session does.
+void BM_TokenEncryptorDecrypt(benchmark::State &state) {
+  auto cryptor = NewTokenEncryptor(state);
+  auto token = Jwt(state.range(0));
+  auto ciphertext = cryptor->Encrypt(token);
+  state.counters["cookie_bytes"] = ciphertext.size();
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cryptor->Decrypt(ciphertext));
+  }
+  state.SetBytesProcessed(state.iterations() * token.size());
+}
+BENCHMARK(BM_TokenEncryptorDecrypt)->ArgNames({"bytes", "format"})->Args({1536, 0})->Args({1536, 1});
+
+void BM_GcmEncryptorSeal(benchmark::State &state) {
+  auto cryptor = common::session::GcmEncryptor::Create(Bytes(32));
+  auto plaintext = Bytes(state.range(0));
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cryptor->Seal(plaintext));
+  }
+  state.SetBytesProcessed(state.iterations() * plaintext.size());
+}
+BENCHMARK(BM_GcmEncryptorSeal)->Arg(1536);
+
+void BM_GcmEncryptorOpen(benchmark::State &state) {
+  auto cryptor = common::session::GcmEncryptor::Create(Bytes(32));
+  auto plaintext = Bytes(state.range(0));
+  auto ciphertext = cryptor->Seal(plaintext);
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cryptor->Open(ciphertext));
+  }
+  state.SetBytesProcessed(state.iterations() * plaintext.size());
+}
+BENCHMARK(BM_GcmEncryptorOpen)->Arg(1536);
+
+// Derives a key from a salt as tokens in the V1 format need on every decryption.
+void BM_HkdfDeriverDerive(benchmark::State &state) {
+  std::string secret_string(secret);
+  auto deriver = common::session::HkdfDeriver::Create(
+      std::vector<unsigned char>(secret_string.begin(), secret_string.end()), common::session::HKDFHash::SHA512);
+  auto salt = Bytes(32);
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(deriver->Derive(32, salt));
+  }
+}
+BENCHMARK(BM_HkdfDeriverDerive);
+
+// Generates a state or a nonce for a redirect to the IdP.
+void BM_RandomGeneratorGenerate(benchmark::State &state) {
+  common::utilities::RandomGenerator generator;
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(generator.Generate(state.range(0)));
+  }
+}
+BENCHMARK(BM_RandomGeneratorGenerate)->Arg(32);
+
+}  // namespace bench
+}  // namespace authservice
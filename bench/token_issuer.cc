@@ -0,0 +1,76 @@
+#include "bench/token_issuer.h"
+#include <chrono>
+#include <stdexcept>
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "openssl/bn.h"
+#include "openssl/rsa.h"
+
+namespace authservice {
+namespace bench {
+namespace {
+const char *key_id = "mock-idp";
+
+std::string Base64Url(absl::string_view data) { return absl::WebSafeBase64Escape(data); }
+
+std::string Base64Url(const BIGNUM *number) {
+  std::string bytes(BN_num_bytes(number), '\0');
+  BN_bn2bin(number, reinterpret_cast<uint8_t *>(&bytes[0]));
+  return Base64Url(bytes);
+}
+
+void Require(int result, const char *what) {
+  if (result != 1) {
+    throw std::runtime_error(std::string("failed to ") + what);
+  }
+}
+
+bssl::UniquePtr<EVP_PKEY> GenerateKey() {
+  bssl::UniquePtr<RSA> rsa(RSA_new());
+  bssl::UniquePtr<BIGNUM> exponent(BN_new());
+  Require(BN_set_word(exponent.get(), RSA_F4), "set the RSA exponent");
+  Require(RSA_generate_key_ex(rsa.get(), 2048, exponent.get(), nullptr), "generate an RSA key");
+  bssl::UniquePtr<EVP_PKEY> key(EVP_PKEY_new());
+  Require(EVP_PKEY_assign_RSA(key.get(), rsa.release()), "wrap the RSA key");
+  return key;
+}
+}  // namespace
+
+const long TokenIssuer::token_lifetime_seconds;
+
+TokenIssuer::TokenIssuer(std::string issuer, std::string client_id)
+    : issuer_(std::move(issuer)), client_id_(std::move(client_id)), key_(GenerateKey()) {
+  auto rsa = EVP_PKEY_get0_RSA(key_.get());
+  const BIGNUM *n, *e;
+  RSA_get0_key(rsa, &n, &e, nullptr);
+  jwks_ = absl::StrCat("{\"keys\":[{\"kty\":\"RSA\",\"alg\":\"RS256\",\"use\":\"sig\",\"kid\":\"", key_id,
+                       "\",\"n\":\"", Base64Url(n), "\",\"e\":\"", Base64Url(e), "\"}]}");
+}
+
+EVP_PKEY *TokenIssuer::Key() const { return key_.get(); }
+
+const std::string &TokenIssuer::Jwks() const { return jwks_; }
+
+std::string TokenIssuer::IdToken(absl::string_view nonce, absl::string_view claims) const {
+  auto now = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  auto header = absl::StrCat("{\"alg\":\"RS256\",\"typ\":\"JWT\",\"kid\":\"", key_id, "\"}");
+  auto payload = absl::StrCat("{\"iss\":\"", issuer_, "\",\"sub\":\"load-generator\",\"aud\":\"", client_id_,
+                              "\",\"nonce\":\"", nonce, "\",\"iat\":", now, ",\"exp\":", now + token_lifetime_seconds,
+                              claims.empty() ? "" : ",", claims, "}");
+  auto signed_part = absl::StrCat(Base64Url(header), ".", Base64Url(payload));
+
+  bssl::ScopedEVP_MD_CTX context;
+  Require(EVP_DigestSignInit(context.get(), nullptr, EVP_sha256(), nullptr, key_.get()), "sign the id token");
+  Require(EVP_DigestSignUpdate(context.get(), signed_part.data(), signed_part.size()), "sign the id token");
+  size_t length = 0;
+  Require(EVP_DigestSignFinal(context.get(), nullptr, &length), "sign the id token");
+  std::string signature(length, '\0');
+  Require(EVP_DigestSignFinal(context.get(), reinterpret_cast<uint8_t *>(&signature[0]), &length),
+          "sign the id token");
+  signature.resize(length);
+  return absl::StrCat(signed_part, ".", Base64Url(signature));
+}
+
+}  // namespace bench
+}  // namespace authservice
@@ -0,0 +1,55 @@
+#ifndef AUTHSERVICE_BENCH_TOKEN_ISSUER_H_
+#define AUTHSERVICE_BENCH_TOKEN_ISSUER_H_
+#include <string>
+#include "absl/strings/string_view.h"
+#include "openssl/evp.h"
+
+namespace authservice {
+namespace bench {
+
+/**
+ * TokenIssuer signs id tokens the way an OIDC provider does, with an RS256 key generated when it is constructed,
+ * and publishes the key as a JWKS so the tokens can be verified.
+ */
+class TokenIssuer {
+ public:
+  // How long issued tokens are valid for.
+  static const long token_lifetime_seconds = 3600;
+
+  /**
+   * @param issuer the `iss` claim of the tokens.
+   * @param client_id the `aud` claim of the tokens.
+   * @throw std::runtime_error if the key cannot be generated.
+   */
+  TokenIssuer(std::string issuer, std::string client_id);
+
+  /**
+   * @return the signing key.
+   */
+  EVP_PKEY *Key() const;
+
+  /**
+   * @return a JWKS holding the public half of the signing key.
+   */
+  const std::string &Jwks() const;
+
+  /**
+   * Issue an id token.
+   * @param nonce the `nonce` claim.
+   * @param claims further claims, as JSON members to add to the payload, or empty.
+   * @return the signed id token.
+   * @throw std::runtime_error if the token cannot be signed.
+   */
+  std::string IdToken(absl::string_view nonce, absl::string_view claims = "") const;
+
+ private:
+  std::string issuer_;
+  std::string client_id_;
+  bssl::UniquePtr<EVP_PKEY> key_;
+  std::string jwks_;
+};
+
+}  // namespace bench
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_BENCH_TOKEN_ISSUER_H_
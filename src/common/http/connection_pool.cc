@@ -0,0 +1,240 @@
+#include "connection_pool.h"
+#include <sys/socket.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <deque>
+#include <iterator>
+#include <tuple>
+#include "spdlog/spdlog.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+namespace {
+void Close(ConnectionPool::Stream &stream) {
+  boost::system::error_code ec;
+  boost::beast::get_lowest_layer(stream).socket().close(ec);
+}
+
+/**
+ * @return whether an idle connection can still be used.
+ */
+bool Healthy(ConnectionPool::Stream &stream) {
+  auto &socket = boost::beast::get_lowest_layer(stream).socket();
+  if (!socket.is_open()) {
+    return false;
+  }
+  // An idle connection should have nothing to read. Reading end of stream
+  // means the peer closed it, and any data is most likely a TLS close_notify
+  // alert. Either way the connection cannot carry another request.
+  char byte;
+  auto received =
+      ::recv(socket.native_handle(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+  return received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+/**
+ * The idle connections of every pool that belong to one io_context. As a
+ * service of the io_context it is shut down when the io_context is destroyed,
+ * which closes the connections before the reactor they are registered with
+ * goes away.
+ *
+ * Connections are swept lazily: once one has been idle for its pool's idle
+ * timeout, the next Acquire or Release on the io_context closes every
+ * connection that has timed out, that the peer has closed or whose pool has
+ * been destroyed, whether or not it would have been acquired again. Nothing is
+ * scheduled on the io_context, so idle connections never keep run() from
+ * returning.
+ */
+class IdleConnections : public boost::asio::execution_context::service {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Idle {
+    ConnectionPool::StreamPtr stream;
+    Clock::time_point since;
+  };
+
+  struct Connections {
+    // Expired once the pool the connections were released to is destroyed.
+    std::weak_ptr<const bool> pool;
+    // The idle timeout of the pool.
+    Clock::duration idle_timeout;
+    // Most recently released last.
+    std::deque<Idle> idle;
+  };
+
+  // The pool, host and port of the connections.
+  typedef std::tuple<uint64_t, std::string, int32_t> Key;
+
+  static boost::asio::execution_context::id id;
+
+  explicit IdleConnections(boost::asio::execution_context &context)
+      : boost::asio::execution_context::service(context),
+        sweep_at_(Clock::time_point::max()) {}
+
+  std::mutex mutex;
+  std::map<Key, Connections> connections;
+
+  /**
+   * Sweep the connections by the given time, unless a sweep is due earlier.
+   * Call with the mutex held.
+   */
+  void ScheduleSweep(Clock::time_point at) { sweep_at_ = std::min(sweep_at_, at); }
+
+  /**
+   * Take out the connections that can no longer be used if a sweep is due.
+   * Call with the mutex held, and close them once it is released.
+   * @param now     the current time.
+   * @param closing where to move the connections to.
+   */
+  void SweepIfDue(Clock::time_point now, std::deque<Idle> &closing) {
+    if (now < sweep_at_) {
+      return;
+    }
+    auto next = Clock::time_point::max();
+    for (auto it = connections.begin(); it != connections.end();) {
+      auto &pooled = it->second;
+      for (auto idle = pooled.idle.begin(); idle != pooled.idle.end();) {
+        if (pooled.pool.expired() || now - idle->since >= pooled.idle_timeout || !Healthy(*idle->stream)) {
+          closing.push_back(std::move(*idle));
+          idle = pooled.idle.erase(idle);
+        } else {
+          next = std::min(next, idle->since + pooled.idle_timeout);
+          ++idle;
+        }
+      }
+      it = pooled.idle.empty() ? connections.erase(it) : std::next(it);
+    }
+    sweep_at_ = next;
+  }
+
+ private:
+  void shutdown() override {
+    std::map<Key, Connections> closing;
+    std::lock_guard<std::mutex> lock(mutex);
+    closing.swap(connections);
+  }
+
+  // When the next sweep is due, or the maximum time point if none is.
+  // Accessed with the mutex held.
+  Clock::time_point sweep_at_;
+};
+
+boost::asio::execution_context::id IdleConnections::id;
+
+uint64_t NextPoolId() {
+  static std::atomic<uint64_t> next(1);
+  return next++;
+}
+}  // namespace
+
+ConnectionPool::ConnectionPool(size_t max_idle,
+                               std::chrono::steady_clock::duration idle_timeout)
+    : max_idle_(max_idle),
+      idle_timeout_(idle_timeout),
+      tls_metrics_(),
+      id_(NextPoolId()),
+      alive_(std::make_shared<bool>(true)) {}
+
+ConnectionPool::ConnectionPool(const TlsContext::Metrics &tls_metrics)
+    : ConnectionPool() {
+  tls_metrics_ = tls_metrics;
+}
+
+ConnectionPool::StreamPtr ConnectionPool::Acquire(
+    const authservice::config::common::Endpoint &endpoint,
+    boost::asio::io_context &ioc) {
+  auto &pooled = boost::asio::use_service<IdleConnections>(ioc);
+  std::deque<IdleConnections::Idle> stale;
+  StreamPtr result;
+  {
+    std::lock_guard<std::mutex> lock(pooled.mutex);
+    auto now = std::chrono::steady_clock::now();
+    pooled.SweepIfDue(now, stale);
+    auto found = pooled.connections.find(
+        IdleConnections::Key(id_, endpoint.hostname(), endpoint.port()));
+    if (found != pooled.connections.end()) {
+      auto &connections = found->second.idle;
+      // Prefer the most recently used connection, which is the least likely
+      // to have been closed by the peer.
+      while (!connections.empty()) {
+        auto idle = std::move(connections.back());
+        connections.pop_back();
+        if (now - idle.since < idle_timeout_ && Healthy(*idle.stream)) {
+          result = std::move(idle.stream);
+          break;
+        }
+        stale.push_back(std::move(idle));
+      }
+      // Anything older than a connection that timed out has timed out too.
+      while (!connections.empty() &&
+             now - connections.front().since >= idle_timeout_) {
+        stale.push_back(std::move(connections.front()));
+        connections.pop_front();
+      }
+    }
+  }
+  // Close discarded connections outside the lock.
+  for (auto &idle : stale) {
+    Close(*idle.stream);
+  }
+  if (!stale.empty()) {
+    spdlog::debug("{}: discarded {} stale connections", __func__,
+                  stale.size());
+  }
+  return result;
+}
+
+void ConnectionPool::Release(
+    const authservice::config::common::Endpoint &endpoint,
+    boost::asio::io_context &ioc, StreamPtr stream) {
+  auto &pooled = boost::asio::use_service<IdleConnections>(ioc);
+  std::deque<IdleConnections::Idle> closing;
+  {
+    std::lock_guard<std::mutex> lock(pooled.mutex);
+    auto now = std::chrono::steady_clock::now();
+    pooled.SweepIfDue(now, closing);
+    // Discard the connections of destroyed pools, which no one can acquire.
+    for (auto it = pooled.connections.begin(); it != pooled.connections.end();) {
+      if (it->second.pool.expired()) {
+        std::move(it->second.idle.begin(), it->second.idle.end(),
+                  std::back_inserter(closing));
+        it = pooled.connections.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    auto &connections = pooled.connections[IdleConnections::Key(
+        id_, endpoint.hostname(), endpoint.port())];
+    connections.pool = alive_;
+    connections.idle_timeout = idle_timeout_;
+    if (connections.idle.size() < max_idle_) {
+      connections.idle.push_back({std::move(stream), now});
+      stream = nullptr;
+      pooled.ScheduleSweep(now + idle_timeout_);
+    }
+  }
+  for (auto &idle : closing) {
+    Close(*idle.stream);
+  }
+  if (stream != nullptr) {
+    Close(*stream);
+  }
+}
+
+TlsContext &ConnectionPool::Context(
+    const authservice::config::common::Endpoint &endpoint) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &context =
+      contexts_[std::make_pair(endpoint.hostname(), endpoint.port())];
+  if (!context) {
+    context.reset(new TlsContext(tls_metrics_));
+  }
+  return *context;
+}
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,106 @@
+#ifndef AUTHSERVICE_SRC_COMMON_HTTP_CONNECTION_POOL_H_
+#define AUTHSERVICE_SRC_COMMON_HTTP_CONNECTION_POOL_H_
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "config/common/config.pb.h"
+#include "src/common/http/tls_context.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+
+class ConnectionPool;
+typedef std::shared_ptr<ConnectionPool> ConnectionPoolPtr;
+
+/**
+ * A pool of idle keep-alive HTTPS connections, kept per endpoint and
+ * io_context, and of the TLS contexts used to create them, kept per endpoint.
+ * A connection is used by one request at a time: it is acquired from the
+ * pool, used, and released back to it. Thread safe.
+ *
+ * Idle connections are held by the io_context they belong to rather than by
+ * the pool, so they are closed when the io_context is destroyed even if the
+ * pool outlives it, and are never handed to an io_context created later.
+ * Once a connection has been idle for the pool's idle timeout, the next
+ * Acquire or Release on its io_context closes every idle connection there
+ * that has timed out or that the peer has closed. Those of a destroyed pool
+ * are closed then too, and the next time a connection is released on their
+ * io_context.
+ */
+class ConnectionPool {
+ public:
+  typedef boost::beast::ssl_stream<boost::beast::tcp_stream> Stream;
+  typedef std::unique_ptr<Stream> StreamPtr;
+
+  /**
+   * Create a pool.
+   * @param max_idle     the maximum number of idle connections kept per
+   * endpoint. Connections released beyond it are closed.
+   * @param idle_timeout how long a connection may stay idle before it is
+   * closed rather than reused.
+   */
+  explicit ConnectionPool(
+      size_t max_idle = 16,
+      std::chrono::steady_clock::duration idle_timeout = std::chrono::seconds(30));
+
+  /**
+   * Create a pool with the default limits whose TLS contexts count their
+   * handshakes in the given series as well.
+   * @param tls_metrics the series.
+   */
+  explicit ConnectionPool(const TlsContext::Metrics &tls_metrics);
+
+  /**
+   * Take an idle connection to the endpoint. Connections that have been idle
+   * too long, or that the peer has closed or written to while idle, are
+   * discarded.
+   * @param endpoint the endpoint.
+   * @param ioc      the io_context the connection must belong to.
+   * @return an open connection, or nullptr if there is none.
+   */
+  StreamPtr Acquire(const authservice::config::common::Endpoint &endpoint,
+                    boost::asio::io_context &ioc);
+
+  /**
+   * Return a connection that is ready for another request to the pool.
+   * @param endpoint the endpoint the connection is open to.
+   * @param ioc      the io_context the connection belongs to.
+   * @param stream   the connection.
+   */
+  void Release(const authservice::config::common::Endpoint &endpoint,
+               boost::asio::io_context &ioc, StreamPtr stream);
+
+  /**
+   * Get the TLS context for connections to the endpoint, creating it on first
+   * use. Call this while configuring to load the CA bundle up front.
+   * @param endpoint the endpoint.
+   * @return the TLS context.
+   */
+  TlsContext &Context(const authservice::config::common::Endpoint &endpoint);
+
+ private:
+  const size_t max_idle_;
+  const std::chrono::steady_clock::duration idle_timeout_;
+  TlsContext::Metrics tls_metrics_;
+  // Tells this pool's idle connections apart from those of other pools,
+  // including destroyed ones, on the same io_context.
+  const uint64_t id_;
+  // Expires when the pool is destroyed, so its idle connections are discarded.
+  const std::shared_ptr<const bool> alive_;
+
+  std::mutex mutex_;
+  std::map<std::pair<std::string, int32_t>, std::unique_ptr<TlsContext>> contexts_;
+};
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_COMMON_HTTP_CONNECTION_POOL_H_
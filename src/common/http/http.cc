@@ -5,6 +5,7 @@
 #include <boost/asio/spawn.hpp>
 #include <boost/beast.hpp>
 #include <boost/beast/ssl.hpp>
+#include <chrono>
 #include <iomanip>
 #include <ios>
 #include <iostream>
@@ -107,6 +108,98 @@ absl::optional<std::string> SafeDecode(absl::string_view in,
   return builder.str();
 }
 
+
+// Whether an error writing to a connection means the peer had closed it.
+bool ClosedByPeer(const boost::system::error_code &ec) {
+  return ec == beast::http::error::end_of_stream || ec == net::error::eof ||
+         ec == net::error::connection_reset || ec == net::error::broken_pipe ||
+         ec == ssl::error::stream_truncated;
+}
+
+const std::chrono::milliseconds default_connect_timeout(5000);
+const std::chrono::milliseconds default_request_timeout(10000);
+
+std::chrono::milliseconds ConnectTimeout(
+    const authservice::config::common::Endpoint &endpoint) {
+  return endpoint.connect_timeout_ms() > 0
+             ? std::chrono::milliseconds(endpoint.connect_timeout_ms())
+             : default_connect_timeout;
+}
+
+std::chrono::milliseconds RequestTimeout(
+    const authservice::config::common::Endpoint &endpoint) {
+  return endpoint.request_timeout_ms() > 0
+             ? std::chrono::milliseconds(endpoint.request_timeout_ms())
+             : default_request_timeout;
+}
+
+// The executor a co-routine runs on, through which anything else that touches
+// its I/O objects must go.
+auto CoroutineExecutor(boost::asio::yield_context yield) {
+  net::async_completion<boost::asio::yield_context, void()> completion(yield);
+  return net::get_associated_executor(completion.completion_handler);
+}
+
+// Cancels the I/O of a request's connection when its call is cancelled, so
+// the request's co-routine does not wait for the endpoint's timeouts. The
+// cancellation is posted to the co-routine's executor, on which it does not
+// race with the co-routine's own use of the connection.
+class Canceller {
+ public:
+  Canceller(const common::utilities::Deadline &deadline,
+            boost::asio::yield_context yield)
+      : stream_(std::make_shared<ConnectionPool::Stream *>(nullptr)),
+        registration_(deadline.OnCancel(
+            [stream = stream_, executor = CoroutineExecutor(yield)]() {
+              net::post(executor, [stream]() {
+                if (*stream != nullptr) {
+                  beast::get_lowest_layer(**stream).cancel();
+                }
+              });
+            })) {}
+
+  // The co-routine does not suspend between destroying its connection and
+  // this, so a posted cancellation never sees a destroyed one.
+  ~Canceller() { *stream_ = nullptr; }
+
+  /**
+   * Set the connection the request is using.
+   * @param stream the connection, nullptr if none.
+   */
+  void Use(ConnectionPool::Stream *stream) { *stream_ = stream; }
+
+ private:
+  // Only used on the co-routine's executor.
+  const std::shared_ptr<ConnectionPool::Stream *> stream_;
+  const common::utilities::Deadline::Registration registration_;
+};
+
+// Open a connection to the endpoint. Resolving its host, connecting and the
+// TLS handshake must each complete within the given timeout, and before the
+// deadline.
+ConnectionPool::StreamPtr Connect(
+    const authservice::config::common::Endpoint &endpoint, TlsContext &tls,
+    ResolverCache &resolver, std::chrono::steady_clock::duration timeout,
+    const common::utilities::Deadline &deadline, Canceller &canceller,
+    boost::asio::io_context &ioc, boost::asio::yield_context yield) {
+  ConnectionPool::StreamPtr stream(new ConnectionPool::Stream(ioc, tls.Context()));
+  canceller.Use(stream.get());
+  if (!SSL_set_tlsext_host_name(stream->native_handle(),
+                                endpoint.hostname().c_str())) {
+    throw boost::system::system_error{
+        boost::system::error_code{static_cast<int>(::ERR_get_error()),
+                                  boost::asio::error::get_ssl_category()}};
+  }
+  const auto results =
+      resolver.Resolve(endpoint.hostname(), std::to_string(endpoint.port()),
+                       timeout, deadline, ioc, yield);
+  beast::get_lowest_layer(*stream).expires_after(deadline.Clamp(timeout));
+  beast::get_lowest_layer(*stream).async_connect(results, yield);
+  tls.PrepareResumption(stream->native_handle());
+  stream->async_handshake(ssl::stream_base::client, yield);
+  tls.RecordHandshake(stream->native_handle());
+  return stream;
+}
 }  // namespace
 
 std::string http::UrlSafeEncode(absl::string_view url) {
@@ -286,6 +379,13 @@ std::string http::ToUrl(const authservice::config::common::Endpoint &endpoint) {
   return builder.str();
 }
 
+http_impl::http_impl()
+    : http_impl(std::make_shared<ConnectionPool>(),
+                std::make_shared<ResolverCache>()) {}
+
+http_impl::http_impl(ConnectionPoolPtr pool, ResolverCachePtr resolver)
+    : pool_(std::move(pool)), resolver_(std::move(resolver)) {}
+
 response_t http_impl::Post(
     const authservice::config::common::Endpoint &endpoint,
     const std::map<absl::string_view, absl::string_view> &headers,
@@ -297,12 +397,10 @@ response_t http_impl::Post(
 
     // The io_context is required for all I/O
     net::io_context ioc;
-    ssl::context ctx(ssl::context::tlsv12_client);
-    ctx.set_verify_mode(ssl::verify_peer);
-    ctx.set_default_verify_paths();
+    auto &tls = pool_->Context(endpoint);
 
     tcp::resolver resolver(ioc);
-    beast::ssl_stream<beast::tcp_stream> stream(ioc, ctx);
+    beast::ssl_stream<beast::tcp_stream> stream(ioc, tls.Context());
     if (!SSL_set_tlsext_host_name(stream.native_handle(),
                                   endpoint.hostname().c_str())) {
       boost::system::error_code ec{static_cast<int>(::ERR_get_error()),
@@ -312,7 +410,9 @@ response_t http_impl::Post(
     const auto results =
         resolver.resolve(endpoint.hostname(), std::to_string(endpoint.port()));
     beast::get_lowest_layer(stream).connect(results);
+    tls.PrepareResumption(stream.native_handle());
     stream.handshake(ssl::stream_base::client);
+    tls.RecordHandshake(stream.native_handle());
     // Set up an HTTP POST request message
     beast::http::request<beast::http::string_body> req{
         beast::http::verb::post, endpoint.path(), version};
@@ -353,30 +453,36 @@ response_t http_impl::Post(
         const authservice::config::common::Endpoint &endpoint,
         const std::map<absl::string_view, absl::string_view> &headers,
         absl::string_view body,
+        const common::utilities::Deadline& deadline,
+        boost::asio::io_context& ioc,
+        boost::asio::yield_context yield) const {
+  return Request(beast::http::verb::post, endpoint, headers, body, deadline, ioc, yield);
+}
+
+response_t http_impl::Get(
+        const authservice::config::common::Endpoint &endpoint,
+        const std::map<absl::string_view, absl::string_view> &headers,
+        const common::utilities::Deadline& deadline,
+        boost::asio::io_context& ioc,
+        boost::asio::yield_context yield) const {
+  return Request(beast::http::verb::get, endpoint, headers, "", deadline, ioc, yield);
+}
+
+response_t http_impl::Request(
+        beast::http::verb method,
+        const authservice::config::common::Endpoint &endpoint,
+        const std::map<absl::string_view, absl::string_view> &headers,
+        absl::string_view body,
+        const common::utilities::Deadline& deadline,
         boost::asio::io_context& ioc,
         boost::asio::yield_context yield) const {
   spdlog::trace("{}", __func__);
   try {
     int version = 11;
 
-    ssl::context ctx(ssl::context::tlsv12_client);
-    ctx.set_verify_mode(ssl::verify_peer);
-    ctx.set_default_verify_paths();
-
-    tcp::resolver resolver(ioc);
-    beast::ssl_stream<beast::tcp_stream> stream(ioc, ctx);
-    if (!SSL_set_tlsext_host_name(stream.native_handle(),
-                                  endpoint.hostname().c_str())) {
-      throw boost::system::error_code{static_cast<int>(::ERR_get_error()),
-                                      boost::asio::error::get_ssl_category()};
-    }
-    const auto results =
-            resolver.async_resolve(endpoint.hostname(), std::to_string(endpoint.port()), yield);
-    beast::get_lowest_layer(stream).async_connect(results, yield);
-    stream.async_handshake(ssl::stream_base::client, yield);
-    // Set up an HTTP POST request message
+    // Set up an HTTP request message
     beast::http::request<beast::http::string_body> req{
-            beast::http::verb::post, endpoint.path(), version};
+            method, endpoint.path(), version};
     req.set(beast::http::field::host, endpoint.hostname());
     for (auto header : headers) {
       req.set(boost::beast::string_view(header.first.data()),
@@ -385,28 +491,72 @@ response_t http_impl::Post(
     auto &req_body = req.body();
     req_body.reserve(body.size());
     req_body.append(body.begin(), body.end());
+    req.keep_alive(true);
     req.prepare_payload();
-    // Send the HTTP request to the remote host
-    beast::http::async_write(stream, req, yield);
 
-    // Read response
-    beast::flat_buffer buffer;
-    response_t res(new beast::http::response<beast::http::string_body>);
-    beast::http::async_read(stream, buffer, *res, yield);
+    Canceller canceller(deadline, yield);
+    uint32_t failures = 0;
+    while (true) {
+      if (deadline.Expired()) {
+        spdlog::info("{}: abandoning request to {}: {}", __func__, endpoint.hostname(),
+                     deadline.Cancelled() ? "call cancelled" : "deadline exceeded");
+        return response_t();
+      }
+      auto stream = pool_->Acquire(endpoint, ioc);
+      auto reused = stream != nullptr;
+      canceller.Use(stream.get());
+      if (!reused) {
+        // Nothing has been sent yet, so a failure to connect can be retried within the endpoint's budget.
+        try {
+          stream = Connect(endpoint, pool_->Context(endpoint), *resolver_, ConnectTimeout(endpoint), deadline,
+                           canceller, ioc, yield);
+        } catch (const boost::system::system_error &e) {
+          if (failures++ < endpoint.retries()) {
+            spdlog::debug("{}: failed to connect to {}, retrying: {}", __func__, endpoint.hostname(), e.what());
+            continue;
+          }
+          throw;
+        }
+      }
 
-    // Gracefully close the socket.
-    // Receive an error code instead of throwing an exception if this fails, so we can ignore some
-    // expected not_connected errors.
-    boost::system::error_code ec;
-    stream.async_shutdown(yield[ec]);
+      // Send the HTTP request to the remote host.
+      // Receive an error code instead of throwing an exception, so a reused connection the peer closed before the
+      // request could reach it can be retried.
+      boost::system::error_code ec;
+      beast::get_lowest_layer(*stream).expires_after(deadline.Clamp(RequestTimeout(endpoint)));
+      auto written = beast::http::async_write(*stream, req, yield[ec]);
+      if (ec) {
+        if (reused && written == 0 && ClosedByPeer(ec)) {
+          spdlog::debug("{}: reused connection failed, retrying on a new connection: {}", __func__, ec.message());
+          continue;
+        }
+        throw boost::system::system_error(ec);
+      }
 
-    // not_connected happens sometimes so don't bother reporting it.
-    if (ec && ec != beast::errc::not_connected) {
-      spdlog::info("{}: HTTP error encountered: {}", __func__, ec.message());
-      return response_t();
+      // Read the response. Once the request has been sent it may have reached the endpoint, which may not handle it
+      // idempotently, as with authorization codes, so no failure from here on is retried.
+      beast::flat_buffer buffer;
+      response_t res(new beast::http::response<beast::http::string_body>);
+      beast::http::async_read(*stream, buffer, *res, yield);
+
+      if (res->keep_alive()) {
+        canceller.Use(nullptr);
+        beast::get_lowest_layer(*stream).expires_never();
+        pool_->Release(endpoint, ioc, std::move(stream));
+      } else {
+        // Gracefully close the socket.
+        // Receive an error code instead of throwing an exception if this fails, so we can ignore some
+        // expected not_connected errors.
+        stream->async_shutdown(yield[ec]);
+
+        // not_connected happens sometimes so don't bother reporting it.
+        if (ec && ec != beast::errc::not_connected) {
+          spdlog::info("{}: HTTP error encountered: {}", __func__, ec.message());
+          return response_t();
+        }
+      }
+      return res;
     }
-    return res;
-    // If we get here then the connection is closed gracefully
   } catch (std::exception const &e) {
     spdlog::info("{}: unexpected exception: {}", __func__, e.what());
     return response_t();
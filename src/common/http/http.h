@@ -11,6 +11,9 @@
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "config/common/config.pb.h"
+#include "src/common/utilities/deadline.h"
+#include "src/common/http/connection_pool.h"
+#include "src/common/http/resolver_cache.h"
 namespace beast = boost::beast;  // from <boost/beast.hpp>
 
 namespace authservice {
@@ -138,12 +141,28 @@ class http {
    * @param endpoint the endpoint to call
    * @param headers the http headers
    * @param body the http request body
-   * @return http response.
+   * @param deadline the deadline of the call on whose behalf the message is sent
+   * @return http response, or nullptr on failure or once the deadline expires.
    */
   virtual response_t Post(
           const authservice::config::common::Endpoint &endpoint,
           const std::map<absl::string_view, absl::string_view> &headers,
           absl::string_view body,
+          const common::utilities::Deadline& deadline,
+          boost::asio::io_context& ioc,
+          boost::asio::yield_context yield) const = 0;
+
+  /** @brief Asynchronously send a Get http message. To be used inside a Boost co-routine.
+   *
+   * @param endpoint the endpoint to call
+   * @param headers the http headers
+   * @param deadline the deadline of the call on whose behalf the message is sent
+   * @return http response, or nullptr on failure or once the deadline expires.
+   */
+  virtual response_t Get(
+          const authservice::config::common::Endpoint &endpoint,
+          const std::map<absl::string_view, absl::string_view> &headers,
+          const common::utilities::Deadline& deadline,
           boost::asio::io_context& ioc,
           boost::asio::yield_context yield) const = 0;
 };
@@ -152,15 +171,72 @@ class http {
  * HTTP request implementation
  */
 class http_impl : public http {
+ private:
+  ConnectionPoolPtr pool_;
+  ResolverCachePtr resolver_;
+
+  /**
+   * Send a request asynchronously as described for Post below.
+   */
+  response_t Request(
+          beast::http::verb method,
+          const authservice::config::common::Endpoint &endpoint,
+          const std::map<absl::string_view, absl::string_view> &headers,
+          absl::string_view body,
+          const common::utilities::Deadline& deadline,
+          boost::asio::io_context& ioc,
+          boost::asio::yield_context yield) const;
+
  public:
+  /**
+   * Create a client that keeps up to 16 idle connections per endpoint open
+   * for up to 30 seconds, and caches DNS resolutions for 60 seconds.
+   */
+  http_impl();
+
+  /**
+   * Create a client that reuses the connections of the given pool and the
+   * resolutions of the given cache.
+   * @param pool     the connection pool used by the asynchronous Post.
+   * @param resolver the DNS cache used by the asynchronous Post.
+   */
+  http_impl(ConnectionPoolPtr pool, ResolverCachePtr resolver);
+
   response_t Post(const authservice::config::common::Endpoint &Endpoint,
                   const std::map<absl::string_view, absl::string_view> &headers,
                   absl::string_view body) const override;
 
+  /**
+   * Sends the request over a pooled keep-alive connection when one is idle,
+   * and returns the connection to the pool afterwards. A request is only
+   * retried when nothing of it can have reached the endpoint: when writing it
+   * to a reused connection fails before a single byte is written because the
+   * peer closed the connection while it was idle, the request is sent again
+   * on the next pooled connection, or on a new one once the pool has none
+   * left for the endpoint. So the request may be tried once per idle pooled
+   * connection. Once written, it is never retried, and failing to read the
+   * response fails the call.
+   * Each attempt must connect within the endpoint's connect timeout and
+   * complete the exchange within its request timeout. Attempts that fail
+   * while connecting are retried up to the endpoint's number of retries.
+   * Timeouts are shortened to end by the deadline, and no further attempt is
+   * made once it has expired.
+   */
   response_t Post(
           const authservice::config::common::Endpoint &endpoint,
           const std::map<absl::string_view, absl::string_view> &headers,
           absl::string_view body,
+          const common::utilities::Deadline& deadline,
+          boost::asio::io_context& ioc,
+          boost::asio::yield_context yield) const override;
+
+  /**
+   * Sends the request in the same way as the asynchronous Post.
+   */
+  response_t Get(
+          const authservice::config::common::Endpoint &endpoint,
+          const std::map<absl::string_view, absl::string_view> &headers,
+          const common::utilities::Deadline& deadline,
           boost::asio::io_context& ioc,
           boost::asio::yield_context yield) const override;
 };
@@ -0,0 +1,343 @@
+#include "resolver_cache.h"
+#include <algorithm>
+#include "spdlog/spdlog.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+
+struct ResolverCache::Pending {
+  typedef boost::asio::async_completion<boost::asio::yield_context,
+                                        void()>::completion_handler_type
+      Handler;
+
+  // A lookup waiting for the resolution, resumed by whichever comes first of
+  // the resolution ending, which may happen on another io_context's thread,
+  // its timeout and its call being cancelled. The work guard keeps the
+  // lookup's io_context running until it is resumed.
+  struct Waiter {
+    Waiter(boost::asio::io_context &ioc, Handler handler)
+        : handler(new Handler(std::move(handler))),
+          work(boost::asio::make_work_guard(*this->handler)),
+          timer(ioc) {}
+
+    /**
+     * Resume the lookup unless it has been already, on its own executor.
+     */
+    void Resume() {
+      std::unique_ptr<Handler> resume;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        resume = std::move(handler);
+        timer.cancel();
+      }
+      if (resume != nullptr) {
+        boost::asio::post(std::move(*resume));
+        work.reset();
+      }
+    }
+
+    // Guards the fields below
+    std::mutex mutex;
+    std::unique_ptr<Handler> handler;
+    decltype(boost::asio::make_work_guard(std::declval<Handler &>())) work;
+    // Expires at the lookup's timeout, clamped by its deadline.
+    boost::asio::steady_timer timer;
+  };
+
+  // The lookups waiting for the resolution, including the one that started it.
+  std::vector<std::shared_ptr<Waiter>> waiters;
+  // Cancels the resolution, set once it has started.
+  std::function<void()> cancel;
+  // The outcome, set before the waiters are resumed.
+  bool finished = false;
+  Results results;
+  boost::system::error_code ec;
+};
+
+ResolverCache::ResolverCache(std::chrono::steady_clock::duration ttl,
+                             std::chrono::steady_clock::duration max_stale,
+                             std::chrono::steady_clock::duration retry)
+    : ttl_(ttl),
+      max_stale_(max_stale),
+      retry_(retry),
+      metrics_(),
+      stats_({0, 0, 0, 0, std::chrono::nanoseconds(0),
+              std::chrono::nanoseconds(0)}) {}
+
+ResolverCache::ResolverCache(const Metrics &metrics) : ResolverCache() {
+  metrics_ = metrics;
+}
+
+ResolverCache::Results ResolverCache::Resolve(
+    const std::string &host, const std::string &port,
+    std::chrono::steady_clock::duration timeout,
+    const utilities::Deadline &deadline, boost::asio::io_context &ioc,
+    boost::asio::yield_context yield) {
+  Key key(host, port);
+  auto now = std::chrono::steady_clock::now();
+  std::shared_ptr<Pending> pending;
+  Results cached;
+  bool hit = false;
+  bool refresh = false;
+  bool start = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find(key);
+    if (found != entries_.end()) {
+      auto &entry = found->second;
+      auto age = now - entry.resolved;
+      if (age < ttl_ + max_stale_) {
+        hit = true;
+        ++stats_.hits;
+        if (metrics_.hits != nullptr) {
+          metrics_.hits->Increment();
+        }
+        if (age >= ttl_ && !entry.refreshing && now >= entry.retry_at) {
+          entry.refreshing = true;
+          ++stats_.refreshes;
+          refresh = true;
+        }
+        cached = entry.results;
+      }
+    }
+    if (!hit) {
+      ++stats_.misses;
+      if (metrics_.misses != nullptr) {
+        metrics_.misses->Increment();
+      }
+
+      // Wait for a resolution another lookup has started rather than
+      // starting another.
+      auto resolving = pending_.find(key);
+      if (resolving != pending_.end()) {
+        pending = resolving->second;
+      } else {
+        pending = std::make_shared<Pending>();
+        pending_.emplace(key, pending);
+        start = true;
+      }
+    }
+  }
+  // Resolutions start outside the lock, which their handlers take when they
+  // end, however early that is.
+  if (hit) {
+    if (refresh) {
+      Refresh(key, ioc);
+    }
+    return cached;
+  }
+  if (start) {
+    Start(key, pending, ioc);
+  }
+  return Wait(pending, timeout, deadline, ioc, yield);
+}
+
+ResolverCache::Results ResolverCache::Wait(
+    const std::shared_ptr<Pending> &pending,
+    std::chrono::steady_clock::duration timeout,
+    const utilities::Deadline &deadline, boost::asio::io_context &ioc,
+    boost::asio::yield_context yield) {
+  boost::asio::async_completion<boost::asio::yield_context, void()> completion(
+      yield);
+  auto waiter = std::make_shared<Pending::Waiter>(
+      ioc, std::move(completion.completion_handler));
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending->finished) {
+      waiter->Resume();
+    } else {
+      pending->waiters.push_back(waiter);
+    }
+  }
+
+  // However long the resolution takes, the lookup waits no longer than its
+  // timeout and deadline allow.
+  {
+    std::lock_guard<std::mutex> waiter_lock(waiter->mutex);
+    if (waiter->handler != nullptr) {
+      waiter->timer.expires_after(deadline.Clamp(timeout));
+      waiter->timer.async_wait([waiter](const boost::system::error_code &ec) {
+        if (!ec) {
+          waiter->Resume();
+        }
+      });
+    }
+  }
+  {
+    auto registration = deadline.OnCancel([waiter]() { waiter->Resume(); });
+    completion.result.get();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!pending->finished) {
+    // Stop waiting. The resolution carries on for the other lookups waiting
+    // for it, and is cancelled once none are left.
+    pending->waiters.erase(std::remove(pending->waiters.begin(),
+                                       pending->waiters.end(), waiter),
+                           pending->waiters.end());
+    if (pending->waiters.empty() && pending->cancel) {
+      pending->cancel();
+    }
+    throw boost::system::system_error(
+        deadline.Cancelled() ? boost::asio::error::operation_aborted
+                             : boost::asio::error::timed_out);
+  }
+  if (pending->ec) {
+    throw boost::system::system_error(pending->ec);
+  }
+  return pending->results;
+}
+
+void ResolverCache::StartResolution(boost::asio::ip::tcp::resolver &resolver,
+                                    const std::string &host,
+                                    const std::string &port,
+                                    ResolutionHandler handler) {
+  resolver.async_resolve(host, port, std::move(handler));
+}
+
+void ResolverCache::Start(const Key &key,
+                          const std::shared_ptr<Pending> &pending,
+                          boost::asio::io_context &ioc) {
+  // Ends the resolution however it ends, including when its handler is
+  // destroyed with its io_context without ever running, so the lookups
+  // waiting for it are always resumed.
+  struct Resolution {
+    Resolution(ResolverCachePtr cache, Key key, std::shared_ptr<Pending> pending)
+        : cache(std::move(cache)),
+          key(std::move(key)),
+          pending(std::move(pending)) {}
+    ~Resolution() {
+      std::lock_guard<std::mutex> lock(cache->mutex_);
+      cache->Finish(key, pending, Results(),
+                    boost::asio::error::operation_aborted);
+    }
+    const ResolverCachePtr cache;
+    const Key key;
+    const std::shared_ptr<Pending> pending;
+  };
+  auto resolution =
+      std::make_shared<Resolution>(shared_from_this(), key, pending);
+  auto resolver = std::make_shared<boost::asio::ip::tcp::resolver>(ioc);
+  {
+    // Only called while the resolution has not finished, so its handler, and
+    // with it the resolver and its io_context, still exist.
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::weak_ptr<boost::asio::ip::tcp::resolver> weak = resolver;
+    pending->cancel = [executor = ioc.get_executor(), weak]() {
+      boost::asio::post(executor, [weak]() {
+        if (auto resolver = weak.lock()) {
+          resolver->cancel();
+        }
+      });
+    };
+  }
+  auto started = std::chrono::steady_clock::now();
+  StartResolution(
+      *resolver, key.first, key.second,
+      [resolution, resolver, started](const boost::system::error_code &ec,
+                                      Results results) {
+        auto &self = resolution->cache;
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        if (!ec) {
+          self->Store(resolution->key, results, started);
+        }
+        self->Finish(resolution->key, resolution->pending, results, ec);
+      });
+}
+
+ResolverCache::Stats ResolverCache::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void ResolverCache::Store(const Key &key, const Results &results,
+                          std::chrono::steady_clock::time_point started) {
+  auto now = std::chrono::steady_clock::now();
+  auto elapsed =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - started);
+  ++stats_.resolutions;
+  stats_.total_resolution_time += elapsed;
+  stats_.max_resolution_time = std::max(stats_.max_resolution_time, elapsed);
+  if (metrics_.resolution_duration != nullptr) {
+    metrics_.resolution_duration->Observe(elapsed);
+  }
+  entries_[key] = Entry{results, now, false, {}};
+}
+
+void ResolverCache::Finish(const Key &key,
+                           const std::shared_ptr<Pending> &pending,
+                           const Results &results,
+                           const boost::system::error_code &ec) {
+  auto found = pending_.find(key);
+  if (found == pending_.end() || found->second != pending) {
+    // Already finished.
+    return;
+  }
+  pending_.erase(found);
+  pending->finished = true;
+  pending->results = results;
+  pending->ec = ec;
+  for (auto &waiter : pending->waiters) {
+    waiter->Resume();
+  }
+  pending->waiters.clear();
+}
+
+void ResolverCache::Refresh(const Key &key, boost::asio::io_context &ioc) {
+  // Lets the entry be refreshed again once this refresh ends, including when
+  // its handler is destroyed with its io_context without ever running.
+  struct Refreshing {
+    Refreshing(ResolverCachePtr cache, Key key)
+        : cache(std::move(cache)), key(std::move(key)) {}
+    ~Refreshing() {
+      std::lock_guard<std::mutex> lock(cache->mutex_);
+      auto found = cache->entries_.find(key);
+      if (found != cache->entries_.end()) {
+        found->second.refreshing = false;
+      }
+    }
+    const ResolverCachePtr cache;
+    const Key key;
+  };
+  auto refreshing = std::make_shared<Refreshing>(shared_from_this(), key);
+  auto resolver = std::make_shared<boost::asio::ip::tcp::resolver>(ioc);
+  auto started = std::chrono::steady_clock::now();
+  try {
+    StartResolution(
+        *resolver, key.first, key.second,
+        [refreshing, resolver, started](const boost::system::error_code &ec,
+                                        Results results) {
+          auto &self = refreshing->cache;
+          auto &key = refreshing->key;
+          std::lock_guard<std::mutex> lock(self->mutex_);
+          if (ec) {
+            // Keep serving the stale results, and back off before the next
+            // attempt rather than resolving again on every lookup.
+            spdlog::info("{}: refreshing {}:{} failed: {}", __func__, key.first,
+                         key.second, ec.message());
+            auto found = self->entries_.find(key);
+            if (found != self->entries_.end()) {
+              found->second.retry_at =
+                  std::chrono::steady_clock::now() + self->retry_;
+            }
+            return;
+          }
+          self->Store(key, results, started);
+        });
+  } catch (const std::exception &e) {
+    // Handled like a failed refresh, as the lookup that started it can be
+    // served the stale results regardless.
+    spdlog::info("{}: refreshing {}:{} failed: {}", __func__, key.first,
+                 key.second, e.what());
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find(key);
+    if (found != entries_.end()) {
+      found->second.retry_at = std::chrono::steady_clock::now() + retry_;
+    }
+  }
+}
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
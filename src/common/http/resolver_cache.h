@@ -0,0 +1,198 @@
+#ifndef AUTHSERVICE_SRC_COMMON_HTTP_RESOLVER_CACHE_H_
+#define AUTHSERVICE_SRC_COMMON_HTTP_RESOLVER_CACHE_H_
+#include <boost/asio.hpp>
+#include <boost/asio/spawn.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "src/common/metrics/metrics.h"
+#include "src/common/utilities/deadline.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+
+class ResolverCache;
+typedef std::shared_ptr<ResolverCache> ResolverCachePtr;
+
+/**
+ * A cache of DNS resolutions keyed by host and port. Fresh results are served
+ * from memory. Once results are older than the TTL they are still served, but
+ * a refresh is started in the background; only results older than the maximum
+ * staleness, or hosts never seen before, are resolved while the caller waits.
+ * Concurrent lookups of a host that must be resolved wait for one resolution,
+ * each for no longer than its own timeout and deadline allow, and the
+ * resolution is cancelled once none wait for it any more. A failed refresh
+ * keeps the previous results, and the next refresh waits for the retry
+ * interval. Thread safe.
+ */
+class ResolverCache : public std::enable_shared_from_this<ResolverCache> {
+ public:
+  virtual ~ResolverCache() = default;
+
+  typedef boost::asio::ip::tcp::resolver::results_type Results;
+
+  /** Counters describing the cache's effectiveness. */
+  struct Stats {
+    // Lookups served from memory, whether fresh or stale.
+    uint64_t hits;
+    // Lookups that waited for a resolution.
+    uint64_t misses;
+    // Resolutions started in the background for stale results.
+    uint64_t refreshes;
+    // Completed resolutions, in the background or not, and their total and
+    // longest duration.
+    uint64_t resolutions;
+    std::chrono::nanoseconds total_resolution_time;
+    std::chrono::nanoseconds max_resolution_time;
+  };
+
+  /**
+   * Series of the metrics registry to count in as well. Unlike the cache's own
+   * counters they outlive it, so they keep counting across the caches of
+   * successive configurations. Any may be null.
+   */
+  struct Metrics {
+    metrics::Counter *hits;
+    metrics::Counter *misses;
+    // Observes the duration of every completed resolution.
+    metrics::Histogram *resolution_duration;
+  };
+
+  /**
+   * Create a cache. Must be owned by a shared_ptr, which background refreshes
+   * keep alive.
+   * @param ttl       how long results are served without a refresh.
+   * @param max_stale how long results may be served while they are refreshed.
+   * @param retry     how long to wait after a failed refresh before the next.
+   */
+  explicit ResolverCache(
+      std::chrono::steady_clock::duration ttl = std::chrono::seconds(60),
+      std::chrono::steady_clock::duration max_stale = std::chrono::minutes(10),
+      std::chrono::steady_clock::duration retry = std::chrono::seconds(5));
+
+  /**
+   * Create a cache with the default TTL and staleness that counts in the given
+   * series as well. Must be owned by a shared_ptr.
+   * @param metrics the series.
+   */
+  explicit ResolverCache(const Metrics &metrics);
+
+  /**
+   * Resolve a host and port. To be used inside a Boost co-routine.
+   * @param host     the host name.
+   * @param port     the port.
+   * @param timeout  how long to wait for the host to be resolved.
+   * @param deadline the deadline of the call on whose behalf the host is
+   * resolved, which also ends the wait when it expires.
+   * @param ioc      the io_context resolutions run on.
+   * @param yield    the co-routine's yield context.
+   * @return the resolved endpoints.
+   * @throws boost::system::system_error if the host must be resolved and
+   * cannot be, or with boost::asio::error::timed_out or operation_aborted if
+   * the lookup stops waiting for the resolution because of its timeout or the
+   * call being cancelled.
+   */
+  Results Resolve(const std::string &host, const std::string &port,
+                  std::chrono::steady_clock::duration timeout,
+                  const utilities::Deadline &deadline,
+                  boost::asio::io_context &ioc,
+                  boost::asio::yield_context yield);
+
+  /**
+   * @return the counters.
+   */
+  Stats GetStats() const;
+
+ protected:
+  typedef std::function<void(const boost::system::error_code &, Results)>
+      ResolutionHandler;
+
+  /**
+   * Start resolving a host and port. Called without the cache locked, so it
+   * may throw, which destroys the handler. Virtual so that tests can stall
+   * resolutions.
+   * @param resolver the resolver to use.
+   * @param host     the host name.
+   * @param port     the port.
+   * @param handler  called with the outcome once the resolution completes.
+   */
+  virtual void StartResolution(boost::asio::ip::tcp::resolver &resolver,
+                               const std::string &host,
+                               const std::string &port,
+                               ResolutionHandler handler);
+
+ private:
+  typedef std::pair<std::string, std::string> Key;
+
+  struct Entry {
+    Results results;
+    std::chrono::steady_clock::time_point resolved;
+    bool refreshing;
+    // No refresh starts before this time, which is later than when the results
+    // were stored if a refresh has failed since.
+    std::chrono::steady_clock::time_point retry_at;
+  };
+
+  // A resolution of a host never seen before, which other lookups of the host
+  // wait for.
+  struct Pending;
+
+  /**
+   * Resolve a host and port while lookups wait for the pending resolution.
+   * Must be called without mutex_ held.
+   */
+  void Start(const Key &key, const std::shared_ptr<Pending> &pending,
+             boost::asio::io_context &ioc);
+
+  /**
+   * Wait for a pending resolution. To be used inside a Boost co-routine.
+   * @return the resolved endpoints.
+   * @throws boost::system::system_error as Resolve does.
+   */
+  Results Wait(const std::shared_ptr<Pending> &pending,
+               std::chrono::steady_clock::duration timeout,
+               const utilities::Deadline &deadline,
+               boost::asio::io_context &ioc, boost::asio::yield_context yield);
+
+  /**
+   * End a pending resolution, resuming the lookups waiting for it. Must be
+   * called with mutex_ held.
+   */
+  void Finish(const Key &key, const std::shared_ptr<Pending> &pending,
+              const Results &results, const boost::system::error_code &ec);
+
+  /**
+   * Record a completed resolution. Must be called with mutex_ held.
+   */
+  void Store(const Key &key, const Results &results,
+             std::chrono::steady_clock::time_point started);
+
+  /**
+   * Resolve a host and port in the background, replacing the cached results
+   * when done. Must be called without mutex_ held.
+   */
+  void Refresh(const Key &key, boost::asio::io_context &ioc);
+
+  const std::chrono::steady_clock::duration ttl_;
+  const std::chrono::steady_clock::duration max_stale_;
+  const std::chrono::steady_clock::duration retry_;
+  Metrics metrics_;
+
+  mutable std::mutex mutex_;
+  std::map<Key, Entry> entries_;
+  std::map<Key, std::shared_ptr<Pending>> pending_;
+  Stats stats_;
+};
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_COMMON_HTTP_RESOLVER_CACHE_H_
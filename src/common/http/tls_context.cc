@@ -0,0 +1,85 @@
+#include "tls_context.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+namespace {
+// The ex_data slot of an SSL_CTX that points back to its TlsContext. The app
+// data slot cannot be used as Boost.Asio keeps its verify callback there.
+int ContextIndex() {
+  static const int index =
+      SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+}  // namespace
+
+TlsContext::TlsContext(const Metrics &metrics)
+    : context_(boost::asio::ssl::context::tls_client),
+      session_(nullptr),
+      full_handshakes_(0),
+      resumed_handshakes_(0),
+      metrics_(metrics) {
+  context_.set_verify_mode(boost::asio::ssl::verify_peer);
+  context_.set_default_verify_paths();
+
+  // Negotiates TLS 1.3 with endpoints that support it, but nothing older
+  // than TLS 1.2.
+  auto native = context_.native_handle();
+  SSL_CTX_set_min_proto_version(native, TLS1_2_VERSION);
+
+  // Sessions are kept by this object rather than the library's internal
+  // cache, which only servers consult.
+  SSL_CTX_set_ex_data(native, ContextIndex(), this);
+  SSL_CTX_set_session_cache_mode(
+      native, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(native, &TlsContext::OnNewSession);
+}
+
+TlsContext::~TlsContext() {
+  if (session_ != nullptr) {
+    SSL_SESSION_free(session_);
+  }
+}
+
+boost::asio::ssl::context &TlsContext::Context() { return context_; }
+
+void TlsContext::PrepareResumption(SSL *ssl) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (session_ != nullptr) {
+    SSL_set_session(ssl, session_);
+  }
+}
+
+void TlsContext::RecordHandshake(SSL *ssl) {
+  auto reused = SSL_session_reused(ssl);
+  auto &count = reused ? resumed_handshakes_ : full_handshakes_;
+  ++count;
+  auto series = reused ? metrics_.resumed_handshakes : metrics_.full_handshakes;
+  if (series != nullptr) {
+    series->Increment();
+  }
+}
+
+TlsContext::Stats TlsContext::GetStats() const {
+  return {full_handshakes_.load(), resumed_handshakes_.load()};
+}
+
+int TlsContext::OnNewSession(SSL *ssl, SSL_SESSION *session) {
+  auto self = static_cast<TlsContext *>(
+      SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ContextIndex()));
+  SSL_SESSION *previous;
+  {
+    std::lock_guard<std::mutex> lock(self->mutex_);
+    previous = self->session_;
+    self->session_ = session;
+  }
+  if (previous != nullptr) {
+    SSL_SESSION_free(previous);
+  }
+  // Returning 1 takes ownership of the session.
+  return 1;
+}
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,88 @@
+#ifndef AUTHSERVICE_SRC_COMMON_HTTP_TLS_CONTEXT_H_
+#define AUTHSERVICE_SRC_COMMON_HTTP_TLS_CONTEXT_H_
+#include <atomic>
+#include <boost/asio/ssl.hpp>
+#include <cstdint>
+#include <mutex>
+#include "src/common/metrics/metrics.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+
+/**
+ * A client TLS context for one endpoint, negotiating TLS 1.2 or 1.3. The CA
+ * bundle is loaded once, when the context is created. The context remembers
+ * the most recent session it was issued so later connections to the endpoint
+ * can resume it with an abbreviated handshake. Thread safe.
+ */
+class TlsContext {
+ public:
+  /** Counters of the handshakes made with this context. */
+  struct Stats {
+    uint64_t full_handshakes;
+    uint64_t resumed_handshakes;
+  };
+
+  /**
+   * Series of the metrics registry to count handshakes in as well, which
+   * outlive the context. Any may be null.
+   */
+  struct Metrics {
+    metrics::Counter *full_handshakes;
+    metrics::Counter *resumed_handshakes;
+  };
+
+  /**
+   * @param metrics the series to count handshakes in as well.
+   */
+  explicit TlsContext(const Metrics &metrics = Metrics());
+  ~TlsContext();
+
+  TlsContext(const TlsContext &) = delete;
+  TlsContext &operator=(const TlsContext &) = delete;
+
+  /**
+   * @return the context to create connections with.
+   */
+  boost::asio::ssl::context &Context();
+
+  /**
+   * Offer the most recent session for resumption. Call before the handshake.
+   * @param ssl the connection.
+   */
+  void PrepareResumption(SSL *ssl);
+
+  /**
+   * Count a completed handshake as full or resumed.
+   * @param ssl the connection.
+   */
+  void RecordHandshake(SSL *ssl);
+
+  /**
+   * @return the handshake counters.
+   */
+  Stats GetStats() const;
+
+ private:
+  /**
+   * Called by the TLS library whenever a connection is issued a session,
+   * which for TLS 1.3 happens after the handshake.
+   */
+  static int OnNewSession(SSL *ssl, SSL_SESSION *session);
+
+  boost::asio::ssl::context context_;
+
+  std::mutex mutex_;
+  SSL_SESSION *session_;
+
+  std::atomic<uint64_t> full_handshakes_;
+  std::atomic<uint64_t> resumed_handshakes_;
+  const Metrics metrics_;
+};
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_COMMON_HTTP_TLS_CONTEXT_H_
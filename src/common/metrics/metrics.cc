@@ -0,0 +1,261 @@
+#include "metrics.h"
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include "spdlog/fmt/fmt.h"
+
+namespace authservice {
+namespace common {
+namespace metrics {
+namespace {
+std::atomic<size_t> next_shard(0);
+
+// The histogram bounds in nanoseconds, to bucket observations without floating point.
+const std::array<uint64_t, Histogram::bucket_count> bound_nanoseconds = {{
+    1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 25000000,
+    50000000, 100000000, 250000000, 500000000, 1000000000, 2500000000, 5000000000, 10000000000}};
+
+void *AlignedAllocate(size_t size) {
+  void *pointer = nullptr;
+  if (posix_memalign(&pointer, cache_line_size, size) != 0) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+std::string FormatValue(double value) { return fmt::format("{}", value); }
+
+// Escape a label value as the text format requires.
+std::string EscapeLabel(const std::string &value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (auto c : value) {
+    switch (c) {
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      default:
+        escaped += c;
+    }
+  }
+  return escaped;
+}
+
+// Write a series name with its labels and an optional extra label, such as a histogram bucket's bound.
+void WriteSeries(std::ostream &out, const std::string &name, const Labels &labels, const char *extra_name = nullptr,
+                 const std::string &extra_value = "") {
+  out << name;
+  if (labels.empty() && extra_name == nullptr) {
+    return;
+  }
+  out << '{';
+  auto separator = "";
+  for (const auto &label : labels) {
+    out << separator << label.first << "=\"" << EscapeLabel(label.second) << '"';
+    separator = ",";
+  }
+  if (extra_name != nullptr) {
+    out << separator << extra_name << "=\"" << extra_value << '"';
+  }
+  out << '}';
+}
+}  // namespace
+
+size_t ThisThreadShard() {
+  // Threads take shards in turn as they first use a metric.
+  static thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % shard_count;
+  return shard;
+}
+
+void *Counter::operator new(size_t size) { return AlignedAllocate(size); }
+
+void Counter::operator delete(void *pointer) { free(pointer); }
+
+uint64_t Counter::Value() const {
+  uint64_t value = 0;
+  for (const auto &shard : shards_) {
+    value += shard.value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+const std::array<double, Histogram::bucket_count> Histogram::bounds = {
+    {0.000001, 0.0000025, 0.000005, 0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+     0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10}};
+
+void *Histogram::operator new(size_t size) { return AlignedAllocate(size); }
+
+void Histogram::operator delete(void *pointer) { free(pointer); }
+
+void Histogram::Observe(std::chrono::nanoseconds duration) {
+  auto nanoseconds = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+  size_t bucket = 0;
+  while (bucket < bucket_count && nanoseconds > bound_nanoseconds[bucket]) {
+    ++bucket;
+  }
+  auto &shard = shards_[ThisThreadShard()];
+  shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  shard.sum_nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::Collect() const {
+  Snapshot snapshot{};
+  uint64_t sum_nanoseconds = 0;
+  for (const auto &shard : shards_) {
+    for (size_t i = 0; i < shard.buckets.size(); ++i) {
+      auto count = shard.buckets[i].load(std::memory_order_relaxed);
+      snapshot.buckets[i] += count;
+      snapshot.count += count;
+    }
+    sum_nanoseconds += shard.sum_nanoseconds.load(std::memory_order_relaxed);
+  }
+  snapshot.sum_seconds = static_cast<double>(sum_nanoseconds) / 1e9;
+  return snapshot;
+}
+
+CallbackHandle::CallbackHandle(CallbackHandle &&other) noexcept : registry_(other.registry_), id_(other.id_) {
+  other.registry_ = nullptr;
+}
+
+CallbackHandle &CallbackHandle::operator=(CallbackHandle &&other) noexcept {
+  if (this != &other) {
+    if (registry_ != nullptr) {
+      registry_->RemoveCallback(id_);
+    }
+    registry_ = other.registry_;
+    id_ = other.id_;
+    other.registry_ = nullptr;
+  }
+  return *this;
+}
+
+CallbackHandle::~CallbackHandle() {
+  if (registry_ != nullptr) {
+    registry_->RemoveCallback(id_);
+  }
+}
+
+const char *Registry::TypeName(Kind kind) {
+  switch (kind) {
+    case Kind::counter:
+      return "counter";
+    case Kind::gauge:
+      return "gauge";
+    default:
+      return "histogram";
+  }
+}
+
+Registry::Family &Registry::GetFamily(const std::string &name, Kind kind, const std::string &help) {
+  auto family = families_.find(name);
+  if (family == families_.end()) {
+    family = families_.emplace(name, Family()).first;
+    family->second.kind = kind;
+    family->second.help = help;
+  } else if (family->second.kind != kind) {
+    throw std::runtime_error("metric " + name + " registered with different types");
+  }
+  return family->second;
+}
+
+Counter &Registry::GetCounter(const std::string &name, const std::string &help, const Labels &labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &counter = GetFamily(name, Kind::counter, help).counters[labels];
+  if (counter == nullptr) {
+    counter.reset(new Counter);
+  }
+  return *counter;
+}
+
+Histogram &Registry::GetHistogram(const std::string &name, const std::string &help, const Labels &labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &histogram = GetFamily(name, Kind::histogram, help).histograms[labels];
+  if (histogram == nullptr) {
+    histogram.reset(new Histogram);
+  }
+  return *histogram;
+}
+
+CallbackHandle Registry::AddCallback(Type type, const std::string &name, const std::string &help,
+                                     const Labels &labels, Callback callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto kind = type == Type::counter ? Kind::counter : Kind::gauge;
+  auto id = next_callback_++;
+  GetFamily(name, kind, help).callbacks[labels].emplace(id, std::move(callback));
+  callback_series_.emplace(id, std::make_pair(name, labels));
+  return CallbackHandle(this, id);
+}
+
+void Registry::RemoveCallback(uint64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto series = callback_series_.find(id);
+  if (series == callback_series_.end()) {
+    return;
+  }
+  auto &callbacks = families_[series->second.first].callbacks;
+  auto callback = callbacks.find(series->second.second);
+  callback->second.erase(id);
+  if (callback->second.empty()) {
+    callbacks.erase(callback);
+  }
+  callback_series_.erase(series);
+}
+
+std::string Registry::Serialize() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::ostringstream out;
+  for (const auto &entry : families_) {
+    const auto &name = entry.first;
+    const auto &family = entry.second;
+    if (family.counters.empty() && family.histograms.empty() && family.callbacks.empty()) {
+      continue;
+    }
+    out << "# HELP " << name << ' ' << family.help << '\n';
+    out << "# TYPE " << name << ' ' << TypeName(family.kind) << '\n';
+
+    for (const auto &counter : family.counters) {
+      WriteSeries(out, name, counter.first);
+      out << ' ' << counter.second->Value() << '\n';
+    }
+    for (const auto &series : family.callbacks) {
+      double value = 0;
+      for (const auto &callback : series.second) {
+        value += callback.second();
+      }
+      WriteSeries(out, name, series.first);
+      out << ' ' << FormatValue(value) << '\n';
+    }
+    for (const auto &histogram : family.histograms) {
+      auto snapshot = histogram.second->Collect();
+      uint64_t cumulative = 0;
+      for (size_t i = 0; i < Histogram::bucket_count; ++i) {
+        cumulative += snapshot.buckets[i];
+        WriteSeries(out, name + "_bucket", histogram.first, "le", FormatValue(Histogram::bounds[i]));
+        out << ' ' << cumulative << '\n';
+      }
+      WriteSeries(out, name + "_bucket", histogram.first, "le", "+Inf");
+      out << ' ' << snapshot.count << '\n';
+      WriteSeries(out, name + "_sum", histogram.first);
+      out << ' ' << FormatValue(snapshot.sum_seconds) << '\n';
+      WriteSeries(out, name + "_count", histogram.first);
+      out << ' ' << snapshot.count << '\n';
+    }
+  }
+  return out.str();
+}
+
+Registry &Registry::Default() {
+  static Registry registry;
+  return registry;
+}
+
+}  // namespace metrics
+}  // namespace common
+}  // namespace authservice
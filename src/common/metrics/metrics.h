@@ -0,0 +1,223 @@
+#ifndef AUTHSERVICE_SRC_COMMON_METRICS_METRICS_H_
+#define AUTHSERVICE_SRC_COMMON_METRICS_METRICS_H_
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace authservice {
+namespace common {
+namespace metrics {
+
+// The number of shards each metric is split into. Threads are spread across
+// the shards so that threads updating the same metric rarely share a cache
+// line.
+const size_t shard_count = 16;
+// The size of a cache line, to which each shard is aligned.
+const size_t cache_line_size = 64;
+
+/**
+ * @return the shard of the calling thread.
+ */
+size_t ThisThreadShard();
+
+/**
+ * A monotonically increasing count. Incremented without locking, and summed
+ * over its shards only when read. Thread safe.
+ */
+class Counter {
+ public:
+  Counter() = default;
+  Counter(const Counter &) = delete;
+  Counter &operator=(const Counter &) = delete;
+
+  // Allocate with the alignment of the shards, which operator new only
+  // honours from C++17.
+  static void *operator new(size_t size);
+  static void operator delete(void *pointer);
+
+  void Increment(uint64_t amount = 1) {
+    shards_[ThisThreadShard()].value.fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  /**
+   * @return the count summed over all threads.
+   */
+  uint64_t Value() const;
+
+ private:
+  struct alignas(cache_line_size) Shard {
+    std::atomic<uint64_t> value{0};
+  };
+
+  std::array<Shard, shard_count> shards_;
+};
+
+/**
+ * A distribution of durations over fixed buckets, spaced 1, 2.5 and 5 per
+ * decade from 1us to 10s, so the relative error is bounded at every scale.
+ * Observed without locking, and summed over its shards only when read. Thread
+ * safe.
+ */
+class Histogram {
+ public:
+  static const size_t bucket_count = 22;
+  // The upper bound of each bucket, in seconds. Larger values fall in a final
+  // unbounded bucket.
+  static const std::array<double, bucket_count> bounds;
+
+  struct Snapshot {
+    // The number of observations in each bucket, not cumulative, followed by
+    // those above the largest bound
+    std::array<uint64_t, bucket_count + 1> buckets;
+    uint64_t count;
+    double sum_seconds;
+  };
+
+  Histogram() = default;
+  Histogram(const Histogram &) = delete;
+  Histogram &operator=(const Histogram &) = delete;
+
+  // Allocate with the alignment of the shards, which operator new only
+  // honours from C++17.
+  static void *operator new(size_t size);
+  static void operator delete(void *pointer);
+
+  void Observe(std::chrono::nanoseconds duration);
+
+  /**
+   * @return the distribution summed over all threads.
+   */
+  Snapshot Collect() const;
+
+ private:
+  struct alignas(cache_line_size) Shard {
+    std::array<std::atomic<uint64_t>, bucket_count + 1> buckets{};
+    std::atomic<uint64_t> sum_nanoseconds{0};
+  };
+
+  std::array<Shard, shard_count> shards_;
+};
+
+/**
+ * Label names and values identifying one series of a metric.
+ */
+typedef std::vector<std::pair<std::string, std::string>> Labels;
+
+class Registry;
+
+/**
+ * Keeps a callback registered with a Registry, removing it on destruction.
+ */
+class CallbackHandle {
+ public:
+  CallbackHandle() : registry_(nullptr), id_(0) {}
+  CallbackHandle(Registry *registry, uint64_t id) : registry_(registry), id_(id) {}
+  CallbackHandle(CallbackHandle &&other) noexcept;
+  CallbackHandle &operator=(CallbackHandle &&other) noexcept;
+  ~CallbackHandle();
+
+ private:
+  Registry *registry_;
+  uint64_t id_;
+};
+
+/**
+ * Registry holds the metrics of the process and serializes them in the
+ * Prometheus text format. Looking up a metric takes a lock, so code on the
+ * request path looks its metrics up once and keeps the references, which
+ * remain valid for the life of the registry. Thread safe.
+ */
+class Registry {
+ public:
+  enum class Type { counter, gauge };
+
+  /**
+   * Produces the current value of a series kept elsewhere. Called while the
+   * registry is locked, so must not use the registry.
+   */
+  typedef std::function<double()> Callback;
+
+  Registry() : next_callback_(1) {}
+  Registry(const Registry &) = delete;
+  Registry &operator=(const Registry &) = delete;
+
+  /**
+   * Get a counter, creating it on first use.
+   * @param name   the metric name.
+   * @param help   the description of the metric.
+   * @param labels the labels of the series.
+   * @return the counter.
+   */
+  Counter &GetCounter(const std::string &name, const std::string &help, const Labels &labels = {});
+
+  /**
+   * Get a histogram, creating it on first use.
+   * @param name   the metric name.
+   * @param help   the description of the metric.
+   * @param labels the labels of the series.
+   * @return the histogram.
+   */
+  Histogram &GetHistogram(const std::string &name, const std::string &help, const Labels &labels = {});
+
+  /**
+   * Export a value kept elsewhere, such as the statistics of a cache. Values
+   * of callbacks registered with the same name and labels are summed.
+   * @param type     the type of the metric.
+   * @param name     the metric name.
+   * @param help     the description of the metric.
+   * @param labels   the labels of the series.
+   * @param callback produces the value.
+   * @return a handle that removes the callback when destroyed.
+   */
+  CallbackHandle AddCallback(Type type, const std::string &name, const std::string &help, const Labels &labels,
+                             Callback callback);
+
+  /**
+   * @return every metric in the Prometheus text exposition format.
+   */
+  std::string Serialize() const;
+
+  /**
+   * @return the registry of the process.
+   */
+  static Registry &Default();
+
+ private:
+  friend class CallbackHandle;
+
+  enum class Kind { counter, gauge, histogram };
+
+  struct Family {
+    Kind kind;
+    std::string help;
+    std::map<Labels, std::unique_ptr<Counter>> counters;
+    std::map<Labels, std::unique_ptr<Histogram>> histograms;
+    std::map<Labels, std::map<uint64_t, Callback>> callbacks;
+  };
+
+  static const char *TypeName(Kind kind);
+
+  Family &GetFamily(const std::string &name, Kind kind, const std::string &help);
+
+  void RemoveCallback(uint64_t id);
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Family> families_;
+  // Where each callback is registered, to remove it
+  std::map<uint64_t, std::pair<std::string, Labels>> callback_series_;
+  uint64_t next_callback_;
+};
+
+}  // namespace metrics
+}  // namespace common
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_COMMON_METRICS_METRICS_H_
@@ -0,0 +1,82 @@
+#include "metrics_server.h"
+#include <boost/beast.hpp>
+#include "spdlog/spdlog.h"
+
+namespace beast = boost::beast;    // from <boost/beast.hpp>
+namespace http = beast::http;      // from <boost/beast/http.hpp>
+using tcp = boost::asio::ip::tcp;  // from <boost/asio/ip/tcp.hpp>
+
+namespace authservice {
+namespace common {
+namespace metrics {
+namespace {
+const char *metrics_path = "/metrics";
+const char *metrics_content_type = "text/plain; version=0.0.4";
+}  // namespace
+
+MetricsServer::MetricsServer(const std::string &address, uint16_t port, const Registry &registry)
+    : registry_(registry), acceptor_(ioc_, tcp::endpoint(boost::asio::ip::make_address(address), port)) {
+  boost::asio::spawn(ioc_, [this](boost::asio::yield_context yield) { Accept(yield); });
+  thread_ = std::thread([this]() { ioc_.run(); });
+  spdlog::info("{}: serving metrics on {}:{}{}", __func__, address, Port(), metrics_path);
+}
+
+MetricsServer::~MetricsServer() {
+  // Abandons the connections, which are closed as their co-routines are destroyed with the io_context.
+  ioc_.stop();
+  thread_.join();
+}
+
+uint16_t MetricsServer::Port() const { return acceptor_.local_endpoint().port(); }
+
+void MetricsServer::Accept(boost::asio::yield_context yield) {
+  while (true) {
+    boost::system::error_code ec;
+    tcp::socket socket(ioc_);
+    acceptor_.async_accept(socket, yield[ec]);
+    if (ec == boost::asio::error::operation_aborted) {
+      return;
+    }
+    if (ec) {
+      spdlog::error("{}: failed to accept metrics connection: {}", __func__, ec.message());
+      continue;
+    }
+    // The socket is moved into the co-routine, which owns it from then on.
+    auto connection = std::make_shared<tcp::socket>(std::move(socket));
+    boost::asio::spawn(ioc_, [this, connection](boost::asio::yield_context yield) {
+      Serve(std::move(*connection), yield);
+    });
+  }
+}
+
+void MetricsServer::Serve(tcp::socket socket, boost::asio::yield_context yield) {
+  beast::flat_buffer buffer;
+  boost::system::error_code ec;
+  while (true) {
+    http::request<http::empty_body> request;
+    http::async_read(socket, buffer, request, yield[ec]);
+    if (ec) {
+      // Includes the scraper closing the connection.
+      return;
+    }
+
+    http::response<http::string_body> response(http::status::ok, request.version());
+    if (request.method() != http::verb::get || request.target() != metrics_path) {
+      response.result(http::status::not_found);
+    } else {
+      response.set(http::field::content_type, metrics_content_type);
+      response.body() = registry_.Serialize();
+    }
+    response.keep_alive(request.keep_alive());
+    response.prepare_payload();
+    http::async_write(socket, response, yield[ec]);
+    if (ec || !response.keep_alive()) {
+      socket.shutdown(tcp::socket::shutdown_both, ec);
+      return;
+    }
+  }
+}
+
+}  // namespace metrics
+}  // namespace common
+}  // namespace authservice
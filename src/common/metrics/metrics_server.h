@@ -0,0 +1,57 @@
+#ifndef AUTHSERVICE_SRC_COMMON_METRICS_METRICS_SERVER_H_
+#define AUTHSERVICE_SRC_COMMON_METRICS_METRICS_SERVER_H_
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+#include <boost/asio/spawn.hpp>
+#include "src/common/metrics/metrics.h"
+
+namespace authservice {
+namespace common {
+namespace metrics {
+
+/**
+ * MetricsServer serves a registry's metrics over HTTP at /metrics, for
+ * Prometheus to scrape. Runs on its own thread, apart from request processing.
+ */
+class MetricsServer {
+ public:
+  /**
+   * Start listening.
+   * @param address  the IP address to listen on.
+   * @param port     the TCP port to listen on.
+   * @param registry the metrics to serve.
+   * @throw boost::system::system_error if the address cannot be listened on.
+   */
+  MetricsServer(const std::string &address, uint16_t port, const Registry &registry);
+
+  /**
+   * Stop listening and close all connections.
+   */
+  ~MetricsServer();
+
+  MetricsServer(const MetricsServer &) = delete;
+  MetricsServer &operator=(const MetricsServer &) = delete;
+
+  /**
+   * @return the port listened on, which is chosen by the system if 0 was
+   * requested.
+   */
+  uint16_t Port() const;
+
+ private:
+  void Accept(boost::asio::yield_context yield);
+
+  void Serve(boost::asio::ip::tcp::socket socket, boost::asio::yield_context yield);
+
+  const Registry &registry_;
+  boost::asio::io_context ioc_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+  std::thread thread_;
+};
+
+}  // namespace metrics
+}  // namespace common
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_COMMON_METRICS_METRICS_SERVER_H_
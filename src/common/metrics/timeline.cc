@@ -0,0 +1,90 @@
+#include "timeline.h"
+#include <sstream>
+
+namespace authservice {
+namespace common {
+namespace metrics {
+namespace {
+thread_local Timeline *current_timeline = nullptr;
+
+const char *stage_duration_name = "authservice_stage_duration_seconds";
+const char *stage_duration_help = "The time checks took to reach each stage from the stage before it.";
+}  // namespace
+
+const char *StageName(Stage stage) {
+  switch (stage) {
+    case Stage::received:
+      return "received";
+    case Stage::deferred:
+      return "deferred";
+    case Stage::spawned:
+      return "spawned";
+    case Stage::matched:
+      return "matched";
+    case Stage::cookies_decrypted:
+      return "cookies_decrypted";
+    case Stage::token_requested:
+      return "token_requested";
+    case Stage::token_received:
+      return "token_received";
+    case Stage::processed:
+      return "processed";
+    case Stage::completed:
+      return "completed";
+    default:
+      return "sent";
+  }
+}
+
+const size_t Timeline::capacity;
+
+Timeline *Timeline::Current() { return current_timeline; }
+
+void Timeline::SetCurrent(Timeline *timeline) { current_timeline = timeline; }
+
+TimelineRecorder::TimelineRecorder(Registry &registry, uint32_t sample_rate, std::shared_ptr<spdlog::logger> sink)
+    : sample_rate_(sample_rate > 0 ? sample_rate : 1), sink_(std::move(sink)) {
+  for (size_t i = 0; i < stage_count; ++i) {
+    stages_[i] = &registry.GetHistogram(stage_duration_name, stage_duration_help,
+                                        {{"stage", StageName(static_cast<Stage>(i))}});
+  }
+}
+
+void TimelineRecorder::Record(const Timeline &timeline) {
+  const auto &marks = timeline.Marks();
+  for (size_t i = 1; i < timeline.Count(); ++i) {
+    stages_[static_cast<size_t>(marks[i].stage)]->Observe(marks[i].at - marks[i - 1].at);
+  }
+
+  if (sink_ == nullptr || timeline.Count() == 0) {
+    return;
+  }
+  // Counted per thread, so sampling adds no contention between threads.
+  static thread_local uint64_t recorded = 0;
+  if (++recorded % sample_rate_ == 0) {
+    sink_->info(ToJson(timeline));
+  }
+}
+
+std::string TimelineRecorder::ToJson(const Timeline &timeline) {
+  const auto &marks = timeline.Marks();
+  if (timeline.Count() == 0) {
+    return "{\"start_unix_micros\":0,\"marks\":[]}";
+  }
+  // The monotonic clock has no epoch, so the start is placed on the wall clock by its distance from now.
+  auto start = std::chrono::system_clock::now() -
+               std::chrono::duration_cast<std::chrono::system_clock::duration>(Timeline::Clock::now() - marks[0].at);
+  std::ostringstream out;
+  out << "{\"start_unix_micros\":"
+      << std::chrono::duration_cast<std::chrono::microseconds>(start.time_since_epoch()).count() << ",\"marks\":[";
+  for (size_t i = 0; i < timeline.Count(); ++i) {
+    out << (i == 0 ? "" : ",") << "{\"stage\":\"" << StageName(marks[i].stage) << "\",\"nanoseconds\":"
+        << std::chrono::duration_cast<std::chrono::nanoseconds>(marks[i].at - marks[0].at).count() << '}';
+  }
+  out << "]}";
+  return out.str();
+}
+
+}  // namespace metrics
+}  // namespace common
+}  // namespace authservice
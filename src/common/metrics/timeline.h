@@ -0,0 +1,160 @@
+#ifndef AUTHSERVICE_SRC_COMMON_METRICS_TIMELINE_H_
+#define AUTHSERVICE_SRC_COMMON_METRICS_TIMELINE_H_
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "spdlog/spdlog.h"
+#include "src/common/metrics/metrics.h"
+
+namespace authservice {
+namespace common {
+namespace metrics {
+
+/**
+ * The points a check passes through on its way through the service, in the
+ * order they are usually reached.
+ */
+enum class Stage {
+  // Taken off the completion queue
+  received,
+  // Left for a co-routine because it needs I/O
+  deferred,
+  // Started running on a co-routine
+  spawned,
+  // Its filter chain was found
+  matched,
+  // The session cookies were read, decrypting any not yet cached
+  cookies_decrypted,
+  // About to ask the IdP for tokens
+  token_requested,
+  // The IdP answered, or the request failed
+  token_received,
+  // The filters finished
+  processed,
+  // The response was handed to gRPC
+  completed,
+  // gRPC reported the response sent
+  sent,
+};
+
+const size_t stage_count = static_cast<size_t>(Stage::sent) + 1;
+
+/**
+ * @return the name of a stage, as used in metric labels and exported
+ * timelines.
+ */
+const char *StageName(Stage stage);
+
+/**
+ * The times at which one check reached each stage. Marking a stage reads a
+ * monotonic clock and stores it without allocating, so every check carries
+ * a timeline. Not thread safe; a check is only worked on by one thread at a
+ * time.
+ *
+ * Filters do not take a timeline as a parameter. Instead, whoever runs a
+ * check without yielding makes its timeline current on the running thread
+ * for the duration, and code on the check's path picks it up with Current().
+ * Other checks may run on the same thread whenever a co-routine yields, so a
+ * timeline is never left current across a yield: a check that is deferred
+ * carries its timeline in its filters::Deferral instead.
+ */
+class Timeline {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  // The number of marks kept. Checks that retry stages may reach more, and
+  // the extra marks are dropped.
+  static const size_t capacity = 16;
+
+  struct Mark {
+    Stage stage;
+    Clock::time_point at;
+  };
+
+  Timeline() : count_(0) {}
+  Timeline(const Timeline &) = delete;
+  Timeline &operator=(const Timeline &) = delete;
+
+  /**
+   * Forget the marks of the previous check.
+   */
+  void Reset() { count_ = 0; }
+
+  /**
+   * Record that the check reached a stage now.
+   * @param stage the stage.
+   */
+  void Record(Stage stage) {
+    if (count_ < capacity) {
+      marks_[count_++] = Mark{stage, Clock::now()};
+    }
+  }
+
+  /**
+   * @return the number of marks recorded, which are the first entries of
+   * Marks().
+   */
+  size_t Count() const { return count_; }
+
+  const std::array<Mark, capacity> &Marks() const { return marks_; }
+
+  /**
+   * @return the timeline of the check running on the calling thread, or
+   * nullptr if there is none.
+   */
+  static Timeline *Current();
+
+  /**
+   * Make a timeline current on the calling thread.
+   * @param timeline the timeline, or nullptr to clear it.
+   */
+  static void SetCurrent(Timeline *timeline);
+
+ private:
+  std::array<Mark, capacity> marks_;
+  size_t count_;
+};
+
+/**
+ * TimelineRecorder turns completed timelines into per-stage histograms, and
+ * writes a sample of them out in full, one JSON object per line, for offline
+ * analysis. The histogram of a stage observes the time from the mark before
+ * it. Thread safe.
+ */
+class TimelineRecorder {
+ public:
+  /**
+   * @param registry    the registry of the stage histograms.
+   * @param sample_rate write out one in this many timelines.
+   * @param sink        where to write sampled timelines, or nullptr to
+   * write none.
+   */
+  TimelineRecorder(Registry &registry, uint32_t sample_rate, std::shared_ptr<spdlog::logger> sink);
+
+  /**
+   * Record the timeline of a completed check.
+   * @param timeline the timeline.
+   */
+  void Record(const Timeline &timeline);
+
+  /**
+   * Format a timeline as a single line of JSON, with the wall clock time of
+   * its first mark and the offset of every mark from the first.
+   * @param timeline the timeline.
+   * @return the JSON.
+   */
+  static std::string ToJson(const Timeline &timeline);
+
+ private:
+  std::array<Histogram *, stage_count> stages_;
+  const uint32_t sample_rate_;
+  std::shared_ptr<spdlog::logger> sink_;
+};
+
+}  // namespace metrics
+}  // namespace common
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_COMMON_METRICS_TIMELINE_H_
@@ -0,0 +1,127 @@
+#include "src/common/session/session_cache.h"
+#include <algorithm>
+#include <iterator>
+
+#include "absl/time/clock.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+namespace {
+// An estimate of the per-entry overhead of the list node, index node and
+// string headers.
+const size_t entry_overhead = 160;
+}  // namespace
+
+const size_t SessionCache::default_shards;
+
+SessionCache::SessionCache(size_t max_bytes, absl::Duration max_age,
+                           size_t shards, const Metrics &metrics)
+    : max_shard_bytes_(max_bytes / std::max<size_t>(shards, 1)),
+      max_age_(max_age),
+      metrics_(metrics),
+      shards_(std::max<size_t>(shards, 1)) {}
+
+absl::optional<std::string> SessionCache::Get(const std::string &key,
+                                              const Loader &load) {
+  auto &shard =
+      shards_[absl::Hash<absl::string_view>()(key) % shards_.size()];
+  auto now = absl::Now();
+
+  std::promise<absl::optional<std::string>> loaded;
+  {
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(key);
+    if (found != shard.index.end()) {
+      auto entry = found->second;
+      if (entry->expiry > now) {
+        ++shard.stats.hits;
+        Count(metrics_.hits);
+        shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+        return entry->value;
+      }
+      Erase(shard, entry);
+    }
+    ++shard.stats.misses;
+    Count(metrics_.misses);
+
+    auto pending = shard.loading.find(key);
+    if (pending != shard.loading.end()) {
+      auto result = pending->second;
+      lock.unlock();
+      return result.get();
+    }
+    shard.loading.emplace(key, loaded.get_future().share());
+  }
+
+  absl::optional<std::string> value;
+  auto expiry = now + max_age_;
+  try {
+    value = load(expiry);
+  } catch (...) {
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.loading.erase(key);
+    }
+    loaded.set_exception(std::current_exception());
+    throw;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.loading.erase(key);
+    if (value.has_value()) {
+      Insert(shard, key, *value, expiry);
+    }
+  }
+  loaded.set_value(value);
+  return value;
+}
+
+SessionCache::Stats SessionCache::GetStats() const {
+  Stats total = {0, 0, 0};
+  for (const auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    total.hits += shard.stats.hits;
+    total.misses += shard.stats.misses;
+    total.evictions += shard.stats.evictions;
+  }
+  return total;
+}
+
+void SessionCache::Insert(Shard &shard, const std::string &key,
+                          const std::string &value, absl::Time expiry) {
+  Entry entry = {key, value, expiry};
+  auto size = Size(entry);
+  if (size > max_shard_bytes_) {
+    return;
+  }
+  while (shard.bytes + size > max_shard_bytes_) {
+    ++shard.stats.evictions;
+    Count(metrics_.evictions);
+    Erase(shard, std::prev(shard.entries.end()));
+  }
+  shard.entries.push_front(std::move(entry));
+  shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+  shard.bytes += size;
+}
+
+void SessionCache::Erase(Shard &shard, EntryList::iterator entry) {
+  shard.bytes -= Size(*entry);
+  shard.index.erase(entry->key);
+  shard.entries.erase(entry);
+}
+
+size_t SessionCache::Size(const Entry &entry) {
+  return entry.key.size() + entry.value.size() + entry_overhead;
+}
+
+void SessionCache::Count(metrics::Counter *counter) {
+  if (counter != nullptr) {
+    counter->Increment();
+  }
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,142 @@
+#ifndef AUTHSERVICE_SRC_COMMON_SESSION_SESSION_CACHE_H_
+#define AUTHSERVICE_SRC_COMMON_SESSION_SESSION_CACHE_H_
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/hash/hash.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "src/common/metrics/metrics.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+class SessionCache;
+typedef std::shared_ptr<SessionCache> SessionCachePtr;
+
+/**
+ * A bounded, sharded LRU cache of decrypted session cookies keyed by the
+ * encrypted cookie value. Concurrent lookups of the same missing cookie are
+ * coalesced so it is only decrypted once. Thread safe.
+ */
+class SessionCache {
+ public:
+  // The number of shards a cache is split into unless told otherwise.
+  static const size_t default_shards = 16;
+
+  /** Counters describing the cache's effectiveness. */
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+  };
+
+  /**
+   * Series of the metrics registry to count in as well. Unlike the cache's own
+   * counters they outlive it, so they keep counting across the caches of
+   * successive configurations. Any may be null.
+   */
+  struct Metrics {
+    metrics::Counter *hits;
+    metrics::Counter *misses;
+    metrics::Counter *evictions;
+  };
+
+  /**
+   * Produces the value for a missing key.
+   * @param expiry when the value should expire. Set to the cache's maximum age
+   * before the call and may be brought forward.
+   * @return the value, or absl::nullopt if there is none. Absent values are
+   * not cached.
+   */
+  typedef std::function<absl::optional<std::string>(absl::Time &expiry)>
+      Loader;
+
+  /**
+   * Create a cache.
+   * @param max_bytes the approximate upper bound on the memory used by
+   * entries.
+   * @param max_age   the longest time an entry is kept.
+   * @param shards    the number of independently locked shards.
+   * @param metrics   the series to count in as well.
+   */
+  SessionCache(size_t max_bytes, absl::Duration max_age, size_t shards = default_shards,
+               const Metrics &metrics = Metrics());
+
+  /**
+   * Look up a value, loading and caching it on a miss.
+   * @param key  the encrypted cookie value.
+   * @param load produces the value when it is not cached.
+   * @return the value, or absl::nullopt if there is none.
+   */
+  absl::optional<std::string> Get(const std::string &key, const Loader &load);
+
+  /**
+   * @return the counters summed over all shards.
+   */
+  Stats GetStats() const;
+
+ private:
+  struct Entry {
+    std::string key;
+    std::string value;
+    absl::Time expiry;
+  };
+
+  typedef std::list<Entry> EntryList;
+  typedef std::shared_future<absl::optional<std::string>> PendingLoad;
+
+  struct Shard {
+    mutable std::mutex mutex;
+    // Most recently used first. The index refers to the keys held in here.
+    EntryList entries;
+    std::unordered_map<absl::string_view, EntryList::iterator,
+                       absl::Hash<absl::string_view>>
+        index;
+    // Loads in progress, so concurrent misses of the same key wait for them.
+    std::unordered_map<std::string, PendingLoad> loading;
+    size_t bytes = 0;
+    Stats stats = {0, 0, 0};
+  };
+
+  /**
+   * Store a loaded value, evicting least recently used entries as needed.
+   * Must be called with the shard's mutex held.
+   */
+  void Insert(Shard &shard, const std::string &key, const std::string &value,
+              absl::Time expiry);
+
+  /**
+   * Remove an entry. Must be called with the shard's mutex held.
+   */
+  static void Erase(Shard &shard, EntryList::iterator entry);
+
+  /**
+   * @return the memory accounted to an entry.
+   */
+  static size_t Size(const Entry &entry);
+
+  /**
+   * Increment a series of the registry's, if there is one.
+   */
+  static void Count(metrics::Counter *counter);
+
+  const size_t max_shard_bytes_;
+  const absl::Duration max_age_;
+  const Metrics metrics_;
+  std::vector<Shard> shards_;
+};
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
+#endif  // AUTHSERVICE_SRC_COMMON_SESSION_SESSION_CACHE_H_
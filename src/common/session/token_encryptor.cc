@@ -1,5 +1,6 @@
 #include "src/common/session/token_encryptor.h"
 #include "absl/strings/escaping.h"
+#include "absl/strings/match.h"
 #include "src/common/session/gcm_encryptor.h"
 #include "src/common/utilities/random.h"
 
@@ -10,34 +11,56 @@ namespace session {
 namespace {
 const size_t NONCE_SIZE = 32;
 const size_t DERIVED_KEY_SIZE = 32;
+// Prefixes V2 tokens. The '.' never appears in web safe base64, so V1 tokens
+// cannot start with it. It is also authenticated as additional data.
+const char V2_PREFIX[] = "v2.";
+// HKDF info used to derive the V2 key. V1 keys are derived with a random salt
+// and no info, so the two never coincide.
+const char V2_KEY_INFO[] = "authservice token v2";
+
+std::vector<unsigned char> ToVector(absl::string_view value) {
+  return std::vector<unsigned char>(value.begin(), value.end());
+}
 }  // namespace
 
 class TokenEncryptorImpl : public TokenEncryptor {
  public:
   TokenEncryptorImpl(const std::string& secret, EncryptionAlg enc_alg,
-                     HKDFHash hash_alg);
+                     HKDFHash hash_alg, TokenFormat format);
 
   std::string Encrypt(const absl::string_view token) override;
   absl::optional<std::string> Decrypt(const std::string& ciphertext) override;
 
  private:
   EncryptionAlg enc_alg_;
+  TokenFormat format_;
   HkdfDeriverPtr deriver_;
   utilities::RandomGenerator generator_;
+  // Created once and shared by every V2 token, as AEAD contexts are safe to
+  // use concurrently.
+  GcmEncryptorPtr v2_encryptor_;
 
   size_t KeySize() const;
 
   std::vector<unsigned char> EncryptInternal(
       const absl::string_view token, const std::vector<unsigned char>& key) const;
+
+  std::string EncryptV1(const absl::string_view token);
+  std::string EncryptV2(const absl::string_view token);
+  absl::optional<std::string> DecryptV1(const std::string& ciphertext);
+  absl::optional<std::string> DecryptV2(const absl::string_view ciphertext);
 };
 
 TokenEncryptorImpl::TokenEncryptorImpl(const std::string& secret,
-                                       EncryptionAlg enc_alg, HKDFHash hash_alg)
-    : enc_alg_(enc_alg) {
+                                       EncryptionAlg enc_alg, HKDFHash hash_alg,
+                                       TokenFormat format)
+    : enc_alg_(enc_alg), format_(format) {
   // Get the secret from the config and use it and the claim nonce to derive a
   // new AES-256 key
   std::vector<unsigned char> secret_vec(secret.begin(), secret.end());
   deriver_ = HkdfDeriver::Create(secret_vec, hash_alg);
+  v2_encryptor_ =
+      GcmEncryptor::Create(deriver_->Derive(KeySize(), {}, ToVector(V2_KEY_INFO)));
 }
 
 size_t TokenEncryptorImpl::KeySize() const {
@@ -69,6 +92,22 @@ std::vector<unsigned char> TokenEncryptorImpl::EncryptInternal(
 }
 
 std::string TokenEncryptorImpl::Encrypt(const absl::string_view token) {
+  if (format_ == TokenFormat::V1) {
+    return EncryptV1(token);
+  }
+  return EncryptV2(token);
+}
+
+absl::optional<std::string> TokenEncryptorImpl::Decrypt(
+    const std::string& ciphertext) {
+  if (absl::StartsWith(ciphertext, V2_PREFIX)) {
+    return DecryptV2(
+        absl::string_view(ciphertext).substr(sizeof(V2_PREFIX) - 1));
+  }
+  return DecryptV1(ciphertext);
+}
+
+std::string TokenEncryptorImpl::EncryptV1(const absl::string_view token) {
   auto nonce = generator_.Generate(NONCE_SIZE);
   std::vector<unsigned char> nonce_vec(nonce.Begin(), nonce.End());
   auto derivedKey = deriver_->Derive(KeySize(), nonce_vec);
@@ -85,7 +124,7 @@ std::string TokenEncryptorImpl::Encrypt(const absl::string_view token) {
       reinterpret_cast<const char*>(output.data()), output.size()));
 }
 
-absl::optional<std::string> TokenEncryptorImpl::Decrypt(
+absl::optional<std::string> TokenEncryptorImpl::DecryptV1(
     const std::string& ciphertext) {
   // UrlBase64 decode the token
   std::string decoded;
@@ -111,10 +150,37 @@ absl::optional<std::string> TokenEncryptorImpl::Decrypt(
   return std::string(decrypted->begin(), decrypted->end());
 }
 
+std::string TokenEncryptorImpl::EncryptV2(const absl::string_view token) {
+  // Result is: V2_PREFIX || base64(gcm_nonce || ciphertext || tag), with a
+  // random GCM nonce for each token.
+  auto encrypted =
+      v2_encryptor_->Seal(ToVector(token), absl::nullopt, ToVector(V2_PREFIX));
+  return V2_PREFIX + absl::WebSafeBase64Escape(absl::string_view(
+                         reinterpret_cast<const char*>(encrypted.data()),
+                         encrypted.size()));
+}
+
+absl::optional<std::string> TokenEncryptorImpl::DecryptV2(
+    const absl::string_view ciphertext) {
+  std::string decoded;
+  if (!absl::WebSafeBase64Unescape(ciphertext, &decoded)) {
+    return absl::nullopt;
+  }
+
+  auto decrypted = v2_encryptor_->Open(ToVector(decoded), ToVector(V2_PREFIX));
+  if (!decrypted) {
+    return absl::nullopt;
+  }
+
+  return std::string(decrypted->begin(), decrypted->end());
+}
+
 TokenEncryptorPtr TokenEncryptor::Create(const std::string& secret,
                                          EncryptionAlg enc_alg,
-                                         HKDFHash hash_alg) {
-  return std::make_shared<TokenEncryptorImpl>(secret, enc_alg, hash_alg);
+                                         HKDFHash hash_alg,
+                                         TokenFormat format) {
+  return std::make_shared<TokenEncryptorImpl>(secret, enc_alg, hash_alg,
+                                              format);
 }
 
 }  // namespace session
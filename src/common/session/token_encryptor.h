@@ -18,6 +18,19 @@ enum class EncryptionAlg {
   AES256GCM,
 };
 
+/**
+ * The format of encrypted tokens. Decrypt accepts every format, while Encrypt
+ * produces V1 unless asked otherwise, as versions that predate V2 cannot read
+ * it.
+ */
+enum class TokenFormat {
+  // A key derived per token from a random nonce that prefixes the token.
+  V1,
+  // A key derived once per encryptor. Cheaper to encrypt and decrypt, and 32
+  // bytes shorter than V1 before encoding.
+  V2,
+};
+
 /** Token encryption utility */
 class TokenEncryptor {
  public:
@@ -47,12 +60,14 @@ class TokenEncryptor {
    * @param enc_alg      encryption algorithm to be used for
    * encryption/decryption.
    * @param hash_alg     hash algorithm to be used for key derivation.
+   * @param format       the format of tokens produced by Encrypt.
    * @return an instance of a TokenEncryptor.
    */
   static TokenEncryptorPtr Create(
       const std::string& secret,
       EncryptionAlg enc_alg = EncryptionAlg::AES256GCM,
-      HKDFHash hash_alg = HKDFHash::SHA256);
+      HKDFHash hash_alg = HKDFHash::SHA256,
+      TokenFormat format = TokenFormat::V1);
 };
 
 }  // namespace session
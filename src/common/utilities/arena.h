@@ -0,0 +1,41 @@
+#ifndef AUTHSERVICE_SRC_COMMON_UTILITIES_ARENA_H_
+#define AUTHSERVICE_SRC_COMMON_UTILITIES_ARENA_H_
+#include <type_traits>
+#include "google/protobuf/arena.h"
+
+namespace authservice {
+namespace common {
+namespace utilities {
+namespace detail {
+template <typename T>
+T *CreateOnArena(google::protobuf::Arena *arena, std::true_type) {
+  return google::protobuf::Arena::CreateMessage<T>(arena);
+}
+
+template <typename T>
+T *CreateOnArena(google::protobuf::Arena *arena, std::false_type) {
+  return google::protobuf::Arena::Create<T>(arena);
+}
+}  // namespace detail
+
+/**
+ * Create a message on the given arena. Messages generated with arena support
+ * allocate their sub-messages, strings and maps from the arena too. Other
+ * messages are still freed with the arena, but their contents come from the
+ * heap. Whether the Envoy API messages support arenas depends on the protobuf
+ * release they are generated with.
+ * @param arena the arena.
+ * @return the message, owned by the arena.
+ */
+template <typename T>
+T *CreateOnArena(google::protobuf::Arena *arena) {
+  return detail::CreateOnArena<T>(
+      arena,
+      typename google::protobuf::Arena::is_arena_constructable<T>::type());
+}
+
+}  // namespace utilities
+}  // namespace common
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_COMMON_UTILITIES_ARENA_H_
@@ -0,0 +1,145 @@
+#ifndef AUTHSERVICE_SRC_COMMON_UTILITIES_DEADLINE_H_
+#define AUTHSERVICE_SRC_COMMON_UTILITIES_DEADLINE_H_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <mutex>
+
+namespace authservice {
+namespace common {
+namespace utilities {
+
+/**
+ * The point in time by which a call must be answered, and whether its caller
+ * has already given up on it. Work done on behalf of the call should stop
+ * once it has expired. Expiring and cancelling are thread safe, so a call can
+ * be cancelled from one thread while another works on it, and work that waits
+ * can register to be woken when that happens.
+ */
+class Deadline {
+ public:
+  typedef std::chrono::steady_clock Clock;
+  typedef std::function<void()> Callback;
+
+  /**
+   * Keeps a callback registered to run when the call is cancelled, removing it
+   * when destroyed.
+   */
+  class Registration {
+   public:
+    Registration(Registration &&other) noexcept
+        : deadline_(other.deadline_), callback_(other.callback_) {
+      other.deadline_ = nullptr;
+    }
+
+    Registration(const Registration &) = delete;
+    Registration &operator=(const Registration &) = delete;
+
+    ~Registration() {
+      if (deadline_ != nullptr) {
+        std::lock_guard<std::mutex> lock(deadline_->mutex_);
+        deadline_->callbacks_.erase(callback_);
+      }
+    }
+
+   private:
+    friend class Deadline;
+
+    Registration(const Deadline *deadline, std::list<Callback>::iterator callback)
+        : deadline_(deadline), callback_(callback) {}
+
+    const Deadline *deadline_;
+    std::list<Callback>::iterator callback_;
+  };
+
+  /**
+   * Create a deadline that never passes, which can still be cancelled.
+   */
+  Deadline() : Deadline(Clock::time_point::max()) {}
+
+  /**
+   * Create a deadline that passes at the given time.
+   * @param at the time.
+   */
+  explicit Deadline(Clock::time_point at) : at_(at), cancelled_(false) {}
+
+  Deadline(const Deadline &) = delete;
+  Deadline &operator=(const Deadline &) = delete;
+
+  /**
+   * Cancel the call, making the deadline expire immediately and running the
+   * callbacks registered with OnCancel.
+   */
+  void Cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!cancelled_.exchange(true, std::memory_order_relaxed)) {
+      for (const auto &callback : callbacks_) {
+        callback();
+      }
+    }
+  }
+
+  /**
+   * Run a callback when the call is cancelled, for as long as the returned
+   * registration exists, or right away if it has been already. The callback
+   * runs on the thread that cancels the call, with the deadline locked, so it
+   * should only hand the cancellation over to wherever the work runs.
+   * @param callback the callback.
+   * @return the registration.
+   */
+  Registration OnCancel(Callback callback) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Cancelled()) {
+      callback();
+      return Registration(nullptr, callbacks_.end());
+    }
+    return Registration(this, callbacks_.insert(callbacks_.end(), std::move(callback)));
+  }
+
+  /**
+   * @return whether the call has been cancelled.
+   */
+  bool Cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+
+  /**
+   * @return whether the call has been cancelled or the deadline has passed.
+   */
+  bool Expired() const { return Cancelled() || Clock::now() >= at_; }
+
+  /**
+   * @return the time the deadline passes, Clock::time_point::max() if never.
+   */
+  Clock::time_point At() const { return at_; }
+
+  /**
+   * Shorten a timeout so that it ends no later than the deadline.
+   * @param timeout the timeout.
+   * @return the timeout, or the time left until the deadline if that is
+   * shorter. Zero once the deadline has expired.
+   */
+  Clock::duration Clamp(Clock::duration timeout) const {
+    if (Cancelled()) {
+      return Clock::duration::zero();
+    }
+    if (at_ == Clock::time_point::max()) {
+      return timeout;
+    }
+    auto remaining = at_ - Clock::now();
+    return std::max(Clock::duration::zero(), std::min(timeout, remaining));
+  }
+
+ private:
+  const Clock::time_point at_;
+  std::atomic<bool> cancelled_;
+  // Guards callbacks_, and cancelled_ becoming true while they are registered.
+  mutable std::mutex mutex_;
+  mutable std::list<Callback> callbacks_;
+};
+
+}  // namespace utilities
+}  // namespace common
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_COMMON_UTILITIES_DEADLINE_H_
@@ -0,0 +1,160 @@
+#include "config_watcher.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "spdlog/spdlog.h"
+#include "src/config/get_config.h"
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace authservice {
+namespace config {
+namespace {
+// How long to wait for further changes after one is seen, so a file written in
+// several steps is read once it is complete.
+const int settle_milliseconds = 100;
+
+// Read a whole file, returning false if it cannot be opened.
+bool ReadFile(const std::string &path, std::string &contents) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::stringstream buf;
+  buf << file.rdbuf();
+  contents = buf.str();
+  return true;
+}
+
+std::string Directory(const std::string &path) {
+  auto slash = path.find_last_of('/');
+  if (slash == std::string::npos) {
+    return ".";
+  }
+  if (slash == 0) {
+    return "/";
+  }
+  return path.substr(0, slash);
+}
+}  // namespace
+
+ConfigWatcher::ConfigWatcher(std::string path, Callback callback)
+    : path_(std::move(path)),
+      callback_(std::move(callback)),
+      reloads_(0),
+      failures_(0),
+      reload_microseconds_(0),
+      inotify_(-1),
+      stop_(-1) {
+  ReadFile(path_, contents_);
+#ifdef __linux__
+  inotify_ = inotify_init1(IN_CLOEXEC);
+  if (inotify_ < 0) {
+    throw std::runtime_error("failed to watch filter config");
+  }
+  if (inotify_add_watch(inotify_, Directory(path_).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) <
+      0) {
+    close(inotify_);
+    throw std::runtime_error("failed to watch filter config directory");
+  }
+  stop_ = eventfd(0, EFD_CLOEXEC);
+  if (stop_ < 0) {
+    close(inotify_);
+    throw std::runtime_error("failed to watch filter config");
+  }
+  thread_ = std::thread([this]() { Run(); });
+  spdlog::info("{}: watching {} for changes", __func__, path_);
+#else
+  spdlog::warn("{}: watching {} is not supported on this platform, changes need a restart", __func__, path_);
+#endif
+}
+
+ConfigWatcher::~ConfigWatcher() {
+#ifdef __linux__
+  if (thread_.joinable()) {
+    uint64_t stop = 1;
+    if (write(stop_, &stop, sizeof(stop)) != sizeof(stop)) {
+      spdlog::error("{}: failed to stop watching {}", __func__, path_);
+    }
+    thread_.join();
+  }
+  close(stop_);
+  close(inotify_);
+#endif
+}
+
+ConfigWatcher::Stats ConfigWatcher::GetStats() const {
+  return Stats{reloads_.load(), failures_.load(), reload_microseconds_.load()};
+}
+
+void ConfigWatcher::Run() {
+#ifdef __linux__
+  // Large enough for several events, each followed by a file name.
+  alignas(struct inotify_event) char events[4096];
+  pollfd fds[] = {{stop_, POLLIN, 0}, {inotify_, POLLIN, 0}};
+  auto timeout = -1;
+  while (true) {
+    auto ready = poll(fds, 2, timeout);
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      spdlog::error("{}: stopped watching {}: {}", __func__, path_, strerror(errno));
+      return;
+    }
+    if (fds[0].revents != 0) {
+      return;
+    }
+    if (ready == 0) {
+      // The changes have settled.
+      timeout = -1;
+      Reload();
+      continue;
+    }
+    // Any event in the directory may have changed the file, directly or through a symbolic link, so the contents
+    // are compared rather than the file names.
+    if (read(inotify_, events, sizeof(events)) < 0 && errno != EINTR) {
+      spdlog::error("{}: stopped watching {}: {}", __func__, path_, strerror(errno));
+      return;
+    }
+    timeout = settle_milliseconds;
+  }
+#endif
+}
+
+void ConfigWatcher::Reload() {
+  std::string contents;
+  if (!ReadFile(path_, contents)) {
+    // Probably mid-replacement. The file appearing again is another event.
+    spdlog::debug("{}: {} is missing", __func__, path_);
+    return;
+  }
+  if (contents == contents_) {
+    return;
+  }
+  // Remember rejected contents too, so they are not retried until the file changes again.
+  contents_ = contents;
+
+  auto start = std::chrono::steady_clock::now();
+  try {
+    auto config = ParseConfig(contents);
+    callback_(*config);
+    ++reloads_;
+    spdlog::info("{}: applied changes to {}", __func__, path_);
+  } catch (const std::exception &e) {
+    ++failures_;
+    spdlog::error("{}: rejected changes to {}, keeping the current configuration: {}", __func__, path_, e.what());
+  }
+  reload_microseconds_ += std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace config
+}  // namespace authservice
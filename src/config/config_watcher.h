@@ -0,0 +1,90 @@
+#ifndef AUTHSERVICE_SRC_CONFIG_CONFIG_WATCHER_H_
+#define AUTHSERVICE_SRC_CONFIG_CONFIG_WATCHER_H_
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include "config/config.pb.h"
+
+namespace authservice {
+namespace config {
+
+/**
+ * ConfigWatcher watches a configuration file and hands each new valid
+ * version of it to a callback. The file is watched with inotify on its
+ * directory, so replacing the file, as editors and Kubernetes config maps do,
+ * is noticed as well as writing it in place. Parsing, validation and the
+ * callback all run on the watcher's own thread, away from request processing.
+ * Watching is only supported on Linux. Elsewhere the watcher does nothing.
+ */
+class ConfigWatcher {
+ public:
+  /**
+   * Apply a new configuration. Throws if the configuration cannot be applied.
+   */
+  typedef std::function<void(const Config &)> Callback;
+
+  struct Stats {
+    // Reloads that were applied
+    uint64_t reloads;
+    // Reloads abandoned because the configuration was invalid or could not be applied
+    uint64_t failures;
+    // Time spent on all reloads, whether or not they succeeded
+    uint64_t reload_microseconds;
+  };
+
+  /**
+   * Start watching.
+   * @param path the path of the configuration file, whose current contents are
+   * assumed to be in use already.
+   * @param callback applies each changed configuration.
+   * @throw std::runtime_error if the file cannot be watched.
+   */
+  ConfigWatcher(std::string path, Callback callback);
+
+  /**
+   * Stop watching, waiting for any reload in progress to finish.
+   */
+  ~ConfigWatcher();
+
+  ConfigWatcher(const ConfigWatcher &) = delete;
+  ConfigWatcher &operator=(const ConfigWatcher &) = delete;
+
+  /**
+   * Get the number and duration of reloads so far.
+   * @return the statistics.
+   */
+  Stats GetStats() const;
+
+ private:
+  /**
+   * Wait for changes to the directory, reloading after each burst of them,
+   * until stopped.
+   */
+  void Run();
+
+  /**
+   * Apply the configuration file if its contents have changed.
+   */
+  void Reload();
+
+  const std::string path_;
+  const Callback callback_;
+  // The contents last applied or rejected, to skip events that change nothing
+  std::string contents_;
+
+  std::atomic<uint64_t> reloads_;
+  std::atomic<uint64_t> failures_;
+  std::atomic<uint64_t> reload_microseconds_;
+
+  // The inotify instance, or -1 if not watching
+  int inotify_;
+  // Signalled to stop the thread
+  int stop_;
+  std::thread thread_;
+};
+
+}  // namespace config
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_CONFIG_CONFIG_WATCHER_H_
@@ -2,9 +2,11 @@
 #include <boost/algorithm/string/join.hpp>
 #include <google/protobuf/util/json_util.h>
 #include "spdlog/spdlog.h"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <thread>
 #include "config/config.pb.validate.h"
 
 using namespace std;
@@ -24,8 +26,12 @@ unique_ptr<authservice::config::Config> GetConfig(
   buf << configFile.rdbuf();
   configFile.close();
 
+  return ParseConfig(buf.str());
+}
+
+unique_ptr<authservice::config::Config> ParseConfig(const string &json) {
   unique_ptr<Config> config(new Config);
-  auto status = JsonStringToMessage(buf.str(), config.get());
+  auto status = JsonStringToMessage(json, config.get());
   if (!status.ok()) {
     throw runtime_error(status.error_message());
   }
@@ -42,11 +48,11 @@ spdlog::level::level_enum GetConfiguredLogLevel(const authservice::config::Confi
   auto log_level_string = config.log_level();
   spdlog::level::level_enum level;
 
-  if (log_level_string == "trace" || log_level_string.empty()) {
+  if (log_level_string == "trace") {
     level = spdlog::level::level_enum::trace;
   } else if (log_level_string == "debug") {
     level = spdlog::level::level_enum::debug;
-  } else if (log_level_string == "info") {
+  } else if (log_level_string == "info" || log_level_string.empty()) {
     level = spdlog::level::level_enum::info;
   } else if (log_level_string == "error") {
     level = spdlog::level::level_enum::err;
@@ -70,5 +76,41 @@ std::string GetConfiguredAddress(const authservice::config::Config& config) {
   return address;
 }
 
+unsigned int GetConfiguredCompletionQueues(const authservice::config::Config& config) {
+  if (config.completion_queues() > 0) {
+    return config.completion_queues();
+  }
+  // hardware_concurrency may return 0 when the number of cores cannot be determined.
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+unsigned int GetConfiguredPendingRequests(const authservice::config::Config& config) {
+  if (config.pending_requests() > 0) {
+    return config.pending_requests();
+  }
+  return 16;
+}
+
+size_t GetConfiguredLogQueueSize(const authservice::config::Config& config) {
+  if (config.log_queue_size() > 0) {
+    return config.log_queue_size();
+  }
+  return 8192;
+}
+
+spdlog::async_overflow_policy GetConfiguredLogOverflowPolicy(const authservice::config::Config& config) {
+  if (config.log_overflow_policy() == "drop") {
+    return spdlog::async_overflow_policy::overrun_oldest;
+  }
+  return spdlog::async_overflow_policy::block;
+}
+
+uint32_t GetConfiguredTimelineSampleRate(const authservice::config::Config& config) {
+  if (config.metrics().timelines_sample_rate() > 0) {
+    return config.metrics().timelines_sample_rate();
+  }
+  return 1000;
+}
+
 }  // namespace config
 }  // namespace authservice
@@ -3,6 +3,7 @@
 #define AUTHSERVICE_SRC_CONFIG_GETCONFIG_H
 
 #include "config/config.pb.h"
+#include "spdlog/async.h"
 #include "spdlog/spdlog.h"
 
 namespace authservice {
@@ -11,8 +12,21 @@ namespace config {
 std::unique_ptr<authservice::config::Config> GetConfig(
     const std::string& configFile);
 
+/**
+ * Parse and validate a configuration.
+ * @param json the configuration as JSON.
+ * @return the configuration.
+ * @throw std::runtime_error if the configuration is malformed or invalid.
+ */
+std::unique_ptr<authservice::config::Config> ParseConfig(const std::string& json);
+
 spdlog::level::level_enum GetConfiguredLogLevel(const authservice::config::Config& config);
 std::string GetConfiguredAddress(const authservice::config::Config& config);
+unsigned int GetConfiguredCompletionQueues(const authservice::config::Config& config);
+unsigned int GetConfiguredPendingRequests(const authservice::config::Config& config);
+size_t GetConfiguredLogQueueSize(const authservice::config::Config& config);
+spdlog::async_overflow_policy GetConfiguredLogOverflowPolicy(const authservice::config::Config& config);
+uint32_t GetConfiguredTimelineSampleRate(const authservice::config::Config& config);
 
 }  // namespace config
 }  // namespace authservice
@@ -0,0 +1,125 @@
+#include "chain_index.h"
+#include <algorithm>
+
+namespace authservice {
+namespace filters {
+
+const size_t ChainIndex::none;
+
+ChainIndex::ChainIndex(
+    const google::protobuf::RepeatedPtrField<config::FilterChain> &chains,
+    const std::string &context_extension)
+    : context_extension_(context_extension), catch_all_(none) {
+  std::unordered_map<std::string, size_t> positions;
+  for (int i = 0; i < chains.size(); ++i) {
+    const auto chain = static_cast<size_t>(i);
+    const auto &config = chains.Get(i);
+    names_.emplace(config.name(), chain);
+    if (!config.has_match()) {
+      catch_all_ = std::min(catch_all_, chain);
+      continue;
+    }
+
+    const auto &match = config.match();
+    auto position = positions.find(match.header());
+    if (position == positions.end()) {
+      position = positions.emplace(match.header(), headers_.size()).first;
+      headers_.emplace_back();
+      headers_.back().header = match.header();
+      headers_.back().first = chain;
+      headers_.back().prefixes.emplace_back();
+    }
+    auto &index = headers_[position->second];
+    switch (match.criteria_case()) {
+      case config::Match::kPrefix:
+        AddPrefix(index, match.prefix(), chain);
+        break;
+      case config::Match::kEquality:
+        // Keep the first chain expecting this value.
+        index.equality.emplace(match.equality(), chain);
+        break;
+      default:
+        throw std::runtime_error("invalid FilterChain match type");  // This should never happen.
+    }
+  }
+}
+
+void ChainIndex::AddPrefix(HeaderIndex &index, const std::string &prefix,
+                           size_t chain) {
+  uint32_t node = 0;
+  for (auto character : prefix) {
+    auto &children = index.prefixes[node].children;
+    auto child = std::lower_bound(
+        children.begin(), children.end(), character,
+        [](const std::pair<char, uint32_t> &entry, char c) {
+          return entry.first < c;
+        });
+    if (child != children.end() && child->first == character) {
+      node = child->second;
+      continue;
+    }
+    auto next = static_cast<uint32_t>(index.prefixes.size());
+    children.emplace(child, character, next);
+    // Adding the node may move the nodes, so it must come after the last use
+    // of `children`.
+    index.prefixes.emplace_back();
+    node = next;
+  }
+  index.prefixes[node].chain = std::min(index.prefixes[node].chain, chain);
+}
+
+absl::optional<size_t> ChainIndex::Find(
+    const ::envoy::service::auth::v2::CheckRequest *request) const {
+  if (!context_extension_.empty()) {
+    const auto &extensions = request->attributes().context_extensions();
+    auto name = extensions.find(context_extension_);
+    if (name != extensions.end()) {
+      auto chain = names_.find(name->second);
+      if (chain != names_.end()) {
+        return chain->second;
+      }
+    }
+  }
+
+  const auto &headers = request->attributes().request().http().headers();
+  auto best = catch_all_;
+  for (const auto &index : headers_) {
+    if (index.first >= best) {
+      continue;
+    }
+    auto value = headers.find(index.header);
+    if (value == headers.end()) {
+      continue;
+    }
+
+    auto equal = index.equality.find(value->second);
+    if (equal != index.equality.end()) {
+      best = std::min(best, equal->second);
+    }
+
+    // Walk the trie along the value. Every node passed is a prefix of it,
+    // starting with the empty prefix at the root.
+    uint32_t node = 0;
+    best = std::min(best, index.prefixes[node].chain);
+    for (auto character : value->second) {
+      const auto &children = index.prefixes[node].children;
+      auto child = std::lower_bound(
+          children.begin(), children.end(), character,
+          [](const std::pair<char, uint32_t> &entry, char c) {
+            return entry.first < c;
+          });
+      if (child == children.end() || child->first != character) {
+        break;
+      }
+      node = child->second;
+      best = std::min(best, index.prefixes[node].chain);
+    }
+  }
+  if (best == none) {
+    return absl::nullopt;
+  }
+  return best;
+}
+
+}  // namespace filters
+}  // namespace authservice
@@ -0,0 +1,84 @@
+#ifndef AUTHSERVICE_SRC_FILTERS_CHAIN_INDEX_H_
+#define AUTHSERVICE_SRC_FILTERS_CHAIN_INDEX_H_
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "absl/types/optional.h"
+#include "config/config.pb.h"
+#include "envoy/service/auth/v2/external_auth.grpc.pb.h"
+
+namespace authservice {
+namespace filters {
+
+/**
+ * ChainIndex finds the first filter chain whose match criteria a request
+ * meets, as checking FilterChain::Matches on each chain in order would, but
+ * without visiting every chain. It is compiled once from the configured
+ * chains. Equality criteria are kept in a hash table and prefix criteria in a
+ * trie, both grouped by header name, so a lookup costs one header lookup and
+ * one walk of the header value per distinct header name rather than one
+ * comparison per chain.
+ */
+class ChainIndex {
+ public:
+  /**
+   * Compile the index.
+   * @param chains the configured chains, in order of precedence.
+   * @param context_extension the key of the context extension naming the
+   * chain to apply, or empty to always use the match criteria.
+   */
+  explicit ChainIndex(
+      const google::protobuf::RepeatedPtrField<config::FilterChain> &chains,
+      const std::string &context_extension = "");
+
+  /**
+   * Find the chain named by the request's context extension, or else the
+   * first chain matching the request.
+   * @param request the request to match.
+   * @return the position of the chain in the configuration, or absl::nullopt
+   * if no chain matches.
+   */
+  absl::optional<size_t> Find(
+      const ::envoy::service::auth::v2::CheckRequest *request) const;
+
+ private:
+  static const size_t none = SIZE_MAX;
+
+  struct TrieNode {
+    // Sorted by character
+    std::vector<std::pair<char, uint32_t>> children;
+    // The first chain whose prefix ends at this node
+    size_t chain = none;
+  };
+
+  struct HeaderIndex {
+    std::string header;
+    // The first chain with any criteria on this header, to skip headers
+    // that cannot improve on a match already found
+    size_t first = none;
+    // The first chain for each expected value
+    std::unordered_map<std::string, size_t> equality;
+    // The expected prefixes, rooted at the first node
+    std::vector<TrieNode> prefixes;
+  };
+
+  /**
+   * Add a prefix to a header's trie, unless an earlier chain has added it.
+   */
+  static void AddPrefix(HeaderIndex &index, const std::string &prefix,
+                        size_t chain);
+
+  std::string context_extension_;
+  // The first chain with each name
+  std::unordered_map<std::string, size_t> names_;
+  std::vector<HeaderIndex> headers_;
+  // The first chain without match criteria, which matches every request
+  size_t catch_all_;
+};
+
+}  // namespace filters
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_FILTERS_CHAIN_INDEX_H_
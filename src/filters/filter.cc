@@ -4,15 +4,40 @@
 namespace authservice {
 namespace filters {
 
+absl::optional<google::rpc::Code> Filter::TryProcess(
+        const ::envoy::service::auth::v2::CheckRequest*,
+        ::envoy::service::auth::v2::CheckResponse*,
+        Deferral*) {
+  return absl::nullopt;
+}
+
+google::rpc::Code Filter::ProcessDeferred(
+        const ::envoy::service::auth::v2::CheckRequest* request,
+        ::envoy::service::auth::v2::CheckResponse* response,
+        const Deferral&,
+        const common::utilities::Deadline& deadline,
+        boost::asio::io_context& ioc,
+        boost::asio::yield_context yield) {
+  return Process(request, response, deadline, ioc, yield);
+}
+
 google::rpc::Code Filter::Process(
         const ::envoy::service::auth::v2::CheckRequest* request,
         ::envoy::service::auth::v2::CheckResponse* response) {
+  Deferral deferral;
+  deferral.timeline = common::metrics::Timeline::Current();
+  auto result = TryProcess(request, response, &deferral);
+  if (result.has_value()) {
+    return *result;
+  }
+
   boost::asio::io_context ioc;
+  common::utilities::Deadline deadline;
   google::rpc::Code code;
 
   // Spawn a co-routine to run the filter.
   boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
-    code = this->Process(request, response, ioc, yield);
+    code = this->ProcessDeferred(request, response, deferral, deadline, ioc, yield);
   });
 
   // Run the I/O context to completion.
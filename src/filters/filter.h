@@ -1,8 +1,13 @@
 #ifndef AUTHSERVICE_SRC_FILTERS_FILTER_H_
 #define AUTHSERVICE_SRC_FILTERS_FILTER_H_
+#include <memory>
+#include <vector>
 #include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "envoy/service/auth/v2/external_auth.grpc.pb.h"
 #include "google/rpc/code.pb.h"
+#include "src/common/metrics/timeline.h"
+#include "src/common/utilities/deadline.h"
 #include <boost/asio/spawn.hpp>
 #include <boost/asio.hpp>
 
@@ -10,6 +15,25 @@ using namespace envoy::service::auth::v2;
 
 namespace authservice {
 namespace filters {
+class Filter;
+
+/** @brief Where TryProcess stopped with a request it deferred.
+ *
+ * Filled in by TryProcess when it defers a request and handed back to
+ * ProcessDeferred, so that processing carries on from there instead of
+ * repeating the work TryProcess did. One per request.
+ */
+struct Deferral {
+  // The filters of the pipe that deferred the request, kept so that the
+  // request finishes with the filters it started with.
+  std::shared_ptr<const std::vector<std::shared_ptr<Filter>>> filters;
+  // The position among them of the filter that deferred the request.
+  size_t filter = 0;
+  // The timeline of the request, or nullptr. Carried here rather than made
+  // current, because the request may yield and resume on another thread.
+  common::metrics::Timeline *timeline = nullptr;
+};
+
 /** @brief Filter defines an abstract class for processing requests.
  *
  * Filter defines an abstract class for processing requests. Filters are
@@ -34,10 +58,13 @@ class Filter {
    * to processing which is in turn relayed to the caller.
    *
    * This must be run inside a Boost co-routine passing in the appropriate
-   * yield_context so requests can be processed asynchronously
+   * yield_context so requests can be processed asynchronously. Filters should
+   * give up on I/O once the deadline expires, in which case they return
+   * DEADLINE_EXCEEDED or CANCELLED.
    *
    * @param request the request process.
    * @param response the response to augment.
+   * @param deadline The deadline of the call, which expires early if the caller cancels it.
    * @param ioc The I/O context on which the filter should be executed.
    * @param yield The yield context used to yield processing to other co-routines.
    * @return the status of the processing. One of [OK, UNAUTHENTICATED,
@@ -46,13 +73,59 @@ class Filter {
   virtual google::rpc::Code Process(
           const ::envoy::service::auth::v2::CheckRequest* request,
           ::envoy::service::auth::v2::CheckResponse* response,
+          const common::utilities::Deadline& deadline,
           boost::asio::io_context& ioc,
           boost::asio::yield_context yield) = 0;
 
+  /** @brief Process a request on the calling thread if no I/O is needed.
+   *
+   * Filters that can decide a request without performing I/O should do so
+   * here, which lets the caller complete the request without spawning a
+   * co-routine. Filters that need to perform I/O for the given request return
+   * absl::nullopt, recording in the deferral whatever ProcessDeferred needs to
+   * carry on, in which case the caller finishes the request with
+   * ProcessDeferred and the response as TryProcess left it.
+   * The default implementation always returns absl::nullopt.
+   *
+   * @param request the request process.
+   * @param response the response to augment.
+   * @param deferral where to record how far processing got when deferring.
+   * @return the status of the processing as for Process, or absl::nullopt if
+   * the request must be processed asynchronously.
+   */
+  virtual absl::optional<google::rpc::Code> TryProcess(
+          const ::envoy::service::auth::v2::CheckRequest* request,
+          ::envoy::service::auth::v2::CheckResponse* response,
+          Deferral* deferral);
+
+  /** @brief Finish processing a request TryProcess deferred.
+   *
+   * Runs inside a Boost co-routine as Process does, but carries on from where
+   * TryProcess stopped rather than starting over. The default implementation
+   * calls Process, which suits filters whose TryProcess defers without having
+   * done anything; filters that defer part way through must override it.
+   *
+   * @param request the request process.
+   * @param response the response to augment, as TryProcess left it.
+   * @param deferral what TryProcess recorded when deferring the request.
+   * @param deadline The deadline of the call, which expires early if the caller cancels it.
+   * @param ioc The I/O context on which the filter should be executed.
+   * @param yield The yield context used to yield processing to other co-routines.
+   * @return the status of the processing as for Process.
+   */
+  virtual google::rpc::Code ProcessDeferred(
+          const ::envoy::service::auth::v2::CheckRequest* request,
+          ::envoy::service::auth::v2::CheckResponse* response,
+          const Deferral& deferral,
+          const common::utilities::Deadline& deadline,
+          boost::asio::io_context& ioc,
+          boost::asio::yield_context yield);
+
   /** @brief Process a request synchronously.
    *
-   * Creates a new Boost io_context then calls the asynchronous version of this
-   * function inside a co-routine on this context.
+   * Uses TryProcess when possible, otherwise creates a new Boost io_context
+   * then calls ProcessDeferred inside a co-routine on this context, without a
+   * deadline.
    * Mainly intended for use in tests.
    *
    * @param request the request process.
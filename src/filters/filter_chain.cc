@@ -1,12 +1,107 @@
 #include "filter_chain.h"
 #include "spdlog/spdlog.h"
 #include "absl/strings/match.h"
+#include "src/common/metrics/metrics.h"
 #include "src/filters/oidc/oidc_filter.h"
 #include "src/filters/pipe.h"
 
 namespace authservice {
 namespace filters {
-    FilterChainImpl::FilterChainImpl(authservice::config::FilterChain config): config_(std::move(config)) {
+namespace {
+// Load the key set given in the configuration, or start fetching it from the OIDC Provider.
+oidc::JwksProviderPtr CreateJwksProvider(const authservice::config::oidc::OIDCConfig &config,
+                                         common::http::ptr_t http, oidc::JwksRefresherPtr refresher) {
+  if (config.has_jwks_uri()) {
+    auto refresh_interval = config.jwks_fetcher().refresh_interval() > 0 ? config.jwks_fetcher().refresh_interval()
+                                                                         : 600;
+    auto min_refetch_interval = config.jwks_fetcher().min_refetch_interval() > 0
+                                ? config.jwks_fetcher().min_refetch_interval() : 10;
+    return std::make_shared<oidc::RemoteJwksProvider>(
+        config.jwks_uri(), std::move(http), std::chrono::seconds(refresh_interval),
+        std::chrono::seconds(min_refetch_interval),
+        refresher != nullptr ? std::move(refresher) : std::make_shared<oidc::JwksRefresher>());
+  }
+  return oidc::StaticJwksProvider::Create(config.jwks());
+}
+
+// Series of a chain's metrics. Looked up by the chain's name, so that the
+// chains of successive configurations count in the same series and the totals
+// never go backwards when a configuration is reloaded.
+class ChainMetrics {
+ public:
+  explicit ChainMetrics(std::string chain) : chain_(std::move(chain)) {}
+
+  common::session::SessionCache::Metrics SessionCacheMetrics() const {
+    const char *lookups_help = "Lookups of token cookies in the session cache, by result.";
+    return {&GetCounter("authservice_session_cache_lookups_total", lookups_help, {{"result", "hit"}}),
+            &GetCounter("authservice_session_cache_lookups_total", lookups_help, {{"result", "miss"}}),
+            &GetCounter("authservice_session_cache_evictions_total",
+                        "Entries evicted from the session cache to bound its size.")};
+  }
+
+  common::http::TlsContext::Metrics TlsMetrics() const {
+    const char *help = "TLS handshakes with the OIDC Provider, by whether a session was resumed.";
+    return {&GetCounter("authservice_tls_handshakes_total", help, {{"type", "full"}}),
+            &GetCounter("authservice_tls_handshakes_total", help, {{"type", "resumed"}})};
+  }
+
+  common::http::ResolverCache::Metrics ResolverMetrics() const {
+    const char *lookups_help = "Lookups of OIDC Provider host names in the DNS cache, by result.";
+    return {&GetCounter("authservice_dns_cache_lookups_total", lookups_help, {{"result", "hit"}}),
+            &GetCounter("authservice_dns_cache_lookups_total", lookups_help, {{"result", "miss"}}),
+            &common::metrics::Registry::Default().GetHistogram(
+                "authservice_dns_resolution_duration_seconds",
+                "The time taken by DNS resolutions of OIDC Provider host names.", {{"chain", chain_}})};
+  }
+
+ private:
+  common::metrics::Counter &GetCounter(const char *name, const char *help, common::metrics::Labels labels = {}) const {
+    labels.insert(labels.begin(), {"chain", chain_});
+    return common::metrics::Registry::Default().GetCounter(name, help, labels);
+  }
+
+  const std::string chain_;
+};
+}  // namespace
+
+    FilterChainImpl::FilterChainImpl(authservice::config::FilterChain config, common::http::ptr_t http,
+                                     oidc::JwksRefresherPtr refresher)
+        : config_(std::move(config)) {
+      // Build the filters once so that the JWKS, encryptor and HTTP client are shared by every request rather than
+      // being recreated per request.
+      std::unique_ptr<Pipe> pipe(new Pipe);
+      ChainMetrics metrics(config_.name());
+      for (const auto &filter : config_.filters()) {
+        // TODO: implement filter specific construction.
+        if (!filter.has_oidc()) {
+          throw std::runtime_error("unsupported filter type");
+        }
+        auto filter_http = http;
+        if (filter_http == nullptr) {
+          auto pool = std::make_shared<common::http::ConnectionPool>(metrics.TlsMetrics());
+          // Load the TLS context for the token endpoint now rather than on the first callback.
+          pool->Context(filter.oidc().token());
+          auto resolver = std::make_shared<common::http::ResolverCache>(metrics.ResolverMetrics());
+          filter_http = std::make_shared<common::http::http_impl>(pool, resolver);
+        }
+
+        auto token_request_parser =
+            std::make_shared<oidc::TokenResponseParserImpl>(CreateJwksProvider(filter.oidc(), filter_http, refresher));
+
+        // Cookies of either format are read, but only written as V2 when asked, as older replicas cannot read it.
+        auto cookie_format = filter.oidc().cookie_format() == authservice::config::oidc::OIDCConfig::V2
+                                 ? common::session::TokenFormat::V2
+                                 : common::session::TokenFormat::V1;
+        auto token_encryptor = common::session::TokenEncryptor::Create(
+            filter.oidc().cryptor_secret(),
+            common::session::EncryptionAlg::AES256GCM,
+            common::session::HKDFHash::SHA512,
+            cookie_format);
+
+        pipe->AddFilter(filters::FilterPtr(new filters::oidc::OidcFilter(
+            filter_http, filter.oidc(), token_request_parser, token_encryptor, metrics.SessionCacheMetrics())));
+      }
+      instance_ = std::move(pipe);
     }
 
     const std::string &FilterChainImpl::Name() const {
@@ -32,30 +127,8 @@ namespace filters {
       return true;
     }
 
-    std::unique_ptr<Filter> FilterChainImpl::New() {
-      spdlog::trace("{}", __func__);
-      std::unique_ptr<Pipe> result(new Pipe);
-      for (const auto &filter : config_.filters()) {
-        // TODO: implement filter specific construction.
-        if (!filter.has_oidc()) {
-          throw std::runtime_error("unsupported filter type");
-        }
-        auto token_request_parser =
-            std::make_shared<oidc::TokenResponseParserImpl>(
-                google::jwt_verify::Jwks::createFrom(
-                    filter.oidc().jwks(), google::jwt_verify::Jwks::Type::JWKS));
-
-        auto token_encryptor = common::session::TokenEncryptor::Create(
-            filter.oidc().cryptor_secret(),
-            common::session::EncryptionAlg::AES256GCM,
-            common::session::HKDFHash::SHA512);
-
-        auto http = common::http::ptr_t(new common::http::http_impl);
-
-        result->AddFilter(filters::FilterPtr(new filters::oidc::OidcFilter(
-            http, filter.oidc(), token_request_parser, token_encryptor)));
-      }
-      return result;
+    Filter &FilterChainImpl::Instance() const {
+      return *instance_;
     }
 }  // namespace filters
 }  // namespace authservice
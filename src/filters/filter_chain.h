@@ -3,6 +3,8 @@
 #include "envoy/service/auth/v2/external_auth.grpc.pb.h"
 #include "src/filters/filter.h"
 #include "config/config.pb.h"
+#include "src/common/http/http.h"
+#include "src/filters/oidc/jwks_provider.h"
 #include <memory>
 
 namespace authservice {
@@ -25,20 +27,30 @@ public:
      */
     virtual bool Matches(const ::envoy::service::auth::v2::CheckRequest* request) const = 0;
     /**
-     * New creates a new filter instance that can be used to process a request.
-     * @return a new filter instance.
+     * Instance returns the filter instance that processes requests for this chain. The instance is built once when
+     * the chain is configured and is shared by all requests, so it must be safe to use concurrently.
+     * @return the filter instance.
      */
-    virtual std::unique_ptr<Filter> New() = 0;
+    virtual Filter &Instance() const = 0;
 };
 
 class FilterChainImpl : public FilterChain {
 private:
     authservice::config::FilterChain config_;
+    std::unique_ptr<Filter> instance_;
 public:
-    explicit FilterChainImpl(authservice::config::FilterChain config);
+    /**
+     * @param config the configuration of the chain.
+     * @param http the HTTP client the chain's filters reach the OIDC Provider with, or nullptr for each filter to
+     * create its own.
+     * @param refresher runs the background fetches of the chain's key sets, or nullptr for each filter fetching one to
+     * create its own.
+     */
+    explicit FilterChainImpl(authservice::config::FilterChain config, common::http::ptr_t http = nullptr,
+                             oidc::JwksRefresherPtr refresher = nullptr);
     const std::string &Name() const override;
     bool Matches(const ::envoy::service::auth::v2::CheckRequest* request) const override;
-    std::unique_ptr<Filter> New() override;
+    Filter &Instance() const override;
 };
 
 }  // namespace filters
@@ -0,0 +1,258 @@
+#include "jwks_provider.h"
+#include <algorithm>
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "absl/types/optional.h"
+#include "spdlog/spdlog.h"
+
+namespace authservice {
+namespace filters {
+namespace oidc {
+namespace {
+// Get how long a response may be cached from its Cache-Control header, if it says.
+absl::optional<RemoteJwksProvider::Clock::duration> MaxAge(absl::string_view cache_control) {
+  for (auto directive : absl::StrSplit(cache_control, ',')) {
+    directive = absl::StripAsciiWhitespace(directive);
+    if (absl::EqualsIgnoreCase(directive, "no-cache") || absl::EqualsIgnoreCase(directive, "no-store")) {
+      return RemoteJwksProvider::Clock::duration::zero();
+    }
+    uint32_t seconds;
+    if (absl::ConsumePrefix(&directive, "max-age=") && absl::SimpleAtoi(directive, &seconds)) {
+      return std::chrono::seconds(seconds);
+    }
+  }
+  return absl::nullopt;
+}
+}  // namespace
+
+StaticJwksProvider::StaticJwksProvider(google::jwt_verify::JwksPtr keys) : keys_(std::move(keys)) {}
+
+JwksProviderPtr StaticJwksProvider::Create(const std::string &jwks) {
+  auto keys = google::jwt_verify::Jwks::createFrom(jwks, google::jwt_verify::Jwks::Type::JWKS);
+  if (keys->getStatus() != google::jwt_verify::Status::Ok) {
+    spdlog::error("{}: invalid JWKS: {}", __func__, google::jwt_verify::getStatusString(keys->getStatus()));
+  }
+  return std::make_shared<StaticJwksProvider>(std::move(keys));
+}
+
+JwksSnapshot StaticJwksProvider::Keys() const { return keys_; }
+
+void StaticJwksProvider::Refetch(const common::utilities::Deadline &,
+                                 boost::asio::io_context &,
+                                 boost::asio::yield_context) {
+  // The configured keys never change.
+}
+
+/**
+ * A request waiting in Refetch. It is resumed once, by whichever comes first of
+ * the fetch completing, which may happen on the refresher's thread, and its
+ * deadline passing.
+ */
+struct RemoteJwksProvider::Waiter {
+  typedef boost::asio::async_completion<boost::asio::yield_context, void()>::completion_handler_type Handler;
+
+  Waiter(boost::asio::io_context &ioc, Handler handler) : handler(new Handler(std::move(handler))), timer(ioc) {}
+
+  /**
+   * Resume the request unless it has been already, on its own executor.
+   */
+  void Resume() {
+    std::unique_ptr<Handler> resume;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      resume = std::move(handler);
+      timer.cancel();
+    }
+    if (resume != nullptr) {
+      boost::asio::post(std::move(*resume));
+    }
+  }
+
+  // Guards the fields below
+  std::mutex mutex;
+  std::unique_ptr<Handler> handler;
+  // Expires at the request's deadline.
+  boost::asio::steady_timer timer;
+};
+
+struct RemoteJwksProvider::State {
+  State(authservice::config::common::Endpoint endpoint, common::http::ptr_t http, Clock::duration refresh_interval,
+        Clock::duration min_refetch_interval, boost::asio::io_context &ioc)
+      : endpoint(std::move(endpoint)),
+        http(std::move(http)),
+        refresh_interval(refresh_interval),
+        min_refetch_interval(min_refetch_interval),
+        fetching(false),
+        refetch_requested(false),
+        ioc(ioc),
+        timer(ioc) {}
+
+  const authservice::config::common::Endpoint endpoint;
+  const common::http::ptr_t http;
+  const Clock::duration refresh_interval;
+  const Clock::duration min_refetch_interval;
+
+  JwksSnapshot keys;
+  // Cancelled when the provider is destroyed, which abandons a fetch in progress.
+  common::utilities::Deadline stopped;
+
+  // Guards the fields below
+  std::mutex mutex;
+  Clock::time_point last_fetch;
+  bool fetching;
+  bool refetch_requested;
+  // Requests waiting for the fetch in progress or requested, resumed when it
+  // completes.
+  std::vector<std::shared_ptr<Waiter>> waiters;
+
+  // Only used on the refresher's thread
+  boost::asio::io_context &ioc;
+  boost::asio::steady_timer timer;
+};
+
+JwksRefresher::JwksRefresher()
+    : work_(boost::asio::make_work_guard(ioc_)), thread_([this]() { ioc_.run(); }) {}
+
+JwksRefresher::~JwksRefresher() {
+  // Fetches still in progress, and the connections they hold, are destroyed with ioc_.
+  ioc_.stop();
+  thread_.join();
+}
+
+RemoteJwksProvider::RemoteJwksProvider(authservice::config::common::Endpoint endpoint,
+                                       common::http::ptr_t http,
+                                       Clock::duration refresh_interval,
+                                       Clock::duration min_refetch_interval,
+                                       JwksRefresherPtr refresher)
+    : refresher_(std::move(refresher)),
+      state_(std::make_shared<State>(std::move(endpoint), std::move(http), refresh_interval, min_refetch_interval,
+                                     refresher_->Context())) {
+  auto state = state_;
+  boost::asio::spawn(refresher_->Context(), [state](boost::asio::yield_context yield) { Run(state, yield); });
+}
+
+RemoteJwksProvider::~RemoteJwksProvider() {
+  // Abandon a fetch in progress rather than wait for it to time out, and wake
+  // the co-routine if it is waiting for the next fetch, so that it exits.
+  state_->stopped.Cancel();
+  auto state = state_;
+  boost::asio::post(refresher_->Context(), [state]() { state->timer.cancel(); });
+}
+
+JwksSnapshot RemoteJwksProvider::Keys() const {
+  return std::atomic_load(&state_->keys);
+}
+
+void RemoteJwksProvider::Refetch(const common::utilities::Deadline &deadline,
+                                 boost::asio::io_context &ioc,
+                                 boost::asio::yield_context yield) {
+  if (deadline.Expired()) {
+    return;
+  }
+  boost::asio::async_completion<boost::asio::yield_context, void()> completion(yield);
+  auto waiter = std::make_shared<Waiter>(ioc, std::move(completion.completion_handler));
+  auto &state = *state_;
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    // Join a fetch that is in progress or already requested rather than starting another.
+    if (!state.fetching && !state.refetch_requested) {
+      if (Clock::now() - state.last_fetch < state.min_refetch_interval) {
+        spdlog::debug("{}: keys of {} fetched recently, not fetching again", __func__, state.endpoint.hostname());
+        return;
+      }
+      state.refetch_requested = true;
+      // The timer is only touched on the refresher's thread.
+      auto shared = state_;
+      boost::asio::post(state.ioc, [shared]() { shared->timer.cancel(); });
+    }
+    state.waiters.push_back(waiter);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(waiter->mutex);
+    if (waiter->handler != nullptr) {
+      waiter->timer.expires_at(deadline.At());
+      waiter->timer.async_wait([waiter](const boost::system::error_code &ec) {
+        if (!ec) {
+          waiter->Resume();
+        }
+      });
+    }
+  }
+  auto registration = deadline.OnCancel([waiter]() { waiter->Resume(); });
+  completion.result.get();
+
+  // Stop waiting for the fetch if the deadline passed or the call was cancelled first.
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.waiters.erase(std::remove(state.waiters.begin(), state.waiters.end(), waiter), state.waiters.end());
+}
+
+void RemoteJwksProvider::Run(const std::shared_ptr<State> &state, boost::asio::yield_context yield) {
+  while (!state->stopped.Cancelled()) {
+    auto next = Fetch(*state, yield);
+    if (state->stopped.Cancelled()) {
+      return;
+    }
+    state->timer.expires_after(next);
+    boost::system::error_code ec;
+    // Cancelled early when a refetch is requested or the provider is destroyed.
+    state->timer.async_wait(yield[ec]);
+  }
+}
+
+RemoteJwksProvider::Clock::duration RemoteJwksProvider::Fetch(State &state, boost::asio::yield_context yield) {
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.fetching = true;
+    state.refetch_requested = false;
+    state.last_fetch = Clock::now();
+  }
+
+  auto next = state.min_refetch_interval;
+  JwksSnapshot fetched;
+  const auto &endpoint = state.endpoint;
+  try {
+    // Each attempt is bounded by the endpoint's timeouts rather than by a
+    // deadline, and abandoned if the provider is destroyed.
+    auto response = state.http->Get(endpoint, {}, state.stopped, state.ioc, yield);
+    if (response == nullptr) {
+      spdlog::info("{}: failed to fetch keys from {}", __func__, endpoint.hostname());
+    } else if (response->result() != boost::beast::http::status::ok) {
+      spdlog::info("{}: failed to fetch keys from {}: HTTP status {}", __func__, endpoint.hostname(),
+                   response->result_int());
+    } else {
+      JwksSnapshot keys(google::jwt_verify::Jwks::createFrom(response->body(), google::jwt_verify::Jwks::Type::JWKS));
+      if (keys->getStatus() != google::jwt_verify::Status::Ok) {
+        spdlog::info("{}: invalid keys from {}: {}", __func__, endpoint.hostname(),
+                     google::jwt_verify::getStatusString(keys->getStatus()));
+      } else {
+        fetched = keys;
+        auto max_age = MaxAge(std::string((*response)[boost::beast::http::field::cache_control]));
+        next = std::max(state.min_refetch_interval, max_age.value_or(state.refresh_interval));
+        spdlog::debug("{}: fetched keys from {}", __func__, endpoint.hostname());
+      }
+    }
+  } catch (const std::exception &e) {
+    spdlog::error("{}: unexpected error fetching keys from {}: {}", __func__, endpoint.hostname(), e.what());
+  }
+
+  std::vector<std::shared_ptr<Waiter>> waiters;
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (fetched != nullptr) {
+      std::atomic_store(&state.keys, fetched);
+    }
+    state.fetching = false;
+    waiters.swap(state.waiters);
+  }
+  for (auto &waiter : waiters) {
+    waiter->Resume();
+  }
+  return next;
+}
+
+}  // namespace oidc
+}  // namespace filters
+}  // namespace authservice
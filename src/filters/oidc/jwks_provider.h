@@ -0,0 +1,177 @@
+#ifndef AUTHSERVICE_SRC_FILTERS_OIDC_JWKS_PROVIDER_H_
+#define AUTHSERVICE_SRC_FILTERS_OIDC_JWKS_PROVIDER_H_
+#include <boost/asio.hpp>
+#include <boost/asio/spawn.hpp>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "config/common/config.pb.h"
+#include "jwt_verify_lib/jwks.h"
+#include "src/common/http/http.h"
+#include "src/common/utilities/deadline.h"
+
+namespace authservice {
+namespace filters {
+namespace oidc {
+
+class JwksProvider;
+typedef std::shared_ptr<JwksProvider> JwksProviderPtr;
+typedef std::shared_ptr<const google::jwt_verify::Jwks> JwksSnapshot;
+
+/**
+ * JwksProvider supplies the key set used to verify `id_token` signatures.
+ */
+class JwksProvider {
+ public:
+  virtual ~JwksProvider() = default;
+
+  /**
+   * Get the current key set. The snapshot stays valid while it is held, even
+   * if a newer key set replaces it.
+   * @return the key set, or nullptr if none has been loaded yet.
+   */
+  virtual JwksSnapshot Keys() const = 0;
+
+  /**
+   * Called when a token is signed with a key that is not in the current key
+   * set, which happens when the OIDC Provider rotates its keys. Waits inside a
+   * Boost co-routine for the key set to be fetched again, if the provider
+   * fetches it at all.
+   * @param deadline the deadline of the call waiting for the key.
+   * @param ioc      the I/O context on which the co-routine is running.
+   * @param yield    the yield context of the co-routine.
+   */
+  virtual void Refetch(const common::utilities::Deadline &deadline,
+                       boost::asio::io_context &ioc,
+                       boost::asio::yield_context yield) = 0;
+};
+
+/**
+ * A key set given in the configuration, parsed once.
+ */
+class StaticJwksProvider final : public JwksProvider {
+ public:
+  explicit StaticJwksProvider(google::jwt_verify::JwksPtr keys);
+
+  /**
+   * Parse a key set in JWKS format. An invalid key set is logged, and fails
+   * the verification of every token.
+   * @param jwks the key set.
+   * @return the provider.
+   */
+  static JwksProviderPtr Create(const std::string &jwks);
+
+  JwksSnapshot Keys() const override;
+
+  void Refetch(const common::utilities::Deadline &deadline,
+               boost::asio::io_context &ioc,
+               boost::asio::yield_context yield) override;
+
+ private:
+  const JwksSnapshot keys_;
+};
+
+class JwksRefresher;
+typedef std::shared_ptr<JwksRefresher> JwksRefresherPtr;
+
+/**
+ * Runs the background fetches of every RemoteJwksProvider given it on one
+ * thread, so that the number of threads does not grow with the number of
+ * filter chains. Kept alive by the providers using it. Thread safe.
+ */
+class JwksRefresher {
+ public:
+  JwksRefresher();
+
+  /**
+   * Abandon the fetches still in progress and stop the thread.
+   */
+  ~JwksRefresher();
+
+  /**
+   * @return the io_context the fetches run on.
+   */
+  boost::asio::io_context &Context() { return ioc_; }
+
+ private:
+  boost::asio::io_context ioc_;
+  // Keeps the thread running while no provider is fetching.
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_;
+  std::thread thread_;
+};
+
+/**
+ * A key set fetched from the OIDC Provider's `jwks_uri`. The key set is
+ * fetched as soon as the provider is created and refreshed in the background
+ * from then on, on the thread of a JwksRefresher. Each fetch replaces the
+ * key set atomically, so readers never wait for a fetch. Thread safe.
+ */
+class RemoteJwksProvider final : public JwksProvider {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * Start fetching the key set.
+   * @param endpoint             the `jwks_uri` of the OIDC Provider.
+   * @param http                 the HTTP client used to fetch it.
+   * @param refresh_interval     the time between fetches when the response
+   * has no `Cache-Control: max-age`.
+   * @param min_refetch_interval the minimum time between fetches, which also
+   * bounds how often unknown keys can trigger a fetch.
+   * @param refresher            runs the fetches.
+   */
+  RemoteJwksProvider(authservice::config::common::Endpoint endpoint,
+                     common::http::ptr_t http,
+                     Clock::duration refresh_interval,
+                     Clock::duration min_refetch_interval,
+                     JwksRefresherPtr refresher);
+
+  /**
+   * Abandon a fetch in progress and stop refreshing, without waiting for
+   * either.
+   */
+  ~RemoteJwksProvider() override;
+
+  JwksSnapshot Keys() const override;
+
+  /**
+   * Fetch the key set early unless it was fetched less than the minimum
+   * refetch interval ago, and wait for the fetch in progress to complete.
+   * Every request that calls this while a fetch is in progress waits for the
+   * same fetch, and is resumed as soon as it completes.
+   */
+  void Refetch(const common::utilities::Deadline &deadline,
+               boost::asio::io_context &ioc,
+               boost::asio::yield_context yield) override;
+
+ private:
+  struct Waiter;
+  // Shared with the co-routine that fetches the key set, which may outlive
+  // the provider until it notices that it has been destroyed.
+  struct State;
+
+  /**
+   * Fetch the key set, then wait until the next fetch is due or requested.
+   * Runs until the provider is destroyed.
+   */
+  static void Run(const std::shared_ptr<State> &state,
+                  boost::asio::yield_context yield);
+
+  /**
+   * Fetch and store the key set.
+   * @return the time until the key set should be fetched again.
+   */
+  static Clock::duration Fetch(State &state, boost::asio::yield_context yield);
+
+  // Keeps the io_context the key set is fetched on alive.
+  const JwksRefresherPtr refresher_;
+  const std::shared_ptr<State> state_;
+};
+
+}  // namespace oidc
+}  // namespace filters
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_FILTERS_OIDC_JWKS_PROVIDER_H_
@@ -4,9 +4,11 @@
 #include "absl/strings/str_join.h"
 #include "absl/time/time.h"
 #include "google/rpc/code.pb.h"
+#include "jwt_verify_lib/jwt.h"
 #include "spdlog/spdlog.h"
 #include "src/common/http/headers.h"
 #include "src/common/http/http.h"
+#include "src/common/metrics/timeline.h"
 #include "src/common/utilities/random.h"
 #include "state_cookie_codec.h"
 #include <limits>
@@ -31,16 +33,63 @@ const std::map<const char *, const char *> standard_headers = {
     {common::http::headers::Pragma,
      common::http::headers::PragmaDirectives::NoCache},
 };
+
+std::string EncodeScopes(const authservice::config::oidc::OIDCConfig &idp_config) {
+  std::set<absl::string_view> scopes = {mandatory_scope_};
+  for (const auto &scope : idp_config.scopes()) {
+    scopes.insert(scope);
+  }
+  return absl::StrJoin(scopes, " ");
+}
+
+std::string EncodeHostWithPort(const authservice::config::common::Endpoint &endpoint) {
+  std::stringstream buf;
+  buf << endpoint.hostname() << ':' << std::dec << endpoint.port();
+  return buf.str();
+}
+
+common::session::SessionCachePtr CreateSessionCache(
+    const authservice::config::oidc::SessionCacheConfig &config,
+    const common::session::SessionCache::Metrics &metrics) {
+  size_t max_bytes = config.max_bytes() > 0 ? config.max_bytes() : 16 * 1024 * 1024;
+  uint32_t max_age = config.max_age() > 0 ? config.max_age() : 300;
+  return std::make_shared<common::session::SessionCache>(max_bytes, absl::Seconds(max_age),
+                                                         common::session::SessionCache::default_shards, metrics);
+}
 }  // namespace
 
 OidcFilter::OidcFilter(common::http::ptr_t http_ptr,
                        const authservice::config::oidc::OIDCConfig &idp_config,
                        TokenResponseParserPtr parser,
-                       common::session::TokenEncryptorPtr cryptor)
+                       common::session::TokenEncryptorPtr cryptor,
+                       const common::session::SessionCache::Metrics &session_metrics)
     : http_ptr_(http_ptr),
       idp_config_(idp_config),
       parser_(parser),
-      cryptor_(cryptor) {
+      cryptor_(cryptor),
+      session_cache_(CreateSessionCache(idp_config_.session_cache(), session_metrics)),
+      state_cookie_name_(GetCookieName("state")),
+      id_token_cookie_name_(GetCookieName("id-token")),
+      access_token_cookie_name_(GetCookieName("access-token")),
+      authorization_url_(common::http::http::ToUrl(idp_config_.authorization())),
+      callback_url_(common::http::http::ToUrl(idp_config_.callback())),
+      callback_host_(EncodeHostWithPort(idp_config_.callback())),
+      encoded_scopes_(EncodeScopes(idp_config_)),
+      basic_auth_(common::http::http::EncodeBasicAuth(idp_config_.client_id(),
+                                                      idp_config_.client_secret())),
+      cookie_decrypt_failures_(common::metrics::Registry::Default().GetCounter(
+          "authservice_oidc_cookie_decrypt_failures_total", "Token cookies that could not be decrypted.")),
+      redirects_(common::metrics::Registry::Default().GetCounter(
+          "authservice_oidc_redirects_total", "Requests redirected to the OIDC Provider to authenticate.")),
+      token_exchanges_(common::metrics::Registry::Default().GetCounter(
+          "authservice_oidc_token_exchanges_total",
+          "Authorization codes exchanged for tokens with the OIDC Provider, by result.", {{"result", "success"}})),
+      token_exchange_failures_(common::metrics::Registry::Default().GetCounter(
+          "authservice_oidc_token_exchanges_total",
+          "Authorization codes exchanged for tokens with the OIDC Provider, by result.", {{"result", "failure"}})),
+      token_request_duration_(common::metrics::Registry::Default().GetHistogram(
+          "authservice_oidc_token_request_duration_seconds",
+          "The time taken by token requests to the OIDC Provider, including connecting and retries.")) {
   spdlog::trace("{}", __func__);
 }
 
@@ -83,16 +132,20 @@ std::string OidcFilter::GetCookieName(const std::string &cookie) const {
          cookie + "-cookie";
 }
 
-std::string OidcFilter::GetStateCookieName() const {
-  return GetCookieName("state");
+const std::string &OidcFilter::GetStateCookieName() const {
+  return state_cookie_name_;
 }
 
-std::string OidcFilter::GetIdTokenCookieName() const {
-  return GetCookieName("id-token");
+const std::string &OidcFilter::GetIdTokenCookieName() const {
+  return id_token_cookie_name_;
 }
 
-std::string OidcFilter::GetAccessTokenCookieName() const {
-  return GetCookieName("access-token");
+const common::session::SessionCache &OidcFilter::GetSessionCache() const {
+  return *session_cache_;
+}
+
+const std::string &OidcFilter::GetAccessTokenCookieName() const {
+  return access_token_cookie_name_;
 }
 
 std::string OidcFilter::EncodeHeaderValue(const std::string &preamble,
@@ -167,46 +220,39 @@ google::rpc::Code OidcFilter::RedirectToIdP(
   common::utilities::RandomGenerator generator;
   auto state = generator.Generate(32).Str();
   auto nonce = generator.Generate(32).Str();
-  std::set<absl::string_view> scopes = {mandatory_scope_};
-  for (const auto &scope : idp_config_.scopes()) {
-    scopes.insert(scope);
-  }
-
-  auto callback = common::http::http::ToUrl(idp_config_.callback());
-  auto encoded_scopes = absl::StrJoin(scopes, " ");
   std::multimap<absl::string_view, absl::string_view> params = {
       {"response_type", "code"},
-      {"scope", encoded_scopes},
+      {"scope", encoded_scopes_},
       {"client_id", idp_config_.client_id()},
       {"nonce", nonce},
       {"state", state},
-      {"redirect_uri", callback}};
+      {"redirect_uri", callback_url_}};
   auto query = common::http::http::EncodeQueryData(params);
 
   // Set redirect
-  SetRedirectHeaders(
-      absl::StrJoin(
-          {common::http::http::ToUrl(idp_config_.authorization()), query}, "?"),
-      response);
+  SetRedirectHeaders(absl::StrJoin({authorization_url_, query}, "?"), response);
 
   // Create a secure state cookie that contains the state and nonce.
   StateCookieCodec codec;
   SetEncryptedCookie(response->mutable_denied_response()->mutable_headers(), GetStateCookieName(),
                      codec.Encode(state, nonce), idp_config_.timeout());
+  redirects_.Increment();
   return google::rpc::Code::UNAUTHENTICATED;
 }
 
-google::rpc::Code OidcFilter::Process(
+absl::optional<google::rpc::Code> OidcFilter::TryProcess(
     const ::envoy::service::auth::v2::CheckRequest *request,
     ::envoy::service::auth::v2::CheckResponse *response,
-    boost::asio::io_context& ioc,
-    boost::asio::yield_context yield) {
+    Deferral *) {
   spdlog::trace("{}", __func__);
-  spdlog::debug(
-      "Call from {}@{} to {}@{}", request->attributes().source().principal(),
-      request->attributes().source().address().socket_address().address(),
-      request->attributes().destination().principal(),
-      request->attributes().destination().address().socket_address().address());
+  // Checked first so that the arguments are not evaluated for every request when debug logging is off.
+  if (spdlog::default_logger_raw()->should_log(spdlog::level::debug)) {
+    spdlog::debug(
+        "Call from {}@{} to {}@{}", request->attributes().source().principal(),
+        request->attributes().source().address().socket_address().address(),
+        request->attributes().destination().principal(),
+        request->attributes().destination().address().socket_address().address());
+  }
   if (!request->attributes().request().has_http()) {
     spdlog::info("{}: missing http in request", __func__);
     SetStandardResponseHeaders(response);
@@ -244,7 +290,7 @@ google::rpc::Code OidcFilter::Process(
   // Check if an id_token header already exists. If so let request
   // progress. It is up to the downstream system to validate the header is
   // valid.
-  auto headers = request->attributes().request().http().headers();
+  const auto &headers = request->attributes().request().http().headers();
   if (headers.contains(idp_config_.id_token().header())) {
     return google::rpc::Code::OK;
   }
@@ -253,6 +299,10 @@ google::rpc::Code OidcFilter::Process(
   // cookie, If not go through authentication redirection dance.
   auto id_token = GetTokenFromCookie(headers, GetIdTokenCookieName());
   auto access_token = GetTokenFromCookie(headers, GetAccessTokenCookieName());
+  auto timeline = common::metrics::Timeline::Current();
+  if (timeline != nullptr) {
+    timeline->Record(common::metrics::Stage::cookies_decrypted);
+  }
   if (id_token.has_value() && (!idp_config_.has_access_token() || access_token.has_value())) {
     SetIdTokenHeader(response, id_token.value());
     if (access_token.has_value()) {
@@ -261,34 +311,65 @@ google::rpc::Code OidcFilter::Process(
     return google::rpc::Code::OK;
   }
 
-  // Set standard headers
-  SetStandardResponseHeaders(response);
-  spdlog::trace("{}: checking handler for {}://{}{}", __func__,
-                request->attributes().request().http().scheme(),
-                request->attributes().request().http().host(),
-                request->attributes().request().http().path());
+  if (spdlog::default_logger_raw()->should_log(spdlog::level::trace)) {
+    spdlog::trace("{}: checking handler for {}://{}{}", __func__,
+                  request->attributes().request().http().scheme(),
+                  request->attributes().request().http().host(),
+                  request->attributes().request().http().path());
+  }
 
+  // Only the callback request needs to call out to the IdP, so leave it to
+  // ProcessDeferred, without having touched the response.
   if (MatchesCallbackRequest(request->attributes().request().http().host(), path_parts)) {
-    return RetrieveToken(request, response, path_parts[1], ioc, yield);
+    return absl::nullopt;
   }
+
+  // Set standard headers
+  SetStandardResponseHeaders(response);
   return RedirectToIdP(response);
 }
 
+google::rpc::Code OidcFilter::Process(
+    const ::envoy::service::auth::v2::CheckRequest *request,
+    ::envoy::service::auth::v2::CheckResponse *response,
+    const common::utilities::Deadline& deadline,
+    boost::asio::io_context& ioc,
+    boost::asio::yield_context yield) {
+  spdlog::trace("{}", __func__);
+  Deferral deferral;
+  deferral.timeline = common::metrics::Timeline::Current();
+  auto result = TryProcess(request, response, &deferral);
+  if (result.has_value()) {
+    return *result;
+  }
+  return ProcessDeferred(request, response, deferral, deadline, ioc, yield);
+}
+
+google::rpc::Code OidcFilter::ProcessDeferred(
+    const ::envoy::service::auth::v2::CheckRequest *request,
+    ::envoy::service::auth::v2::CheckResponse *response,
+    const Deferral &deferral,
+    const common::utilities::Deadline& deadline,
+    boost::asio::io_context& ioc,
+    boost::asio::yield_context yield) {
+  spdlog::trace("{}", __func__);
+  // TryProcess only defers callback requests, so go straight to exchanging the authorization code.
+  SetStandardResponseHeaders(response);
+  auto path_parts = common::http::http::DecodePath(
+      request->attributes().request().http().path());
+  return RetrieveToken(request, response, path_parts[1], deferral.timeline, deadline, ioc, yield);
+}
+
 bool OidcFilter::MatchesCallbackRequest(const std::string &request_host,
                                         const std::array<std::string, 3> &request_path_parts) {
   auto configured_port = idp_config_.callback().port();
-  auto configured_hostname = idp_config_.callback().hostname();
-  auto configured_scheme = idp_config_.callback().scheme();
-
-  std::stringstream buf;
-  buf << configured_hostname << ':' << std::dec << configured_port;
-
-  std::string configured_callback_host_with_port = buf.str();
+  const auto &configured_hostname = idp_config_.callback().hostname();
+  const auto &configured_scheme = idp_config_.callback().scheme();
 
   bool path_matches = request_path_parts[0] == idp_config_.callback().path();
 
   // TODO this should only assume 443 when the request's scheme is also https and only assume 80 when the request's scheme is also 80
-  bool host_matches = request_host == configured_callback_host_with_port ||
+  bool host_matches = request_host == callback_host_ ||
                       (configured_scheme == "https" && configured_port == 443 && request_host == configured_hostname) ||
                       (configured_scheme == "http" && configured_port == 80 && request_host == configured_hostname);
 
@@ -299,15 +380,27 @@ absl::optional<std::string> OidcFilter::GetTokenFromCookie(const ::google::proto
     ::std::string> &headers, const std::string &cookie_name) {
   auto token_cookie = CookieFromHeaders(headers, cookie_name);
   if (token_cookie.has_value()) {
-    auto token = cryptor_->Decrypt(*token_cookie);
+    // Browsers send the same cookie with every request, so decrypt each one once and serve the rest from the cache.
+    auto token = session_cache_->Get(*token_cookie, [this, &token_cookie](absl::Time &expiry) {
+      auto decrypted = cryptor_->Decrypt(*token_cookie);
+      if (decrypted.has_value()) {
+        google::jwt_verify::Jwt jwt;
+        if (jwt.parseFromString(*decrypted) == google::jwt_verify::Status::Ok && jwt.exp_ > 0) {
+          expiry = std::min(expiry, absl::FromUnixSeconds(jwt.exp_));
+        }
+      }
+      return decrypted;
+    });
     if (!token.has_value()) {
+      cookie_decrypt_failures_.Increment();
       spdlog::info("{}: {} token cookie decryption failed", __func__, cookie_name);
       return absl::nullopt;
     } else {
       return token.value();
     }
   } else {
-    spdlog::info("{}: {} token cookie missing", __func__, cookie_name);
+    // Expected for every request before the user has logged in, so not worth logging at info level.
+    spdlog::debug("{}: {} token cookie missing", __func__, cookie_name);
     return absl::nullopt;
   }
 }
@@ -329,6 +422,8 @@ google::rpc::Code OidcFilter::RetrieveToken(
     const ::envoy::service::auth::v2::CheckRequest *request,
     ::envoy::service::auth::v2::CheckResponse *response,
     absl::string_view query,
+    common::metrics::Timeline *timeline,
+    const common::utilities::Deadline& deadline,
     boost::asio::io_context& ioc,
     boost::asio::yield_context yield) {
   spdlog::trace("{}", __func__);
@@ -388,43 +483,58 @@ google::rpc::Code OidcFilter::RetrieveToken(
   }
 
   // Build headers
-  auto authorization = common::http::http::EncodeBasicAuth(
-      idp_config_.client_id(), idp_config_.client_secret());
   std::map<absl::string_view, absl::string_view> headers = {
       {common::http::headers::ContentType,
        common::http::headers::ContentTypeDirectives::FormUrlEncoded},
-      {common::http::headers::Authorization, authorization},
+      {common::http::headers::Authorization, basic_auth_},
   };
 
   // Build body
-  auto redirect_uri = common::http::http::ToUrl(idp_config_.callback());
   std::multimap<absl::string_view, absl::string_view> params = {
       {"code", code->second},
-      {"redirect_uri", redirect_uri},
+      {"redirect_uri", callback_url_},
       {"grant_type", "authorization_code"},
   };
 
+  if (timeline != nullptr) {
+    timeline->Record(common::metrics::Stage::token_requested);
+  }
+  auto start = std::chrono::steady_clock::now();
   auto retrieve_token_response = http_ptr_->Post(
-      idp_config_.token(), headers, common::http::http::EncodeFormData(params), ioc, yield);
+      idp_config_.token(), headers, common::http::http::EncodeFormData(params), deadline, ioc, yield);
+  token_request_duration_.Observe(std::chrono::steady_clock::now() - start);
+  if (timeline != nullptr) {
+    timeline->Record(common::metrics::Stage::token_received);
+  }
+  // The caller has given up, so don't spend any more time on the tokens.
+  if (deadline.Expired()) {
+    spdlog::info("{}: abandoning token retrieval: {}", __func__,
+                 deadline.Cancelled() ? "call cancelled" : "deadline exceeded");
+    token_exchange_failures_.Increment();
+    return deadline.Cancelled() ? google::rpc::Code::CANCELLED : google::rpc::Code::DEADLINE_EXCEEDED;
+  }
   if (retrieve_token_response == nullptr) {
     spdlog::info("{}: HTTP error encountered: {}", __func__,
                  "IdP connection error");
     ::grpc::Status error(::grpc::StatusCode::INTERNAL, "IdP connection error");
+    token_exchange_failures_.Increment();
     return google::rpc::Code::INTERNAL;
   }
   if (retrieve_token_response->result() != boost::beast::http::status::ok) {
     spdlog::info("{}: HTTP token response error: {}", __func__,
                  retrieve_token_response->result_int());
     ::grpc::Status error(::grpc::StatusCode::UNKNOWN, "IdP connection error");
+    token_exchange_failures_.Increment();
     return google::rpc::Code::UNKNOWN;
   } else {
     auto token = parser_->Parse(idp_config_.client_id(),
         std::string(state_and_nonce->second.data(), state_and_nonce->second.size()),
-        retrieve_token_response->body());
+        retrieve_token_response->body(), deadline, ioc, yield);
     if (!token.has_value()) {
       spdlog::info("{}: Invalid token response", __func__);
       ::grpc::Status error(::grpc::StatusCode::INVALID_ARGUMENT,
                            "Invalid token response");
+      token_exchange_failures_.Increment();
       return google::rpc::Code::INVALID_ARGUMENT;
     }
     auto expiry = token->Expiry();
@@ -438,12 +548,14 @@ google::rpc::Code OidcFilter::RetrieveToken(
         spdlog::info("{}: Missing expected access_token", __func__);
         ::grpc::Status error(::grpc::StatusCode::INVALID_ARGUMENT,
                              "Missing expected access_token");
+        token_exchange_failures_.Increment();
         return google::rpc::Code::INVALID_ARGUMENT;
       }
       SetEncryptedCookie(responseHeaders, GetAccessTokenCookieName(), access_token.value(), timeout);
     }
     SetRedirectHeaders(idp_config_.landing_page(), response);
     SetEncryptedCookie(responseHeaders, GetIdTokenCookieName(), token->IDToken().jwt_, timeout);
+    token_exchanges_.Increment();
     return google::rpc::Code::UNAUTHENTICATED;
   }
 }
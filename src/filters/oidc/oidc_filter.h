@@ -3,6 +3,8 @@
 #include "config/oidc/config.pb.h"
 #include "google/rpc/code.pb.h"
 #include "src/common/http/http.h"
+#include "src/common/metrics/metrics.h"
+#include "src/common/session/session_cache.h"
 #include "src/common/session/token_encryptor.h"
 #include "src/filters/filter.h"
 #include "src/filters/oidc/token_response.h"
@@ -24,6 +26,24 @@ class OidcFilter final : public filters::Filter {
   const authservice::config::oidc::OIDCConfig idp_config_;
   TokenResponseParserPtr parser_;
   common::session::TokenEncryptorPtr cryptor_;
+  common::session::SessionCachePtr session_cache_;
+
+  // Values derived from idp_config_ once at construction rather than per request.
+  const std::string state_cookie_name_;
+  const std::string id_token_cookie_name_;
+  const std::string access_token_cookie_name_;
+  const std::string authorization_url_;
+  const std::string callback_url_;
+  const std::string callback_host_;
+  const std::string encoded_scopes_;
+  const std::string basic_auth_;
+
+  // Outcomes shared by every OIDC filter, looked up once at construction.
+  common::metrics::Counter &cookie_decrypt_failures_;
+  common::metrics::Counter &redirects_;
+  common::metrics::Counter &token_exchanges_;
+  common::metrics::Counter &token_exchange_failures_;
+  common::metrics::Histogram &token_request_duration_;
 
   /**
    * Set HTTP header helper in a response.
@@ -105,12 +125,16 @@ class OidcFilter final : public filters::Filter {
    * @param request the incoming request
    * @param response the outgoing response
    * @param query the request query string
+   * @param timeline the timeline of the request, or nullptr
+   * @param deadline the deadline of the call
    * @return the call status
    */
   google::rpc::Code RetrieveToken(
       const ::envoy::service::auth::v2::CheckRequest *request,
       ::envoy::service::auth::v2::CheckResponse *response,
       absl::string_view query,
+      common::metrics::Timeline *timeline,
+      const common::utilities::Deadline& deadline,
       boost::asio::io_context& ioc,
       boost::asio::yield_context yield);
 
@@ -159,14 +183,36 @@ class OidcFilter final : public filters::Filter {
   bool MatchesCallbackRequest(const std::string &request_host, const std::array<std::string, 3> &request_path_parts);
 
 public:
+  /**
+   * @param http_ptr the HTTP client to reach the OIDC Provider with.
+   * @param idp_config the configuration of the filter.
+   * @param parser parses and verifies the token responses of the OIDC Provider.
+   * @param cryptor encrypts and decrypts the token cookies.
+   * @param session_metrics the series the session cache counts in as well.
+   */
   OidcFilter(common::http::ptr_t http_ptr,
              const authservice::config::oidc::OIDCConfig &idp_config,
              TokenResponseParserPtr parser,
-             common::session::TokenEncryptorPtr cryptor);
+             common::session::TokenEncryptorPtr cryptor,
+             const common::session::SessionCache::Metrics &session_metrics = common::session::SessionCache::Metrics());
+
+  absl::optional<google::rpc::Code> TryProcess(
+          const ::envoy::service::auth::v2::CheckRequest *request,
+          ::envoy::service::auth::v2::CheckResponse *response,
+          Deferral *deferral) override;
 
   google::rpc::Code Process(
           const ::envoy::service::auth::v2::CheckRequest *request,
           ::envoy::service::auth::v2::CheckResponse *response,
+          const common::utilities::Deadline& deadline,
+          boost::asio::io_context& ioc,
+          boost::asio::yield_context yield) override;
+
+  google::rpc::Code ProcessDeferred(
+          const ::envoy::service::auth::v2::CheckRequest *request,
+          ::envoy::service::auth::v2::CheckResponse *response,
+          const Deferral& deferral,
+          const common::utilities::Deadline& deadline,
           boost::asio::io_context& ioc,
           boost::asio::yield_context yield) override;
 
@@ -176,13 +222,16 @@ public:
   absl::string_view Name() const override;
 
   /** @brief Get state cookie name. */
-  std::string GetStateCookieName() const;
+  const std::string &GetStateCookieName() const;
 
   /** @brief Get id token cookie name. */
-  std::string GetIdTokenCookieName() const;
+  const std::string &GetIdTokenCookieName() const;
 
   /** @brief Get access token cookie name. */
-  std::string GetAccessTokenCookieName() const;
+  const std::string &GetAccessTokenCookieName() const;
+
+  /** @brief Get the cache of decrypted session cookies. */
+  const common::session::SessionCache &GetSessionCache() const;
 
   void DeleteCookie(::google::protobuf::RepeatedPtrField<::envoy::api::v2::core::HeaderValueOption> *responseHeaders,
                     const std::string &cookieName);
@@ -47,12 +47,47 @@ absl::optional<int64_t> TokenResponse::Expiry() const {
   return absl::nullopt;
 }
 
+absl::optional<TokenResponse> TokenResponseParser::Parse(
+    const std::string &client_id, const std::string &nonce, const std::string &raw,
+    const common::utilities::Deadline &, boost::asio::io_context &, boost::asio::yield_context) const {
+  return Parse(client_id, nonce, raw);
+}
+
 TokenResponseParserImpl::TokenResponseParserImpl(
     google::jwt_verify::JwksPtr keys)
+    : keys_(std::make_shared<StaticJwksProvider>(std::move(keys))) {}
+
+TokenResponseParserImpl::TokenResponseParserImpl(JwksProviderPtr keys)
     : keys_(std::move(keys)) {}
 
 absl::optional<TokenResponse> TokenResponseParserImpl::Parse(
     const std::string &client_id, const std::string &nonce, const std::string &raw) const {
+  auto keys = keys_->Keys();
+  bool unknown_key = false;
+  return Parse(client_id, nonce, raw, keys.get(), unknown_key);
+}
+
+absl::optional<TokenResponse> TokenResponseParserImpl::Parse(
+    const std::string &client_id, const std::string &nonce, const std::string &raw,
+    const common::utilities::Deadline &deadline, boost::asio::io_context &ioc,
+    boost::asio::yield_context yield) const {
+  auto keys = keys_->Keys();
+  bool unknown_key = false;
+  auto result = Parse(client_id, nonce, raw, keys.get(), unknown_key);
+  if (!result.has_value() && unknown_key) {
+    // The OIDC Provider may have rotated its keys since we last fetched them.
+    keys_->Refetch(deadline, ioc, yield);
+    auto refetched = keys_->Keys();
+    if (refetched != keys) {
+      result = Parse(client_id, nonce, raw, refetched.get(), unknown_key);
+    }
+  }
+  return result;
+}
+
+absl::optional<TokenResponse> TokenResponseParserImpl::Parse(
+    const std::string &client_id, const std::string &nonce, const std::string &raw,
+    const google::jwt_verify::Jwks *keys, bool &unknown_key) const {
   ::google::protobuf::util::JsonParseOptions options;
   options.ignore_unknown_fields = true;
   options.case_insensitive_enum_parsing = false;
@@ -95,10 +130,16 @@ absl::optional<TokenResponse> TokenResponseParserImpl::Parse(
                  google::jwt_verify::getStatusString(jwt_status));
     return absl::nullopt;
   }
+  if (keys == nullptr) {
+    spdlog::info("{}: no keys to verify `id_token` with", __func__);
+    unknown_key = true;
+    return absl::nullopt;
+  }
   // Verify our client_id is set as an entry in the token's `aud` field.
   std::vector<std::string> audiences = {client_id};
-  jwt_status = google::jwt_verify::verifyJwt(id_token, *keys_, audiences);
+  jwt_status = google::jwt_verify::verifyJwt(id_token, *keys, audiences);
   if (jwt_status != google::jwt_verify::Status::Ok) {
+    unknown_key = jwt_status == google::jwt_verify::Status::JwksKidAlgMismatch;
     spdlog::info("{}: `id_token` verification failed: {}", __func__, google::jwt_verify::getStatusString(jwt_status));
     return absl::nullopt;
   }
@@ -5,6 +5,7 @@
 #include "absl/strings/string_view.h"
 #include "jwt_verify_lib/jwks.h"
 #include "jwt_verify_lib/jwt.h"
+#include "src/filters/oidc/jwks_provider.h"
 
 namespace authservice {
 namespace filters {
@@ -50,6 +51,25 @@ class TokenResponseParser {
   virtual absl::optional<TokenResponse> Parse(const std::string &client_id,
                                               const std::string &nonce,
                                               const std::string &raw) const = 0;
+
+  /**
+   * Parse the given token response inside a Boost co-routine, which lets
+   * parsers wait for keys they do not have yet.
+   * The default implementation calls the synchronous Parse.
+   * @param client_id the expected client_id that should be present in the id_token `aud` field.
+   * @param nonce the expected nonce that should be present in the id_token
+   * @param raw the raw response to be parsed
+   * @param deadline the deadline of the call the response is parsed for
+   * @param ioc the I/O context on which the co-routine is running.
+   * @param yield the yield context of the co-routine.
+   * @return either an empty result indicating an error or a TokenResponse.
+   */
+  virtual absl::optional<TokenResponse> Parse(const std::string &client_id,
+                                              const std::string &nonce,
+                                              const std::string &raw,
+                                              const common::utilities::Deadline &deadline,
+                                              boost::asio::io_context &ioc,
+                                              boost::asio::yield_context yield) const;
 };
 
 /**
@@ -58,13 +78,36 @@ class TokenResponseParser {
  */
 class TokenResponseParserImpl final : public TokenResponseParser {
  private:
-  google::jwt_verify::JwksPtr keys_;
+  JwksProviderPtr keys_;
+
+  /**
+   * Parse the given token response, verifying the id_token with the given keys.
+   * @param unknown_key set when the id_token is signed with a key that is not in the key set.
+   */
+  absl::optional<TokenResponse> Parse(const std::string &client_id,
+                                      const std::string &nonce,
+                                      const std::string &raw,
+                                      const google::jwt_verify::Jwks *keys,
+                                      bool &unknown_key) const;
 
  public:
   TokenResponseParserImpl(google::jwt_verify::JwksPtr keys);
+  TokenResponseParserImpl(JwksProviderPtr keys);
   absl::optional<TokenResponse> Parse(const std::string &client_id,
                                       const std::string &nonce,
                                       const std::string &raw) const override;
+
+  /**
+   * Parses as the synchronous Parse does, except that an id_token signed with
+   * a key that is not in the key set makes it wait for the key set to be
+   * fetched again, then verify the id_token once more.
+   */
+  absl::optional<TokenResponse> Parse(const std::string &client_id,
+                                      const std::string &nonce,
+                                      const std::string &raw,
+                                      const common::utilities::Deadline &deadline,
+                                      boost::asio::io_context &ioc,
+                                      boost::asio::yield_context yield) const override;
 };
 
 }  // namespace oidc
@@ -1,4 +1,5 @@
 #include "pipe.h"
+#include <algorithm>
 #include "google/rpc/code.pb.h"
 #include "grpcpp/support/status.h"
 
@@ -6,42 +7,109 @@ namespace authservice {
 namespace filters {
 namespace {
 const char *filter_name_ = "pipe";
+
+// Record the outcome of the pipe in the response status.
+google::rpc::Code SetStatus(::envoy::service::auth::v2::CheckResponse *response,
+                            google::rpc::Code code, absl::string_view message) {
+  response->mutable_status()->set_code(code);
+  response->mutable_status()->set_message(message.data(), message.size());
+  return code;
+}
 }  // namespace
 
+Pipe::Pipe() : filters_(std::make_shared<const FilterList>()) {}
+
 Pipe *Pipe::AddFilter(FilterPtr &&filter) {
   std::unique_lock<std::mutex> lock(mtx);
-  filters_.push_back(std::move(filter));
+  auto updated = std::make_shared<FilterList>(*std::atomic_load(&filters_));
+  updated->push_back(std::shared_ptr<Filter>(std::move(filter)));
+  std::atomic_store(&filters_, std::shared_ptr<const FilterList>(std::move(updated)));
   return this;
 }
 
 Pipe *Pipe::Remove(const std::string &filter) {
   std::unique_lock<std::mutex> lock(mtx);
-  for (auto f = filters_.begin(); f != filters_.end(); ++f) {
-    if ((*f)->Name() == filter) {
-      filters_.erase(f);
+  auto updated = std::make_shared<FilterList>(*std::atomic_load(&filters_));
+  updated->erase(std::remove_if(updated->begin(), updated->end(),
+                                [&filter](const std::shared_ptr<Filter> &f) {
+                                  return f->Name() == filter;
+                                }),
+                 updated->end());
+  std::atomic_store(&filters_, std::shared_ptr<const FilterList>(std::move(updated)));
+  return this;
+}
+
+absl::optional<google::rpc::Code> Pipe::TryProcess(
+        const ::envoy::service::auth::v2::CheckRequest *request,
+        ::envoy::service::auth::v2::CheckResponse *response,
+        Deferral *deferral) {
+  auto filters = std::atomic_load(&filters_);
+  for (size_t i = 0; i < filters->size(); ++i) {
+    auto &filter = (*filters)[i];
+    auto result = filter->TryProcess(request, response, deferral);
+    if (!result.has_value()) {
+      // What earlier filters added stays in the response, and ProcessDeferred picks up at this filter.
+      deferral->filter = i;
+      deferral->filters = std::move(filters);
+      return absl::nullopt;
+    }
+    if (*result != google::rpc::Code::OK) {
+      return SetStatus(response, *result, filter->Name());
     }
   }
-  return this;
+  return SetStatus(response, google::rpc::Code::OK, "OK");
 }
 
 google::rpc::Code Pipe::Process(
         const ::envoy::service::auth::v2::CheckRequest *request,
         ::envoy::service::auth::v2::CheckResponse *response,
+        const common::utilities::Deadline& deadline,
         boost::asio::io_context& ioc,
         boost::asio::yield_context yield) {
-  std::unique_lock<std::mutex> lock(mtx);
-  for (auto &filter : filters_) {
-    auto result = filter->Process(request, response, ioc, yield);
+  // Hold a reference to the current snapshot for the duration of the request so
+  // concurrent AddFilter/Remove calls cannot free filters we are running.
+  auto filters = std::atomic_load(&filters_);
+  return Run(request, response, *filters, 0, nullptr, deadline, ioc, yield);
+}
+
+google::rpc::Code Pipe::ProcessDeferred(
+        const ::envoy::service::auth::v2::CheckRequest *request,
+        ::envoy::service::auth::v2::CheckResponse *response,
+        const Deferral& deferral,
+        const common::utilities::Deadline& deadline,
+        boost::asio::io_context& ioc,
+        boost::asio::yield_context yield) {
+  if (deferral.filters == nullptr) {
+    return Process(request, response, deadline, ioc, yield);
+  }
+  // The deferral holds the snapshot TryProcess ran, so the positions still line up.
+  return Run(request, response, *deferral.filters, deferral.filter, &deferral, deadline, ioc, yield);
+}
+
+google::rpc::Code Pipe::Run(
+        const ::envoy::service::auth::v2::CheckRequest *request,
+        ::envoy::service::auth::v2::CheckResponse *response,
+        const FilterList &filters,
+        size_t first,
+        const Deferral *deferral,
+        const common::utilities::Deadline& deadline,
+        boost::asio::io_context& ioc,
+        boost::asio::yield_context yield) {
+  for (size_t i = first; i < filters.size(); ++i) {
+    auto &filter = filters[i];
+    // Don't start more work for a caller that has given up.
+    if (deadline.Expired()) {
+      auto result = deadline.Cancelled() ? google::rpc::Code::CANCELLED : google::rpc::Code::DEADLINE_EXCEEDED;
+      return SetStatus(response, result, filter->Name());
+    }
+    auto result = deferral != nullptr && i == first
+                      ? filter->ProcessDeferred(request, response, *deferral, deadline, ioc, yield)
+                      : filter->Process(request, response, deadline, ioc, yield);
     if (result != google::rpc::Code::OK) {
-      response->mutable_status()->set_code(result);
-      response->mutable_status()->set_message(filter->Name().data(),
-                                              filter->Name().size());
-      return result;
+      return SetStatus(response, result, filter->Name());
     }
   }
-  response->mutable_status()->set_code(google::rpc::Code::OK);
-  response->mutable_status()->set_message("OK");
-  return google::rpc::Code::OK;
+  return SetStatus(response, google::rpc::Code::OK, "OK");
 }
 
 absl::string_view Pipe::Name() const { return filter_name_; }
@@ -13,19 +13,60 @@ namespace filters {
 
 typedef std::unique_ptr<Filter> FilterPtr;
 
+/**
+ * Pipe runs a sequence of filters until one of them returns a non-OK status.
+ *
+ * The filter list is an immutable snapshot. Process loads the current snapshot
+ * without taking a lock, so requests never wait on each other even when a
+ * filter yields. AddFilter and Remove copy the list, modify the copy and
+ * publish it atomically; requests already in flight finish on the snapshot
+ * they started with.
+ */
 class Pipe final : public Filter {
  private:
-  typedef std::vector<FilterPtr> FilterList;
+  typedef std::vector<std::shared_ptr<Filter>> FilterList;
+  // Serializes writers only. Never taken by Process.
   std::mutex mtx;
-  FilterList filters_;
+  // Accessed only through std::atomic_load and std::atomic_store.
+  std::shared_ptr<const FilterList> filters_;
+
+  /**
+   * Run the filters of a snapshot from the given position on, finishing the
+   * first with ProcessDeferred when a deferral is given.
+   */
+  google::rpc::Code Run(
+          const ::envoy::service::auth::v2::CheckRequest *request,
+          ::envoy::service::auth::v2::CheckResponse *response,
+          const FilterList &filters,
+          size_t first,
+          const Deferral *deferral,
+          const common::utilities::Deadline& deadline,
+          boost::asio::io_context& ioc,
+          boost::asio::yield_context yield);
 
  public:
+  Pipe();
+
   Pipe *AddFilter(FilterPtr &&filter);
   Pipe *Remove(const std::string &filter);
 
+  absl::optional<google::rpc::Code> TryProcess(
+          const ::envoy::service::auth::v2::CheckRequest *request,
+          ::envoy::service::auth::v2::CheckResponse *response,
+          Deferral *deferral) override;
+
   google::rpc::Code Process(
           const ::envoy::service::auth::v2::CheckRequest *request,
           ::envoy::service::auth::v2::CheckResponse *response,
+          const common::utilities::Deadline& deadline,
+          boost::asio::io_context& ioc,
+          boost::asio::yield_context yield) override;
+
+  google::rpc::Code ProcessDeferred(
+          const ::envoy::service::auth::v2::CheckRequest *request,
+          ::envoy::service::auth::v2::CheckResponse *response,
+          const Deferral& deferral,
+          const common::utilities::Deadline& deadline,
           boost::asio::io_context& ioc,
           boost::asio::yield_context yield) override;
 
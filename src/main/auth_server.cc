@@ -3,16 +3,92 @@
 #include "absl/flags/usage.h"
 #include "absl/strings/str_cat.h"
 #include "envoy/service/auth/v2/external_auth.pb.validate.h"
+#include "spdlog/async.h"
 #include "spdlog/sinks/stdout_sinks.h"
 #include "spdlog/spdlog.h"
+#include "src/common/metrics/metrics_server.h"
+#include "src/config/config_watcher.h"
 #include "src/config/get_config.h"
 #include "src/service/async_service_impl.h"
 
 namespace authservice {
 namespace service {
+namespace {
+// How often the background logging thread flushes standard output.
+const std::chrono::seconds log_flush_interval(1);
 
-void RunServer(const authservice::config::Config& config) {
+// Replace the default logger with one that formats and writes messages on a
+// background thread, so logging from request processing only queues them.
+void UseAsyncLogger(const authservice::config::Config& config) {
+  spdlog::init_thread_pool(authservice::config::GetConfiguredLogQueueSize(config), 1);
+  auto logger = std::make_shared<spdlog::async_logger>(
+      "async_console", std::make_shared<spdlog::sinks::stdout_sink_mt>(),
+      spdlog::thread_pool(),
+      authservice::config::GetConfiguredLogOverflowPolicy(config));
+  logger->set_level(authservice::config::GetConfiguredLogLevel(config));
+  // Errors are flushed as soon as they are written, everything else
+  // periodically.
+  logger->flush_on(spdlog::level::err);
+  spdlog::set_default_logger(logger);
+  spdlog::flush_every(log_flush_interval);
+}
+
+// Export the statistics of the server and of configuration reloads.
+std::vector<common::metrics::CallbackHandle> ExportStats(
+    const AsyncAuthServiceImpl& service,
+    const authservice::config::ConfigWatcher& watcher) {
+  using common::metrics::Registry;
+  auto& registry = Registry::Default();
+  std::vector<common::metrics::CallbackHandle> handles;
+  const char* abandoned_help =
+      "Calls whose caller gave up before a response was sent, by reason.";
+  handles.push_back(registry.AddCallback(
+      Registry::Type::counter, "authservice_abandoned_calls_total",
+      abandoned_help, {{"reason", "deadline_exceeded"}},
+      [&service]() { return service.GetStats().deadline_exceeded; }));
+  handles.push_back(registry.AddCallback(
+      Registry::Type::counter, "authservice_abandoned_calls_total",
+      abandoned_help, {{"reason", "cancelled"}},
+      [&service]() { return service.GetStats().cancelled; }));
+
+  const char* reloads_help =
+      "Changes to the configuration file applied without a restart, by "
+      "result.";
+  handles.push_back(registry.AddCallback(
+      Registry::Type::counter, "authservice_config_reloads_total",
+      reloads_help, {{"result", "success"}},
+      [&watcher]() { return watcher.GetStats().reloads; }));
+  handles.push_back(registry.AddCallback(
+      Registry::Type::counter, "authservice_config_reloads_total",
+      reloads_help, {{"result", "failure"}},
+      [&watcher]() { return watcher.GetStats().failures; }));
+  handles.push_back(registry.AddCallback(
+      Registry::Type::counter, "authservice_config_reload_seconds_total",
+      "The time spent reloading the configuration file.", {},
+      [&watcher]() {
+        return watcher.GetStats().reload_microseconds / 1e6;
+      }));
+  return handles;
+}
+}  // namespace
+
+void RunServer(const authservice::config::Config& config,
+               const std::string& config_path) {
   AsyncAuthServiceImpl service(config);
+  // Apply changes to the configuration file without a restart.
+  authservice::config::ConfigWatcher watcher(
+      config_path, [&service](const authservice::config::Config& config) {
+        service.Reload(config);
+        spdlog::default_logger()->set_level(
+            authservice::config::GetConfiguredLogLevel(config));
+      });
+  auto stats = ExportStats(service, watcher);
+  std::unique_ptr<common::metrics::MetricsServer> metrics;
+  if (config.has_metrics()) {
+    metrics.reset(new common::metrics::MetricsServer(
+        config.metrics().listen_address(), config.metrics().listen_port(),
+        common::metrics::Registry::Default()));
+  }
   service.Run();
 }
 
@@ -30,14 +106,16 @@ int main(int argc, char** argv) {
   spdlog::set_default_logger(console);
 
   try {
-    auto config =
-        authservice::config::GetConfig(absl::GetFlag(FLAGS_filter_config));
-    console->set_level(
-        authservice::config::GetConfiguredLogLevel(*config));
-    authservice::service::RunServer(*config);
+    auto config_path = absl::GetFlag(FLAGS_filter_config);
+    auto config = authservice::config::GetConfig(config_path);
+    authservice::service::UseAsyncLogger(*config);
+    authservice::service::RunServer(*config, config_path);
   } catch (const std::exception& e) {
     spdlog::error("{}: Unexpected error: {}", __func__, e.what());
+    spdlog::shutdown();
     return EXIT_FAILURE;
   }
+  // Write out any queued messages.
+  spdlog::shutdown();
   return EXIT_SUCCESS;
 }
@@ -1,5 +1,8 @@
 #include "async_service_impl.h"
+#include "src/common/utilities/arena.h"
 #include "src/config/get_config.h"
+#include "spdlog/async.h"
+#include "spdlog/sinks/basic_file_sink.h"
 #include <boost/asio.hpp>
 #include <boost/thread/thread.hpp>
 #include <grpcpp/grpcpp.h>
@@ -12,151 +15,433 @@ class ServiceState {
 public:
   virtual ~ServiceState() = default;
 
-  virtual void Proceed() = 0;
+  /**
+   * Handle the completion queue event for this tag.
+   * @param ok whether the operation the tag was given to succeeded.
+   */
+  virtual void Proceed(bool ok) = 0;
 };
 
+// The size of the memory block each call state hands its arena up front. Large enough for a typical request with a
+// few dozen headers and its response, so most calls never make the arena fall back to the heap.
+const size_t arena_initial_block_size = 16 * 1024;
+
 class ProcessingState;
 
+/**
+ * A free list of call states for one completion queue. States are acquired and released only by the thread polling
+ * that queue, so no locking is needed. The pool grows to the peak number of concurrent calls on its queue and the
+ * states are reused from then on.
+ */
+class ProcessingStatePool {
+public:
+  ProcessingStatePool(authservice::service::AuthServiceImpl &impl, Authorization::AsyncService &service,
+                      grpc::ServerCompletionQueue &cq, CoroutinePool &coroutines, AbandonedCalls &abandoned,
+                      common::metrics::TimelineRecorder &timelines)
+          : impl_(impl), service_(service), cq_(cq), coroutines_(coroutines), abandoned_(abandoned),
+            timelines_(timelines) {
+  }
+
+  /**
+   * Take an idle call state, creating one if there is none, and use it to request the next call.
+   */
+  void RequestCall();
+
+  /**
+   * Return a completed call state to the pool.
+   * @param state the call state.
+   */
+  void Release(ProcessingState *state);
+
+private:
+  authservice::service::AuthServiceImpl &impl_;
+  Authorization::AsyncService &service_;
+  grpc::ServerCompletionQueue &cq_;
+  CoroutinePool &coroutines_;
+  AbandonedCalls &abandoned_;
+  common::metrics::TimelineRecorder &timelines_;
+
+  std::vector<std::unique_ptr<ProcessingState>> states_;
+  std::vector<ProcessingState *> idle_;
+};
+
 class CompleteState : public ServiceState {
 public:
   explicit CompleteState(ProcessingState *processor) : processor_(processor) {
   }
 
-  void Proceed() override;
+  void Proceed(bool ok) override;
 
 private:
   ProcessingState *processor_;
 };
 
+class DoneState : public ServiceState {
+public:
+  explicit DoneState(ProcessingState *processor) : processor_(processor) {
+  }
+
+  void Proceed(bool ok) override;
+
+private:
+  ProcessingState *processor_;
+};
+
+namespace {
+// Convert the deadline gRPC reports for a call, which is infinite when the client did not set one.
+common::utilities::Deadline::Clock::time_point ToDeadline(std::chrono::system_clock::time_point deadline) {
+  if (deadline == std::chrono::system_clock::time_point::max()) {
+    return common::utilities::Deadline::Clock::time_point::max();
+  }
+  auto remaining = deadline - std::chrono::system_clock::now();
+  return common::utilities::Deadline::Clock::now() +
+         std::chrono::duration_cast<common::utilities::Deadline::Clock::duration>(remaining);
+}
+
+// Where to write sampled call timelines, or nullptr if they are not wanted. Written on the background logging thread
+// when there is one, dropping the oldest waiting timelines rather than delaying calls when it falls behind.
+std::shared_ptr<spdlog::logger> TimelineSink(const authservice::config::Config &config) {
+  if (config.metrics().timelines_path().empty()) {
+    return nullptr;
+  }
+  auto file = std::make_shared<spdlog::sinks::basic_file_sink_mt>(config.metrics().timelines_path());
+  std::shared_ptr<spdlog::logger> sink;
+  if (spdlog::thread_pool() != nullptr) {
+    sink = std::make_shared<spdlog::async_logger>("timelines", file, spdlog::thread_pool(),
+                                                  spdlog::async_overflow_policy::overrun_oldest);
+  } else {
+    sink = std::make_shared<spdlog::logger>("timelines", file);
+  }
+  sink->set_pattern("%v");
+  sink->set_level(spdlog::level::info);
+  return sink;
+}
+}  // namespace
+
 class ProcessingState : public ServiceState {
 public:
-  ProcessingState(authservice::service::AuthServiceImpl& impl, Authorization::AsyncService &service,
-                  grpc::ServerCompletionQueue &cq, boost::asio::io_context &io_context)
-          : service_(service), cq_(cq), responder_(&ctx_), io_context_(io_context), impl_(impl) {
+  ProcessingState(authservice::service::AuthServiceImpl &impl, Authorization::AsyncService &service,
+                  grpc::ServerCompletionQueue &cq, CoroutinePool &coroutines, ProcessingStatePool &pool,
+                  AbandonedCalls &abandoned, common::metrics::TimelineRecorder &timelines)
+          : service_(service), cq_(cq), arena_block_(new char[arena_initial_block_size]),
+            arena_(ArenaOptions(arena_block_.get())), request_(nullptr), response_(nullptr), complete_(this),
+            done_(this), outstanding_(0), coroutines_(coroutines), pool_(pool), abandoned_(abandoned),
+            timelines_(timelines), impl_(impl) {
     spdlog::trace("Creating processor state");
-    service.RequestCheck(&ctx_, &request_, &responder_, &cq_, &cq_, this);
   }
 
-  void Proceed() override {
-    // Spawn a new instance to serve new clients while we process this one
-    // This will later be pulled off the queue for processing and ultimately deleted in the destructor
-    // of CompleteState
-    new ProcessingState(impl_, service_, cq_, io_context_);
+  /**
+   * Request the next call with this state, resetting whatever the previous call left behind.
+   */
+  void Start() {
+    // Neither the server context nor the responder can be reset, so they are rebuilt in place.
+    ctx_.emplace();
+    // Must be registered before the call starts. Signalled once the call is over, which is how we learn that the
+    // caller has cancelled it.
+    ctx_->AsyncNotifyWhenDone(&done_);
+    responder_.emplace(&*ctx_);
+    request_ = common::utilities::CreateOnArena<CheckRequest>(&arena_);
+    response_ = common::utilities::CreateOnArena<CheckResponse>(&arena_);
+    service_.RequestCheck(&*ctx_, request_, &*responder_, &cq_, &cq_, this);
+  }
+
+  /**
+   * Record that the response has been sent, or has failed to send.
+   */
+  void Finished() {
+    timeline_.Record(common::metrics::Stage::sent);
+    timelines_.Record(timeline_);
+    Completed();
+  }
+
+  /**
+   * Record that the call is over, and stop working on it if it was cancelled.
+   */
+  void Done() {
+    if (!deadline_.has_value()) {
+      // The call never started because the server is shutting down.
+      return;
+    }
+    if (ctx_->IsCancelled()) {
+      if (deadline_->Expired()) {
+        ++abandoned_.deadline_exceeded;
+      } else {
+        ++abandoned_.cancelled;
+      }
+      // Let the filters abandon whatever they are still doing for this call.
+      deadline_->Cancel();
+    }
+    Completed();
+  }
+
+  void Proceed(bool ok) override {
+    if (!ok) {
+      // The server is shutting down and this call was never started.
+      return;
+    }
+
+    timeline_.Reset();
+    timeline_.Record(common::metrics::Stage::received);
+
+    // Both the response and the done notification must arrive before this state can be reused.
+    outstanding_ = 2;
+    deadline_.emplace(ToDeadline(ctx_->deadline()));
+
+    // Start serving the next client while we process this one.
+    pool_.RequestCall();
+
+    // Most requests, such as those carrying a valid session cookie, can be decided without any I/O. Finish those
+    // directly on this completion queue thread rather than paying for a co-routine and a hop onto the io_context.
+    common::metrics::Timeline::SetCurrent(&timeline_);
+    auto decided = impl_.TryCheck(&*ctx_, request_, response_, &deferred_.emplace()).has_value();
+    common::metrics::Timeline::SetCurrent(nullptr);
+    if (decided) {
+      spdlog::trace("Request processing complete without I/O");
+      timeline_.Record(common::metrics::Stage::completed);
+      // The decision is carried in the response, so the call always succeeds. Failing it instead would let an Envoy
+      // configured to allow requests when the service fails through a request the filters denied.
+      responder_->Finish(*response_, grpc::Status::OK, &complete_);
+      return;
+    }
 
     spdlog::trace("Launching request processor worker");
+    timeline_.Record(common::metrics::Stage::deferred);
 
     // The actual processing
-    boost::asio::spawn(io_context_, [this](boost::asio::yield_context yield) {
+    coroutines_.Post([this](boost::asio::yield_context yield) {
       spdlog::trace("Processing request");
+      timeline_.Record(common::metrics::Stage::spawned);
 
-      CheckResponse response;
-      this->impl_.Check(&ctx_, &request_, &response);
-
-      this->responder_.Finish(response, grpc::Status::OK, new CompleteState(this));
+      // The timeline travels in the deferral rather than being made current, which would leave it current on
+      // this thread for other checks once the filters yield.
+      this->impl_.Check(&*ctx_, request_, response_, *deferred_, *deadline_, coroutines_.Context(), yield);
 
+      // This state may be reused as soon as Finish is called, so it must not be touched afterwards.
       spdlog::trace("Request processing complete");
+      timeline_.Record(common::metrics::Stage::completed);
+      this->responder_->Finish(*response_, grpc::Status::OK, &complete_);
     });
   }
 
 private:
+  /**
+   * Return this state to its pool once both the response and the done notification have arrived. Both arrive on
+   * the completion queue thread that owns this state, so no locking is needed.
+   */
+  void Completed() {
+    if (--outstanding_ > 0) {
+      return;
+    }
+    deadline_.reset();
+    // Lets go of the filter chains the call ran with, which a reload may have replaced meanwhile.
+    deferred_.reset();
+    responder_.reset();
+    ctx_.reset();
+    // Free the request and response in bulk, keeping the initial block for the next call.
+    request_ = nullptr;
+    response_ = nullptr;
+    arena_.Reset();
+    pool_.Release(this);
+  }
+
+  static google::protobuf::ArenaOptions ArenaOptions(char *initial_block) {
+    google::protobuf::ArenaOptions options;
+    options.initial_block = initial_block;
+    options.initial_block_size = arena_initial_block_size;
+    return options;
+  }
+
   // GRPC service/queue/context
   Authorization::AsyncService &service_;
   grpc::ServerCompletionQueue &cq_;
-  grpc::ServerContext ctx_;
+  absl::optional<grpc::ServerContext> ctx_;
 
+  // Backs the request, the response and their sub-messages, and is reset once the call completes
+  std::unique_ptr<char[]> arena_block_;
+  google::protobuf::Arena arena_;
   // The GRPC request we've received
-  CheckRequest request_;
+  CheckRequest *request_;
+  // The response to the request
+  CheckResponse *response_;
   // Used to send the GRPC response
-  grpc::ServerAsyncResponseWriter<CheckResponse> responder_;
-
-  // Boost::ASIO I/O service
-  boost::asio::io_context &io_context_;
+  absl::optional<grpc::ServerAsyncResponseWriter<CheckResponse>> responder_;
+  // The tag signalled once the response has been sent
+  CompleteState complete_;
+  // The tag signalled once the call is over, whether or not it was cancelled
+  DoneState done_;
+  // The number of tags above still to be signalled for the current call
+  int outstanding_;
+  // The deadline of the current call, cancelled if its caller gives up
+  absl::optional<common::utilities::Deadline> deadline_;
+  // How far TryCheck got with the current call before deferring it to Check
+  absl::optional<authservice::service::AuthServiceImpl::Deferred> deferred_;
+
+  // Co-routines used to process requests that need I/O
+  CoroutinePool &coroutines_;
+  // The pool this state returns to when the call completes
+  ProcessingStatePool &pool_;
+  // Counts the calls whose callers gave up
+  AbandonedCalls &abandoned_;
+  // The stages the current call has passed through
+  common::metrics::Timeline timeline_;
+  // Records the timeline of each call once its response is sent
+  common::metrics::TimelineRecorder &timelines_;
 
   authservice::service::AuthServiceImpl& impl_;
 };
 
-void CompleteState::Proceed() {
-  spdlog::trace("Processing completion and deleting state");
+void ProcessingStatePool::RequestCall() {
+  if (idle_.empty()) {
+    states_.emplace_back(new ProcessingState(impl_, service_, cq_, coroutines_, *this, abandoned_, timelines_));
+    idle_.push_back(states_.back().get());
+  }
+  auto state = idle_.back();
+  idle_.pop_back();
+  state->Start();
+}
+
+void ProcessingStatePool::Release(ProcessingState *state) {
+  idle_.push_back(state);
+}
+
+void CompleteState::Proceed(bool) {
+  spdlog::trace("Processing completion");
+
+  processor_->Finished();
+}
+
+void DoneState::Proceed(bool) {
+  spdlog::trace("Processing end of call");
 
-  delete processor_;
-  delete this;
+  processor_->Done();
 }
 
 AsyncAuthServiceImpl::AsyncAuthServiceImpl(authservice::config::Config config)
         : config_(std::move(config)), impl_(config_),
-          io_context_(std::make_shared<boost::asio::io_context>()) {
+          timelines_(common::metrics::Registry::Default(), config::GetConfiguredTimelineSampleRate(config_),
+                     TimelineSink(config_)),
+          io_context_(std::make_shared<boost::asio::io_context>()),
+          coroutines_(*io_context_, config_.coroutine_stack_size()) {
   grpc::ServerBuilder builder;
   builder.AddListeningPort(config::GetConfiguredAddress(config_), grpc::InsecureServerCredentials());
   builder.RegisterService(&service_);
-  cq_ = builder.AddCompletionQueue();
+  auto completion_queues = config::GetConfiguredCompletionQueues(config_);
+  for (unsigned int i = 0; i < completion_queues; ++i) {
+    cqs_.push_back(builder.AddCompletionQueue());
+    pools_.emplace_back(new ProcessingStatePool(impl_, service_, *cqs_.back(), coroutines_, abandoned_, timelines_));
+  }
   server_ = builder.BuildAndStart();
 }
 
-void AsyncAuthServiceImpl::Run() {
-  // Add a work object to the IO service so it will not shut down when it has nothing left to do
-  auto work = std::make_shared<boost::asio::io_context::work>(*io_context_);
-
-  // Spin up our worker threads
-  // Config validation should have already ensured that the number of threads is > 0
-  boost::thread_group threadpool;
-  for (unsigned int i = 0; i < config_.threads(); ++i) {
-    threadpool.create_thread([this](){
-      while(true) {
-        try {
-          this->io_context_->run();
-          break;
-        } catch(std::exception & e) {
-          spdlog::error("Unexpected error in worker thread: {}", e.what());
-        }
-      }
-    });
-  }
-
-  spdlog::info("{}: Server listening on {}", __func__, config::GetConfiguredAddress(config_));
+AsyncAuthServiceImpl::~AsyncAuthServiceImpl() = default;
 
+void AsyncAuthServiceImpl::Poll(grpc::ServerCompletionQueue &cq, ProcessingStatePool &states) {
+  auto pending_requests = config::GetConfiguredPendingRequests(config_);
   try {
-    // Spawn a new state instance to serve new clients
-    // This will later be pulled off the queue for processing and ultimately deleted in the destructor
-    // of CompleteState
-    new ProcessingState(impl_, service_, *cq_, *io_context_);
+    // Keep several calls posted so a burst of requests does not wait on this thread to post the next one. Each
+    // arriving call posts its replacement. Every call state is owned by the pool and reused once its call completes.
+    for (unsigned int i = 0; i < pending_requests; ++i) {
+      states.RequestCall();
+    }
 
     void *tag;
     bool ok;
-    while (cq_->Next(&tag, &ok)) {
+    while (cq.Next(&tag, &ok)) {
       // Block waiting to read the next event from the completion queue. The
       // event is uniquely identified by its tag, which in this case is the
       // memory address of a CallData instance.
       // The return value of Next should always be checked. This return value
-      // tells us whether there is any kind of event or cq_ is shutting down.
-      if(!ok) {
-        spdlog::error("{}: Unexpected error: !ok", __func__);
-        break;
-      }
-
-      static_cast<ServiceState *>(tag)->Proceed();
+      // tells us whether there is any kind of event or cq is shutting down.
+      // An event that is not ok, such as the response to a cancelled call failing to send, is left to its tag.
+      static_cast<ServiceState *>(tag)->Proceed(ok);
     }
   } catch (const std::exception &e) {
     spdlog::error("{}: Unexpected error: {}", __func__, e.what());
   }
 
-  spdlog::info("Server shutting down");
-
-  // Start shutting down gRPC
-  server_->Shutdown();
-  cq_->Shutdown();
+  // Stopping any one completion queue stops the whole server, as a single queue did before.
+  Shutdown();
 
   // The destructor of the completion queue will abort if there are any outstanding events, so we
-  // must drain the queue before we allow that to happen
+  // must drain the queue before we allow that to happen. The call states are kept, as co-routines may still be
+  // working on some of them, and are freed with the service.
   try {
     void *tag;
     bool ok;
-    while (cq_->Next(&tag, &ok)) {
-      delete static_cast<ServiceState *>(tag);
+    while (cq.Next(&tag, &ok)) {
     }
   } catch (const std::exception &e) {
     spdlog::error("{}: Unexpected error: {}", __func__, e.what());
   }
+}
+
+void AsyncAuthServiceImpl::Reload(const authservice::config::Config &config) {
+  if (config::GetConfiguredAddress(config) != config::GetConfiguredAddress(config_) ||
+      config.threads() != config_.threads() ||
+      config::GetConfiguredCompletionQueues(config) != config::GetConfiguredCompletionQueues(config_) ||
+      config::GetConfiguredPendingRequests(config) != config::GetConfiguredPendingRequests(config_) ||
+      config.coroutine_stack_size() != config_.coroutine_stack_size() ||
+      config.metrics().SerializeAsString() != config_.metrics().SerializeAsString() ||
+      config::GetConfiguredLogQueueSize(config) != config::GetConfiguredLogQueueSize(config_) ||
+      config::GetConfiguredLogOverflowPolicy(config) != config::GetConfiguredLogOverflowPolicy(config_)) {
+    spdlog::warn("{}: changes to the listen address, threads, completion queues, pending requests, co-routine "
+                 "stack size, metrics or log queue take effect on restart", __func__);
+  }
+  impl_.Reload(config);
+}
+
+AsyncAuthServiceImpl::Stats AsyncAuthServiceImpl::GetStats() const {
+  return Stats{abandoned_.deadline_exceeded.load(), abandoned_.cancelled.load()};
+}
+
+void AsyncAuthServiceImpl::Shutdown() {
+  std::call_once(shutdown_, [this]() {
+    spdlog::info("Server shutting down");
+
+    // Start shutting down gRPC
+    server_->Shutdown();
+    for (auto &cq : cqs_) {
+      cq->Shutdown();
+    }
+  });
+}
+
+void AsyncAuthServiceImpl::Run() {
+  // Add a work object to the IO service so it will not shut down when it has nothing left to do
+  auto work = std::make_shared<boost::asio::io_context::work>(*io_context_);
+
+  // Spin up our worker threads
+  // Config validation should have already ensured that the number of threads is > 0
+  boost::thread_group threadpool;
+  for (unsigned int i = 0; i < config_.threads(); ++i) {
+    threadpool.create_thread([this](){
+      while(true) {
+        try {
+          this->io_context_->run();
+          break;
+        } catch(std::exception & e) {
+          spdlog::error("Unexpected error in worker thread: {}", e.what());
+        }
+      }
+    });
+  }
+
+  spdlog::info("{}: Server listening on {} with {} completion queues", __func__,
+               config::GetConfiguredAddress(config_), cqs_.size());
+
+  // Each completion queue gets its own polling thread so accepting and completing calls scales with cores.
+  boost::thread_group pollers;
+  for (size_t i = 0; i < cqs_.size(); ++i) {
+    auto queue = cqs_[i].get();
+    auto states = pools_[i].get();
+    pollers.create_thread([this, queue, states]() {
+      this->Poll(*queue, *states);
+    });
+  }
+  pollers.join_all();
 
+  // Let the idle co-routines exit so the io_context runs out of work
+  coroutines_.Stop();
   // Reset the work item for the IO service will terminate once it finishes any outstanding jobs
   work.reset();
   threadpool.join_all();
@@ -1,31 +1,90 @@
 #ifndef AUTHSERVICE_ASYNC_SERVICE_IMPL_H
 #define AUTHSERVICE_ASYNC_SERVICE_IMPL_H
 
+#include "coroutine_pool.h"
 #include "service_impl.h"
+#include "src/common/metrics/timeline.h"
 #include "envoy/service/auth/v2/external_auth.grpc.pb.h"
+#include <atomic>
 #include <boost/asio.hpp>
 #include <grpcpp/grpcpp.h>
+#include <mutex>
+#include <vector>
 
 using namespace envoy::service::auth::v2;
 
 namespace authservice {
 namespace service {
 
+/**
+ * Counts of calls whose caller gave up before a response was sent, by reason. Updated from every completion queue
+ * thread.
+ */
+struct AbandonedCalls {
+  // Calls whose deadline passed, such as when Envoy's ext_authz timeout fired.
+  std::atomic<uint64_t> deadline_exceeded{0};
+  // Calls the caller cancelled before their deadline.
+  std::atomic<uint64_t> cancelled{0};
+};
+
+class ProcessingStatePool;
+
 class AsyncAuthServiceImpl {
 public:
+  struct Stats {
+    uint64_t deadline_exceeded;
+    uint64_t cancelled;
+  };
+
   explicit AsyncAuthServiceImpl(authservice::config::Config config);
 
+  ~AsyncAuthServiceImpl();
+
   void Run();
 
+  /**
+   * Apply a new configuration to requests arriving from now on. Settings that shape the server itself, such as its
+   * address and thread counts, only take effect on restart.
+   * @param config the new configuration, which must have been validated.
+   * @throw std::exception if the filter chains cannot be built, in which case the current ones remain in use.
+   */
+  void Reload(const authservice::config::Config &config);
+
+  /**
+   * Get the number of calls abandoned by their callers so far.
+   * @return the counts, by reason.
+   */
+  Stats GetStats() const;
+
+  /**
+   * Shut down the server and all completion queues, making Run return. Safe to call from several threads.
+   */
+  void Shutdown();
+
 private:
+  /**
+   * Accept and complete requests on the given completion queue until the server shuts down.
+   * @param cq the completion queue to poll.
+   * @param states the call states of the completion queue.
+   */
+  void Poll(grpc::ServerCompletionQueue &cq, ProcessingStatePool &states);
+
   authservice::config::Config config_;
   authservice::service::AuthServiceImpl impl_;
 
   envoy::service::auth::v2::Authorization::AsyncService service_;
-  std::unique_ptr<grpc::ServerCompletionQueue> cq_;
+  std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> cqs_;
   std::unique_ptr<grpc::Server> server_;
+  // The call states of each completion queue. Co-routines still working on a call when its queue has been drained
+  // use its state, so these live until the service is destroyed.
+  std::vector<std::unique_ptr<ProcessingStatePool>> pools_;
+  std::once_flag shutdown_;
+  AbandonedCalls abandoned_;
+  // Records the stages each call passes through
+  common::metrics::TimelineRecorder timelines_;
 
   std::shared_ptr<boost::asio::io_context> io_context_;
+  CoroutinePool coroutines_;
 };
 
 }
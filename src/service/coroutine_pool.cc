@@ -0,0 +1,97 @@
+#include "coroutine_pool.h"
+#include <algorithm>
+#include <boost/coroutine/stack_traits.hpp>
+#include "spdlog/spdlog.h"
+
+namespace authservice {
+namespace service {
+namespace {
+std::size_t StackSize(std::size_t configured) {
+  if (configured == 0) {
+    return boost::coroutines::stack_traits::default_size();
+  }
+  return std::max(configured, boost::coroutines::stack_traits::minimum_size());
+}
+}  // namespace
+
+CoroutinePool::CoroutinePool(boost::asio::io_context &io_context, std::size_t stack_size)
+        : io_context_(io_context), attributes_(StackSize(stack_size)), stopped_(false) {
+}
+
+void CoroutinePool::Post(Job job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  jobs_.push_back(std::move(job));
+  if (idle_.empty()) {
+    Spawn();
+    return;
+  }
+  auto worker = idle_.back();
+  idle_.pop_back();
+  Wake(*worker);
+}
+
+void CoroutinePool::Stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stopped_ = true;
+  for (auto worker : idle_) {
+    Wake(*worker);
+  }
+  idle_.clear();
+}
+
+std::size_t CoroutinePool::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return workers_.size();
+}
+
+void CoroutinePool::Spawn() {
+  spdlog::trace("{}: creating co-routine {}", __func__, workers_.size() + 1);
+  workers_.emplace_back(new Worker(io_context_));
+  auto worker = workers_.back().get();
+  boost::asio::spawn(worker->strand, [this, worker](boost::asio::yield_context yield) {
+    Work(*worker, yield);
+  }, attributes_);
+}
+
+void CoroutinePool::Wake(Worker &worker) {
+  // The co-routine may not have started waiting yet. Posting through its strand orders the cancellation after the
+  // co-routine has suspended in async_wait.
+  auto timer = &worker.wakeup;
+  boost::asio::post(worker.strand, [timer]() {
+    timer->cancel();
+  });
+}
+
+void CoroutinePool::Work(Worker &worker, boost::asio::yield_context yield) {
+  while (true) {
+    Job job;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (jobs_.empty()) {
+        if (stopped_) {
+          return;
+        }
+        idle_.push_back(&worker);
+      } else {
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+      }
+    }
+
+    if (job) {
+      try {
+        job(yield);
+      } catch (const std::exception &e) {
+        spdlog::error("{}: Unexpected error: {}", __func__, e.what());
+      }
+      continue;
+    }
+
+    boost::system::error_code ec;
+    worker.wakeup.expires_at(boost::asio::steady_timer::time_point::max());
+    worker.wakeup.async_wait(yield[ec]);
+  }
+}
+
+}
+}
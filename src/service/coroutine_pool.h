@@ -0,0 +1,98 @@
+#ifndef AUTHSERVICE_COROUTINE_POOL_H
+#define AUTHSERVICE_COROUTINE_POOL_H
+
+#include <boost/asio.hpp>
+#include <boost/asio/spawn.hpp>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace authservice {
+namespace service {
+
+/**
+ * A pool of long-lived co-routines running on an io_context. Each co-routine owns a stack that is allocated once,
+ * when the co-routine is created, and is then reused for every job it runs. The pool grows whenever a job is posted
+ * while every co-routine is busy, so memory use follows the peak number of concurrent jobs rather than the request
+ * rate. Safe to use from several threads.
+ */
+class CoroutinePool {
+public:
+  typedef std::function<void(boost::asio::yield_context)> Job;
+
+  /**
+   * Create a pool.
+   * @param io_context the io_context the co-routines run on.
+   * @param stack_size the stack size in bytes of each co-routine, or 0 to use the Boost.Coroutine default. Sizes
+   *                   below the platform minimum are rounded up to it.
+   */
+  CoroutinePool(boost::asio::io_context &io_context, std::size_t stack_size);
+
+  /**
+   * Run a job on an idle co-routine, creating one if none is idle.
+   * @param job the job to run.
+   */
+  void Post(Job job);
+
+  /**
+   * Let every co-routine exit once the jobs already posted have finished, so the io_context can run out of work.
+   */
+  void Stop();
+
+  /**
+   * @return the io_context the co-routines run on.
+   */
+  boost::asio::io_context &Context() const {
+    return io_context_;
+  }
+
+  /**
+   * @return the number of co-routines, and so stacks, the pool has created.
+   */
+  std::size_t Size() const;
+
+private:
+  struct Worker {
+    explicit Worker(boost::asio::io_context &io_context) : strand(io_context.get_executor()), wakeup(io_context) {
+    }
+
+    // Serializes the co-routine with the handler that wakes it.
+    boost::asio::strand<boost::asio::io_context::executor_type> strand;
+    // Waited on, without expiry, while the co-routine is idle. Cancelled to wake it.
+    boost::asio::steady_timer wakeup;
+  };
+
+  /**
+   * Create a co-routine. Must be called with mutex_ held.
+   */
+  void Spawn();
+
+  /**
+   * Wake an idle co-routine.
+   * @param worker the co-routine to wake.
+   */
+  void Wake(Worker &worker);
+
+  /**
+   * The body of each co-routine: run jobs until the pool is stopped, waiting for more whenever there are none.
+   * @param worker the co-routine's state.
+   * @param yield the co-routine's yield context.
+   */
+  void Work(Worker &worker, boost::asio::yield_context yield);
+
+  boost::asio::io_context &io_context_;
+  boost::coroutines::attributes attributes_;
+
+  mutable std::mutex mutex_;
+  std::deque<Job> jobs_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<Worker *> idle_;
+  bool stopped_;
+};
+
+}
+}
+
+#endif //AUTHSERVICE_COROUTINE_POOL_H
@@ -1,16 +1,148 @@
 #include "service_impl.h"
 #include <grpcpp/grpcpp.h>
+#include <algorithm>
+#include <map>
 #include <memory>
 #include "spdlog/spdlog.h"
+#include "src/common/metrics/timeline.h"
 
 namespace authservice {
 namespace service {
+namespace {
 
-AuthServiceImpl::AuthServiceImpl(const config::Config& config) {
+// See src/filters/filter.h:filter::Process for a description of how status
+// codes should be handled
+::grpc::Status ToGrpcStatus(google::rpc::Code status) {
+  switch (status) {
+    case google::rpc::Code::OK:               // The request was successful
+    case google::rpc::Code::UNAUTHENTICATED:  // A filter indicated the
+      // request had no authentication
+      // but was processed correctly.
+    case google::rpc::Code::PERMISSION_DENIED:  // A filter indicated
+      // insufficient permissions
+      // for the authenticated
+      // requester but was processed
+      // correctly.
+      return ::grpc::Status::OK;
+    case google::rpc::Code::INVALID_ARGUMENT:  // The request was not well
+      // formed. Indicate a
+      // processing error to the
+      // caller.
+      return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                            "invalid request");
+    case google::rpc::Code::DEADLINE_EXCEEDED:  // Processing was abandoned
+      // because the deadline of the
+      // call passed.
+      return ::grpc::Status(::grpc::StatusCode::DEADLINE_EXCEEDED,
+                            "deadline exceeded");
+    case google::rpc::Code::CANCELLED:  // Processing was abandoned because
+      // the caller cancelled the call.
+      return ::grpc::Status(::grpc::StatusCode::CANCELLED, "cancelled");
+    default:  // All other errors are treated as internal processing failures.
+      return ::grpc::Status(::grpc::StatusCode::INTERNAL, "internal error");
+  }
+}
+
+const char *checks_name = "authservice_checks_total";
+const char *checks_help = "Checks of requests matching each filter chain, by the status its filters returned.";
+const char *check_duration_name = "authservice_check_duration_seconds";
+const char *check_duration_help = "The time each filter chain's filters took to check a request.";
+
+}  // namespace
+
+AuthServiceImpl::ChainMetrics::ChainMetrics(std::string chain)
+    : chain_(std::move(chain)), duration_(nullptr) {
+  for (auto &checks : checks_) {
+    checks = nullptr;
+  }
+}
+
+void AuthServiceImpl::ChainMetrics::Record(google::rpc::Code code,
+                                           std::chrono::steady_clock::duration duration) {
+  // Look each series up once. Threads racing to do so get the same series from the registry.
+  auto &registry = common::metrics::Registry::Default();
+  auto histogram = duration_.load(std::memory_order_acquire);
+  if (histogram == nullptr) {
+    histogram = &registry.GetHistogram(check_duration_name, check_duration_help, {{"chain", chain_}});
+    duration_.store(histogram, std::memory_order_release);
+  }
+  histogram->Observe(duration);
+
+  auto slot = static_cast<size_t>(code);
+  auto counter = slot < checks_.size() ? checks_[slot].load(std::memory_order_acquire) : nullptr;
+  if (counter == nullptr) {
+    counter = &registry.GetCounter(checks_name, checks_help,
+                                   {{"chain", chain_}, {"code", google::rpc::Code_Name(code)}});
+    if (slot < checks_.size()) {
+      checks_[slot].store(counter, std::memory_order_release);
+    }
+  }
+  counter->Increment();
+}
+
+AuthServiceImpl::Chains::Chains(const config::Config& config, const common::http::ptr_t& http,
+                                 const filters::oidc::JwksRefresherPtr& refresher, const Chains* previous)
+    : index(config.chains(), config.chain_context_extension()) {
+  // The position of each chain of the previous snapshot, by configuration
+  std::map<std::string, size_t> unchanged;
+  if (previous != nullptr) {
+    for (size_t position = 0; position < previous->configs.size(); ++position) {
+      unchanged.emplace(previous->configs[position], position);
+    }
+  }
   for (const auto &chain_config : config.chains()) {
-    std::unique_ptr<filters::FilterChain> chain(new filters::FilterChainImpl(chain_config));
-    chains_.push_back(std::move(chain));
+    auto serialized = chain_config.SerializeAsString();
+    auto reused = unchanged.find(serialized);
+    if (reused != unchanged.end()) {
+      chains.push_back(previous->chains[reused->second]);
+      metrics.push_back(previous->metrics[reused->second]);
+    } else {
+      chains.push_back(std::make_shared<filters::FilterChainImpl>(chain_config, http, refresher));
+      metrics.push_back(std::make_shared<ChainMetrics>(chain_config.name()));
+    }
+    configs.push_back(std::move(serialized));
+  }
+}
+
+AuthServiceImpl::AuthServiceImpl(const config::Config& config, common::http::ptr_t http)
+    : http_(std::move(http)),
+      refresher_(std::make_shared<filters::oidc::JwksRefresher>()),
+      chains_(std::make_shared<const Chains>(config, http_, refresher_)),
+      unmatched_(common::metrics::Registry::Default().GetCounter(
+          "authservice_unmatched_checks_total", "Checks of requests no filter chain matched.")),
+      errors_(common::metrics::Registry::Default().GetCounter(
+          "authservice_check_errors_total", "Checks that failed with an unexpected error.")) {}
+
+void AuthServiceImpl::Reload(const config::Config& config) {
+  // Build everything before publishing, so no request sees a partly built set of chains.
+  auto previous = std::atomic_load(&chains_);
+  auto chains = std::make_shared<const Chains>(config, http_, refresher_, previous.get());
+  size_t built = 0;
+  for (const auto &chain : chains->chains) {
+    if (std::find(previous->chains.begin(), previous->chains.end(), chain) == previous->chains.end()) {
+      ++built;
+    }
+  }
+  std::atomic_store(&chains_, std::shared_ptr<const Chains>(std::move(chains)));
+  spdlog::info("{}: published {} filter chains, {} of them new or modified", __func__, config.chains_size(), built);
+}
+
+absl::optional<size_t> AuthServiceImpl::FindChain(
+    const Chains &chains, const ::envoy::service::auth::v2::CheckRequest *request) {
+  // Find a configured processing chain.
+  auto position = chains.index.Find(request);
+  if (position.has_value()) {
+    // Checked first so that the arguments are not evaluated for every request when debug logging is off.
+    if (spdlog::default_logger_raw()->should_log(spdlog::level::debug)) {
+      spdlog::debug("{}: processing request {}://{}{} with filter chain {}", __func__, request->attributes().request().http().scheme(), request->attributes().request().http().host(), request->attributes().request().http().path(), chains.chains[*position]->Name());
+    }
+    return position;
+  }
+  // No matching filter chain found. Allow request to continue,
+  if (spdlog::default_logger_raw()->should_log(spdlog::level::debug)) {
+    spdlog::debug("{}: no matching filter chain for request to {}://{}{} ", __func__, request->attributes().request().http().scheme(), request->attributes().request().http().host(), request->attributes().request().http().path());
   }
+  return absl::nullopt;
 }
 
 ::grpc::Status AuthServiceImpl::Check(
@@ -19,45 +151,144 @@ AuthServiceImpl::AuthServiceImpl(const config::Config& config) {
     ::envoy::service::auth::v2::CheckResponse *response) {
   spdlog::trace("{}", __func__);
   try {
-    // Find a configured processing chain.
-    for (auto &chain : chains_) {
-      if (chain->Matches(request)) {
-        spdlog::debug("{}: processing request {}://{}{} with filter chain {}", __func__, request->attributes().request().http().scheme(), request->attributes().request().http().host(), request->attributes().request().http().path(), chain->Name());
-        // Create a new instance of a processor.
-        auto processor = chain->New();
-        auto status = processor->Process(request, response);
-        // See src/filters/filter.h:filter::Process for a description of how status
-        // codes should be handled
-        switch (status) {
-          case google::rpc::Code::OK:               // The request was successful
-          case google::rpc::Code::UNAUTHENTICATED:  // A filter indicated the
-            // request had no authentication
-            // but was processed correctly.
-          case google::rpc::Code::PERMISSION_DENIED:  // A filter indicated
-            // insufficient permissions
-            // for the authenticated
-            // requester but was processed
-            // correctly.
-            return ::grpc::Status::OK;
-          case google::rpc::Code::INVALID_ARGUMENT:  // The request was not well
-            // formed. Indicate a
-            // processing error to the
-            // caller.
-            return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
-                                  "invalid request");
-          default:  // All other errors are treated as internal processing failures.
-            return ::grpc::Status(::grpc::StatusCode::INTERNAL, "internal error");
-        }
+    auto timeline = common::metrics::Timeline::Current();
+    auto chains = std::atomic_load(&chains_);
+    auto position = FindChain(*chains, request);
+    if (timeline != nullptr) {
+      timeline->Record(common::metrics::Stage::matched);
+    }
+    if (!position.has_value()) {
+      unmatched_.Increment();
+      return ::grpc::Status::OK;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto code = chains->chains[*position]->Instance().Process(request, response);
+    chains->metrics[*position]->Record(code, std::chrono::steady_clock::now() - start);
+    if (timeline != nullptr) {
+      timeline->Record(common::metrics::Stage::processed);
+    }
+    return ToGrpcStatus(code);
+  } catch (const std::exception &exception) {
+    spdlog::error("{} unexpected error: {}", __func__, exception.what());
+  } catch (...) {
+    spdlog::error("{} unexpected error: unknown", __func__);
+  }
+  errors_.Increment();
+  return ::grpc::Status(::grpc::StatusCode::INTERNAL, "internal error");
+}
+
+absl::optional<::grpc::Status> AuthServiceImpl::TryCheck(
+    ::grpc::ServerContext *,
+    const ::envoy::service::auth::v2::CheckRequest *request,
+    ::envoy::service::auth::v2::CheckResponse *response,
+    Deferred *deferred) {
+  spdlog::trace("{}", __func__);
+  try {
+    auto timeline = common::metrics::Timeline::Current();
+    auto chains = std::atomic_load(&chains_);
+    auto position = FindChain(*chains, request);
+    if (timeline != nullptr) {
+      timeline->Record(common::metrics::Stage::matched);
+    }
+    if (!position.has_value()) {
+      unmatched_.Increment();
+      return ::grpc::Status::OK;
+    }
+    auto start = std::chrono::steady_clock::now();
+    filters::Deferral deferral;
+    deferral.timeline = timeline;
+    auto code = chains->chains[*position]->Instance().TryProcess(request, response, &deferral);
+    if (!code.has_value()) {
+      if (deferred == nullptr) {
+        // Check starts over, so it must find the response as it was.
+        response->Clear();
+        return absl::nullopt;
       }
+      // Recorded once the asynchronous check completes.
+      deferred->chains = std::move(chains);
+      deferred->position = *position;
+      deferred->filters = std::move(deferral);
+      deferred->start = start;
+      return absl::nullopt;
     }
-    // No matching filter chain found. Allow request to continue,
-    spdlog::debug("{}: no matching filter chain for request to {}://{}{} ", __func__, request->attributes().request().http().scheme(), request->attributes().request().http().host(), request->attributes().request().http().path());
-    return ::grpc::Status::OK;
+    chains->metrics[*position]->Record(*code, std::chrono::steady_clock::now() - start);
+    if (timeline != nullptr) {
+      timeline->Record(common::metrics::Stage::processed);
+    }
+    return ToGrpcStatus(*code);
+  } catch (const std::exception &exception) {
+    spdlog::error("{} unexpected error: {}", __func__, exception.what());
+  } catch (...) {
+    spdlog::error("{} unexpected error: unknown", __func__);
+  }
+  errors_.Increment();
+  return ::grpc::Status(::grpc::StatusCode::INTERNAL, "internal error");
+}
+
+::grpc::Status AuthServiceImpl::Check(
+    ::grpc::ServerContext *,
+    const ::envoy::service::auth::v2::CheckRequest *request,
+    ::envoy::service::auth::v2::CheckResponse *response,
+    const common::utilities::Deadline &deadline,
+    boost::asio::io_context &ioc,
+    boost::asio::yield_context yield) {
+  spdlog::trace("{}", __func__);
+  try {
+    // Taken before the filters can yield, after which another check may be current on this thread.
+    auto timeline = common::metrics::Timeline::Current();
+    // Holding the snapshot keeps the chain alive across yields even if a reload replaces it meanwhile.
+    auto chains = std::atomic_load(&chains_);
+    auto position = FindChain(*chains, request);
+    if (timeline != nullptr) {
+      timeline->Record(common::metrics::Stage::matched);
+    }
+    if (!position.has_value()) {
+      unmatched_.Increment();
+      return ::grpc::Status::OK;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto code = chains->chains[*position]->Instance().Process(request, response, deadline, ioc, yield);
+    chains->metrics[*position]->Record(code, std::chrono::steady_clock::now() - start);
+    if (timeline != nullptr) {
+      timeline->Record(common::metrics::Stage::processed);
+    }
+    return ToGrpcStatus(code);
+  } catch (const std::exception &exception) {
+    spdlog::error("{} unexpected error: {}", __func__, exception.what());
+  } catch (...) {
+    spdlog::error("{} unexpected error: unknown", __func__);
+  }
+  errors_.Increment();
+  return ::grpc::Status(::grpc::StatusCode::INTERNAL, "internal error");
+}
+
+::grpc::Status AuthServiceImpl::Check(
+    ::grpc::ServerContext *,
+    const ::envoy::service::auth::v2::CheckRequest *request,
+    ::envoy::service::auth::v2::CheckResponse *response,
+    const Deferred &deferred,
+    const common::utilities::Deadline &deadline,
+    boost::asio::io_context &ioc,
+    boost::asio::yield_context yield) {
+  spdlog::trace("{}", __func__);
+  try {
+    // Carried from TryCheck rather than current, as the check may have resumed on another thread.
+    auto timeline = deferred.filters.timeline;
+    // TryCheck already matched the request and recorded doing so.
+    auto &chains = *deferred.chains;
+    auto code = chains.chains[deferred.position]->Instance().ProcessDeferred(
+        request, response, deferred.filters, deadline, ioc, yield);
+    chains.metrics[deferred.position]->Record(code, std::chrono::steady_clock::now() - deferred.start);
+    if (timeline != nullptr) {
+      timeline->Record(common::metrics::Stage::processed);
+    }
+    return ToGrpcStatus(code);
   } catch (const std::exception &exception) {
-    spdlog::error("%s unexpected error: %s", __func__, exception.what());
+    spdlog::error("{} unexpected error: {}", __func__, exception.what());
   } catch (...) {
-    spdlog::error("%s unexpected error: unknown", __func__);
+    spdlog::error("{} unexpected error: unknown", __func__);
   }
+  errors_.Increment();
   return ::grpc::Status(::grpc::StatusCode::INTERNAL, "internal error");
 }
 }  // namespace service
@@ -1,8 +1,18 @@
 #ifndef AUTHSERVICE_SERVICEIMPL_H
 #define AUTHSERVICE_SERVICEIMPL_H
+#include <array>
+#include <atomic>
+#include <chrono>
+#include "absl/types/optional.h"
 #include "config/config.pb.h"
 #include "envoy/service/auth/v2/external_auth.grpc.pb.h"
+#include "google/rpc/code.pb.h"
+#include "src/common/http/http.h"
+#include "src/common/metrics/metrics.h"
+#include "src/filters/chain_index.h"
 #include "src/filters/filter_chain.h"
+#include <boost/asio.hpp>
+#include <boost/asio/spawn.hpp>
 
 using namespace envoy::service::auth::v2;
 
@@ -11,14 +21,171 @@ namespace service {
 
 class AuthServiceImpl final : public Authorization::Service {
  private:
-  std::vector<std::unique_ptr<filters::FilterChain>> chains_;
+  /**
+   * The number and duration of the checks made by one filter chain. The
+   * series are created on first use, so chains that see no requests export
+   * nothing. Thread safe.
+   */
+  class ChainMetrics {
+   public:
+    explicit ChainMetrics(std::string chain);
+
+    /**
+     * Record a completed check.
+     * @param code the status returned by the chain's filters.
+     * @param duration the time the filters took.
+     */
+    void Record(google::rpc::Code code, std::chrono::steady_clock::duration duration);
+
+   private:
+    const std::string chain_;
+    // Indexed by status code
+    std::array<std::atomic<common::metrics::Counter*>, google::rpc::Code_ARRAYSIZE> checks_;
+    std::atomic<common::metrics::Histogram*> duration_;
+  };
+
+  /**
+   * The filter chains built from one configuration. Never modified once
+   * published, so a request keeps using the snapshot it started with while a
+   * reload publishes the next one. A chain whose configuration is unchanged is
+   * shared with the previous snapshot rather than rebuilt.
+   */
+  struct Chains {
+    /**
+     * @param config the configuration to build the chains of.
+     * @param http the HTTP client of the filters, or nullptr.
+     * @param refresher runs the background fetches of the filters' key sets.
+     * @param previous the snapshot to take the chains whose configuration is
+     * unchanged from, or nullptr to build every chain.
+     */
+    Chains(const config::Config& config, const common::http::ptr_t& http,
+           const filters::oidc::JwksRefresherPtr& refresher, const Chains* previous = nullptr);
+
+    std::vector<std::shared_ptr<filters::FilterChain>> chains;
+    // The metrics of each chain, by position
+    std::vector<std::shared_ptr<ChainMetrics>> metrics;
+    // The serialized configuration of each chain, by position
+    std::vector<std::string> configs;
+    filters::ChainIndex index;
+  };
+
+  // Shared by the filters of every chain when set, otherwise each filter has its own
+  common::http::ptr_t http_;
+  // Shared by the key set fetches of every chain, so they all run on one thread
+  filters::oidc::JwksRefresherPtr refresher_;
+  // Swapped atomically by Reload
+  std::shared_ptr<const Chains> chains_;
+  // Checks of requests no chain matched
+  common::metrics::Counter& unmatched_;
+  // Checks that failed with an unexpected error
+  common::metrics::Counter& errors_;
+
+  /**
+   * Find the first filter chain of a snapshot matching the request.
+   * @param chains the snapshot to search.
+   * @param request the request to match.
+   * @return the position of the matching chain or absl::nullopt if no chain
+   * matches.
+   */
+  static absl::optional<size_t> FindChain(const Chains& chains,
+                                          const ::envoy::service::auth::v2::CheckRequest* request);
 
  public:
-  AuthServiceImpl(const config::Config& config);
+  /**
+   * What TryCheck did with a request it deferred to the asynchronous Check,
+   * handed back to Check so that it carries on from there rather than matching
+   * the request and running the filters again. One per call.
+   */
+  struct Deferred {
+    // The snapshot the request matched in, kept alive across yields even if a reload replaces it meanwhile.
+    std::shared_ptr<const Chains> chains;
+    // The position of the matching chain
+    size_t position = 0;
+    // How far the chain's filters got
+    filters::Deferral filters;
+    // When the chain's filters started on the request
+    std::chrono::steady_clock::time_point start;
+  };
+
+  /**
+   * @param config the configuration, which must have been validated.
+   * @param http the HTTP client the filters reach OIDC Providers with, or
+   * nullptr for each filter to create its own. Used by the chains of later
+   * configurations too.
+   */
+  AuthServiceImpl(const config::Config& config, common::http::ptr_t http = nullptr);
+
+  /**
+   * Build the filter chains of a new configuration and publish them for
+   * requests arriving from then on. Requests already in progress finish with
+   * the chains they started with. Chains whose configuration is unchanged are
+   * kept as they are, with their session caches, connections and key sets;
+   * only chains that were added or modified are built.
+   * @param config the new configuration, which must have been validated.
+   * @throw std::exception if the chains cannot be built, in which case the
+   * current chains remain in use.
+   */
+  void Reload(const config::Config& config);
+
   ::grpc::Status Check(
       ::grpc::ServerContext* context,
       const ::envoy::service::auth::v2::CheckRequest* request,
       ::envoy::service::auth::v2::CheckResponse* response) override;
+
+  /**
+   * Check a request on the calling thread if it can be decided without I/O.
+   * @param context the server context of the call.
+   * @param request the request to check.
+   * @param response the response to populate.
+   * @param deferred where to record how far the check got if it must be
+   * finished asynchronously, or nullptr to have Check start over.
+   * @return the call status, or absl::nullopt if the request must be checked
+   * asynchronously, in which case the response is left as the filters left it
+   * for Check to carry on with if deferred is given, and unmodified otherwise.
+   */
+  absl::optional<::grpc::Status> TryCheck(
+      ::grpc::ServerContext* context,
+      const ::envoy::service::auth::v2::CheckRequest* request,
+      ::envoy::service::auth::v2::CheckResponse* response,
+      Deferred* deferred = nullptr);
+
+  /**
+   * Check a request inside a Boost co-routine, yielding while filters perform I/O.
+   * @param context the server context of the call.
+   * @param request the request to check.
+   * @param response the response to populate.
+   * @param deadline the deadline of the call, cancelled if the caller gives up.
+   * @param ioc the I/O context on which the co-routine is running.
+   * @param yield the yield context of the co-routine.
+   * @return the call status.
+   */
+  ::grpc::Status Check(
+      ::grpc::ServerContext* context,
+      const ::envoy::service::auth::v2::CheckRequest* request,
+      ::envoy::service::auth::v2::CheckResponse* response,
+      const common::utilities::Deadline& deadline,
+      boost::asio::io_context& ioc,
+      boost::asio::yield_context yield);
+
+  /**
+   * Finish a check TryCheck deferred, inside a Boost co-routine.
+   * @param context the server context of the call.
+   * @param request the request to check.
+   * @param response the response to populate, as TryCheck left it.
+   * @param deferred what TryCheck recorded when deferring the check.
+   * @param deadline the deadline of the call, cancelled if the caller gives up.
+   * @param ioc the I/O context on which the co-routine is running.
+   * @param yield the yield context of the co-routine.
+   * @return the call status.
+   */
+  ::grpc::Status Check(
+      ::grpc::ServerContext* context,
+      const ::envoy::service::auth::v2::CheckRequest* request,
+      ::envoy::service::auth::v2::CheckResponse* response,
+      const Deferred& deferred,
+      const common::utilities::Deadline& deadline,
+      boost::asio::io_context& ioc,
+      boost::asio::yield_context yield);
 };
 }  // namespace service
 }  // namespace authservice
@@ -0,0 +1,161 @@
+#include "src/common/http/connection_pool.h"
+#include <chrono>
+#include <thread>
+#include "gtest/gtest.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+
+using tcp = boost::asio::ip::tcp;
+
+class ConnectionPoolTest : public ::testing::Test {
+ protected:
+  boost::asio::io_context ioc_;
+  tcp::acceptor acceptor_;
+  std::vector<std::unique_ptr<tcp::socket>> accepted_;
+  authservice::config::common::Endpoint endpoint_;
+
+  ConnectionPoolTest()
+      : acceptor_(ioc_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)) {
+    endpoint_.set_scheme("https");
+    endpoint_.set_hostname("127.0.0.1");
+    endpoint_.set_port(acceptor_.local_endpoint().port());
+    endpoint_.set_path("/token");
+  }
+
+  // Open a connection to the test acceptor. TLS is not needed to exercise the pool.
+  ConnectionPool::StreamPtr Connect(ConnectionPool &pool) { return Connect(pool, ioc_); }
+
+  ConnectionPool::StreamPtr Connect(ConnectionPool &pool, boost::asio::io_context &ioc) {
+    ConnectionPool::StreamPtr stream(new ConnectionPool::Stream(ioc, pool.Context(endpoint_).Context()));
+    boost::beast::get_lowest_layer(*stream).connect(acceptor_.local_endpoint());
+    accepted_.emplace_back(new tcp::socket(ioc_));
+    acceptor_.accept(*accepted_.back());
+    return stream;
+  }
+
+  // Whether the client end of an accepted connection has been closed.
+  static bool ClosedByClient(tcp::socket &accepted) {
+    char byte;
+    boost::system::error_code ec;
+    accepted.non_blocking(true);
+    accepted.read_some(boost::asio::buffer(&byte, 1), ec);
+    return ec == boost::asio::error::eof;
+  }
+};
+
+TEST_F(ConnectionPoolTest, AcquireWithoutIdleConnections) {
+  ConnectionPool pool(4, std::chrono::seconds(30));
+  ASSERT_EQ(pool.Acquire(endpoint_, ioc_), nullptr);
+}
+
+TEST_F(ConnectionPoolTest, ReusesReleasedConnection) {
+  ConnectionPool pool(4, std::chrono::seconds(30));
+  auto stream = Connect(pool);
+  auto released = stream.get();
+  pool.Release(endpoint_, ioc_, std::move(stream));
+
+  ASSERT_EQ(pool.Acquire(endpoint_, ioc_).get(), released);
+  ASSERT_EQ(pool.Acquire(endpoint_, ioc_), nullptr);
+}
+
+TEST_F(ConnectionPoolTest, KeepsConnectionsPerEndpoint) {
+  ConnectionPool pool(4, std::chrono::seconds(30));
+  pool.Release(endpoint_, ioc_, Connect(pool));
+
+  auto other = endpoint_;
+  other.set_port(endpoint_.port() + 1);
+  ASSERT_EQ(pool.Acquire(other, ioc_), nullptr);
+
+  boost::asio::io_context other_ioc;
+  ASSERT_EQ(pool.Acquire(endpoint_, other_ioc), nullptr);
+}
+
+TEST_F(ConnectionPoolTest, DiscardsConnectionsClosedByPeer) {
+  ConnectionPool pool(4, std::chrono::seconds(30));
+  pool.Release(endpoint_, ioc_, Connect(pool));
+  accepted_.back()->close();
+
+  ASSERT_EQ(pool.Acquire(endpoint_, ioc_), nullptr);
+}
+
+TEST_F(ConnectionPoolTest, DiscardsConnectionsWithUnexpectedData) {
+  ConnectionPool pool(4, std::chrono::seconds(30));
+  pool.Release(endpoint_, ioc_, Connect(pool));
+  boost::asio::write(*accepted_.back(), boost::asio::buffer("x", 1));
+
+  ASSERT_EQ(pool.Acquire(endpoint_, ioc_), nullptr);
+}
+
+TEST_F(ConnectionPoolTest, DiscardsIdleConnectionsAfterTimeout) {
+  ConnectionPool pool(4, std::chrono::seconds(0));
+  pool.Release(endpoint_, ioc_, Connect(pool));
+
+  ASSERT_EQ(pool.Acquire(endpoint_, ioc_), nullptr);
+}
+
+TEST_F(ConnectionPoolTest, ClosesConnectionsBeyondMaxIdle) {
+  ConnectionPool pool(1, std::chrono::seconds(30));
+  pool.Release(endpoint_, ioc_, Connect(pool));
+  pool.Release(endpoint_, ioc_, Connect(pool));
+
+  ASSERT_NE(pool.Acquire(endpoint_, ioc_), nullptr);
+  ASSERT_EQ(pool.Acquire(endpoint_, ioc_), nullptr);
+}
+
+TEST_F(ConnectionPoolTest, ClosesConnectionsWithTheirIoContext) {
+  ConnectionPool pool(4, std::chrono::seconds(30));
+  {
+    boost::asio::io_context scoped;
+    pool.Release(endpoint_, scoped, Connect(pool, scoped));
+  }
+  ASSERT_TRUE(ClosedByClient(*accepted_.back()));
+
+  // An io_context created later, possibly at the same address, starts without idle connections.
+  boost::asio::io_context later;
+  ASSERT_EQ(pool.Acquire(endpoint_, later), nullptr);
+  pool.Release(endpoint_, later, Connect(pool, later));
+  ASSERT_NE(pool.Acquire(endpoint_, later), nullptr);
+}
+
+TEST_F(ConnectionPoolTest, ClosesConnectionsOfDestroyedPools) {
+  {
+    ConnectionPool destroyed(4, std::chrono::seconds(30));
+    destroyed.Release(endpoint_, ioc_, Connect(destroyed));
+  }
+  auto &orphaned = *accepted_.back();
+
+  ConnectionPool pool(4, std::chrono::seconds(30));
+  pool.Release(endpoint_, ioc_, Connect(pool));
+  ASSERT_TRUE(ClosedByClient(orphaned));
+  ASSERT_NE(pool.Acquire(endpoint_, ioc_), nullptr);
+}
+
+TEST_F(ConnectionPoolTest, ClosesTimedOutConnectionsOfOtherEndpoints) {
+  ConnectionPool pool(4, std::chrono::milliseconds(50));
+  // Never acquired again, so only a sweep can close it.
+  pool.Release(endpoint_, ioc_, Connect(pool));
+  auto &accepted = *accepted_.back();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  auto other = endpoint_;
+  other.set_port(endpoint_.port() + 1);
+  ASSERT_EQ(pool.Acquire(other, ioc_), nullptr);
+  ASSERT_TRUE(ClosedByClient(accepted));
+}
+
+TEST_F(ConnectionPoolTest, IdleConnectionsDoNotKeepTheIoContextRunning) {
+  ConnectionPool pool(4, std::chrono::seconds(30));
+  boost::asio::io_context worker;
+  boost::asio::post(worker, [&]() { pool.Release(endpoint_, worker, Connect(pool, worker)); });
+
+  auto start = std::chrono::steady_clock::now();
+  worker.run();
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  ASSERT_NE(pool.Acquire(endpoint_, worker), nullptr);
+}
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
@@ -2,6 +2,12 @@
 #include "config/common/config.pb.h"
 #include "gtest/gtest.h"
 #include "src/common/http/headers.h"
+#include "test/common/http/certificate.h"
+#include <atomic>
+#include <boost/asio/spawn.hpp>
+#include <boost/asio/ssl.hpp>
+#include <chrono>
+#include <thread>
 
 namespace authservice {
 namespace common {
@@ -201,6 +207,222 @@ TEST(Http, DecodePath) {
   ASSERT_STREQ("", result5[2].data());
 }
 
+TEST(Http, PostRetriesConnectionsThatTimeOut) {
+  // An endpoint that accepts connections but never completes the TLS
+  // handshake.
+  boost::asio::io_context ioc;
+  boost::asio::ip::tcp::acceptor acceptor(
+      ioc, boost::asio::ip::tcp::endpoint(
+               boost::asio::ip::address_v4::loopback(), 0));
+  std::vector<boost::asio::ip::tcp::socket> accepted;
+  std::function<void()> accept = [&]() {
+    acceptor.async_accept(
+        [&](boost::system::error_code ec, boost::asio::ip::tcp::socket socket) {
+          if (!ec) {
+            accepted.push_back(std::move(socket));
+            accept();
+          }
+        });
+  };
+  accept();
+
+  authservice::config::common::Endpoint endpoint;
+  endpoint.set_scheme("https");
+  endpoint.set_hostname("127.0.0.1");
+  endpoint.set_port(acceptor.local_endpoint().port());
+  endpoint.set_path("/token");
+  endpoint.set_connect_timeout_ms(100);
+  endpoint.set_retries(2);
+
+  http_impl client;
+  common::utilities::Deadline deadline;
+  response_t response(new beast::http::response<beast::http::string_body>);
+  boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+    response = client.Post(endpoint, {}, "", deadline, ioc, yield);
+    acceptor.close();
+  });
+  ioc.run();
+
+  ASSERT_EQ(response, nullptr);
+  ASSERT_EQ(accepted.size(), 3);
+}
+
+TEST(Http, DoesNotRetryRequestsThatReachedTheEndpoint) {
+  // An endpoint that answers the first request on a connection and keeps it
+  // open, then reads the second request and closes the connection without
+  // answering it.
+  boost::asio::io_context server_ioc;
+  boost::asio::ssl::context server_context(boost::asio::ssl::context::tls_server);
+  server_context.use_certificate_chain(boost::asio::buffer(certificate, sizeof(certificate) - 1));
+  server_context.use_private_key(boost::asio::buffer(private_key, sizeof(private_key) - 1),
+                                 boost::asio::ssl::context::pem);
+  boost::asio::ip::tcp::acceptor acceptor(
+      server_ioc, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+  std::atomic<bool> stopping(false);
+  std::atomic<int> requests(0);
+  std::thread server([&]() {
+    while (true) {
+      boost::asio::ssl::stream<boost::asio::ip::tcp::socket> stream(server_ioc, server_context);
+      boost::system::error_code ec;
+      acceptor.accept(stream.next_layer(), ec);
+      if (ec || stopping) {
+        return;
+      }
+      stream.handshake(boost::asio::ssl::stream_base::server, ec);
+      beast::flat_buffer buffer;
+      for (auto served = 0; !ec; ++served) {
+        beast::http::request<beast::http::string_body> request;
+        beast::http::read(stream, buffer, request, ec);
+        if (ec) {
+          break;
+        }
+        ++requests;
+        if (served == 1) {
+          break;
+        }
+        beast::http::response<beast::http::string_body> response(beast::http::status::ok, 11);
+        response.keep_alive(true);
+        response.prepare_payload();
+        beast::http::write(stream, response, ec);
+      }
+      stream.next_layer().close(ec);
+    }
+  });
+
+  authservice::config::common::Endpoint endpoint;
+  endpoint.set_scheme("https");
+  endpoint.set_hostname("127.0.0.1");
+  endpoint.set_port(acceptor.local_endpoint().port());
+  endpoint.set_path("/token");
+  endpoint.set_retries(2);
+
+  response_t first, second;
+  {
+    auto pool = std::make_shared<ConnectionPool>();
+    pool->Context(endpoint).Context().add_certificate_authority(
+        boost::asio::buffer(certificate, sizeof(certificate) - 1));
+    http_impl client(pool, std::make_shared<ResolverCache>());
+    boost::asio::io_context ioc;
+    common::utilities::Deadline deadline;
+    boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+      first = client.Post(endpoint, {}, "code=first", deadline, ioc, yield);
+      second = client.Post(endpoint, {}, "code=second", deadline, ioc, yield);
+    });
+    ioc.run();
+    // Destroying the io_context closes any connection left in the pool.
+  }
+
+  stopping = true;
+  boost::asio::ip::tcp::socket wake(server_ioc);
+  wake.connect(acceptor.local_endpoint());
+  server.join();
+
+  ASSERT_NE(first, nullptr);
+  ASSERT_EQ(second, nullptr);
+  ASSERT_EQ(requests, 2);
+}
+
+namespace {
+// Makes a request to an endpoint that accepts connections and never answers,
+// with the given deadline, and returns how long the request took.
+std::chrono::steady_clock::duration RequestUnanswered(common::utilities::Deadline &deadline) {
+  boost::asio::io_context ioc;
+  boost::asio::ip::tcp::acceptor acceptor(
+      ioc, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+  boost::asio::ip::tcp::socket accepted(ioc);
+  acceptor.async_accept(accepted, [](const boost::system::error_code &) {});
+
+  authservice::config::common::Endpoint endpoint;
+  endpoint.set_scheme("https");
+  endpoint.set_hostname("127.0.0.1");
+  endpoint.set_port(acceptor.local_endpoint().port());
+  endpoint.set_path("/token");
+  endpoint.set_connect_timeout_ms(10000);
+  endpoint.set_request_timeout_ms(10000);
+
+  http_impl client;
+  response_t response(new beast::http::response<beast::http::string_body>);
+  auto start = std::chrono::steady_clock::now();
+  boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+    response = client.Post(endpoint, {}, "", deadline, ioc, yield);
+    acceptor.close();
+    accepted.close();
+  });
+  ioc.run();
+
+  EXPECT_EQ(response, nullptr);
+  return std::chrono::steady_clock::now() - start;
+}
+}  // namespace
+
+TEST(Http, CancellingTheCallAbortsTheRequest) {
+  common::utilities::Deadline deadline;
+  std::thread canceller([&deadline]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    deadline.Cancel();
+  });
+  auto elapsed = RequestUnanswered(deadline);
+  canceller.join();
+
+  // Well within the endpoint's timeouts.
+  ASSERT_LT(elapsed, std::chrono::seconds(5));
+}
+
+TEST(Http, ExpiringDeadlineAbortsTheRequest) {
+  common::utilities::Deadline deadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(100));
+  auto elapsed = RequestUnanswered(deadline);
+
+  ASSERT_LT(elapsed, std::chrono::seconds(5));
+}
+
+namespace {
+// A DNS cache whose resolutions never complete, as when getaddrinfo hangs.
+class StalledResolverCache : public ResolverCache {
+ public:
+  // The handlers of the stalled resolutions, which the test destroys.
+  std::vector<ResolutionHandler> handlers;
+
+ protected:
+  void StartResolution(boost::asio::ip::tcp::resolver &, const std::string &,
+                       const std::string &,
+                       ResolutionHandler handler) override {
+    handlers.push_back(std::move(handler));
+  }
+};
+}  // namespace
+
+TEST(Http, CancellingTheCallAbortsTheResolution) {
+  authservice::config::common::Endpoint endpoint;
+  endpoint.set_scheme("https");
+  endpoint.set_hostname("idp.example.com");
+  endpoint.set_port(443);
+  endpoint.set_path("/token");
+  endpoint.set_connect_timeout_ms(10000);
+
+  auto resolver = std::make_shared<StalledResolverCache>();
+  http_impl client(std::make_shared<ConnectionPool>(), resolver);
+  common::utilities::Deadline deadline;
+  boost::asio::io_context ioc;
+  response_t response(new beast::http::response<beast::http::string_body>);
+  std::thread canceller([&deadline]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    deadline.Cancel();
+  });
+  auto start = std::chrono::steady_clock::now();
+  boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+    response = client.Post(endpoint, {}, "", deadline, ioc, yield);
+  });
+  ioc.run();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  canceller.join();
+
+  ASSERT_EQ(response, nullptr);
+  ASSERT_EQ(resolver->handlers.size(), 1u);
+  resolver->handlers.clear();
+  // Well within the endpoint's connect timeout.
+  ASSERT_LT(elapsed, std::chrono::seconds(5));
+}
+
 }  // namespace http
 }  // namespace common
 }  // namespace authservice
@@ -13,11 +13,20 @@ class http_mock : public http {
                  const std::map<absl::string_view, absl::string_view> &headers,
                  absl::string_view body));
 
-  MOCK_CONST_METHOD5(
+  MOCK_CONST_METHOD6(
           Post,
           response_t(const authservice::config::common::Endpoint &endpoint,
                   const std::map<absl::string_view, absl::string_view> &headers,
                   absl::string_view body,
+                  const common::utilities::Deadline& deadline,
+                  boost::asio::io_context& ioc,
+                  boost::asio::yield_context yield));
+
+  MOCK_CONST_METHOD5(
+          Get,
+          response_t(const authservice::config::common::Endpoint &endpoint,
+                  const std::map<absl::string_view, absl::string_view> &headers,
+                  const common::utilities::Deadline& deadline,
                   boost::asio::io_context& ioc,
                   boost::asio::yield_context yield));
 };
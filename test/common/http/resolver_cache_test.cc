@@ -0,0 +1,284 @@
+#include "src/common/http/resolver_cache.h"
+#include "gtest/gtest.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+
+namespace {
+const std::chrono::seconds timeout(5);
+
+// Resolve localhost from a co-routine, as the HTTP client does.
+void Resolve(ResolverCache &cache, boost::asio::io_context &ioc) {
+  boost::asio::spawn(ioc, [&cache, &ioc](boost::asio::yield_context yield) {
+    utilities::Deadline deadline;
+    auto results = cache.Resolve("localhost", "443", timeout, deadline, ioc, yield);
+    ASSERT_FALSE(results.empty());
+    ASSERT_EQ(results.begin()->endpoint().port(), 443);
+  });
+  ioc.run();
+  ioc.restart();
+}
+}  // namespace
+
+TEST(ResolverCacheTest, ServesRepeatedLookupsFromMemory) {
+  boost::asio::io_context ioc;
+  auto cache = std::make_shared<ResolverCache>();
+
+  Resolve(*cache, ioc);
+  Resolve(*cache, ioc);
+
+  auto stats = cache->GetStats();
+  ASSERT_EQ(stats.misses, 1u);
+  ASSERT_EQ(stats.hits, 1u);
+  ASSERT_EQ(stats.refreshes, 0u);
+  ASSERT_EQ(stats.resolutions, 1u);
+  ASSERT_GT(stats.total_resolution_time.count(), 0);
+}
+
+TEST(ResolverCacheTest, RefreshesStaleResultsInTheBackground) {
+  boost::asio::io_context ioc;
+  auto cache = std::make_shared<ResolverCache>(std::chrono::seconds(0),
+                                               std::chrono::minutes(10));
+
+  Resolve(*cache, ioc);
+  Resolve(*cache, ioc);
+
+  auto stats = cache->GetStats();
+  ASSERT_EQ(stats.misses, 1u);
+  ASSERT_EQ(stats.hits, 1u);
+  ASSERT_EQ(stats.refreshes, 1u);
+  ASSERT_EQ(stats.resolutions, 2u);
+}
+
+TEST(ResolverCacheTest, ResolvesExpiredResultsAgain) {
+  boost::asio::io_context ioc;
+  auto cache = std::make_shared<ResolverCache>(std::chrono::seconds(0),
+                                               std::chrono::seconds(0));
+
+  Resolve(*cache, ioc);
+  Resolve(*cache, ioc);
+
+  auto stats = cache->GetStats();
+  ASSERT_EQ(stats.misses, 2u);
+  ASSERT_EQ(stats.hits, 0u);
+}
+
+TEST(ResolverCacheTest, ConcurrentLookupsOfANewHostShareOneResolution) {
+  boost::asio::io_context ioc;
+  auto cache = std::make_shared<ResolverCache>();
+
+  utilities::Deadline deadline;
+  for (int i = 0; i < 8; ++i) {
+    boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+      auto results = cache->Resolve("localhost", "443", timeout, deadline, ioc, yield);
+      ASSERT_FALSE(results.empty());
+    });
+  }
+  ioc.run();
+
+  auto stats = cache->GetStats();
+  ASSERT_EQ(stats.misses, 8u);
+  ASSERT_EQ(stats.resolutions, 1u);
+}
+
+TEST(ResolverCacheTest, RefreshesAgainAfterARefreshIsAbandoned) {
+  boost::asio::io_context ioc;
+  auto cache = std::make_shared<ResolverCache>(std::chrono::seconds(0),
+                                               std::chrono::minutes(10));
+  Resolve(*cache, ioc);
+
+  {
+    // The lookup starts a refresh on an io_context destroyed before the
+    // refresh completes.
+    boost::asio::io_context short_lived;
+    utilities::Deadline deadline;
+    boost::asio::spawn(
+        short_lived, [&](boost::asio::yield_context yield) {
+          cache->Resolve("localhost", "443", timeout, deadline, short_lived, yield);
+        });
+    short_lived.run_one();
+  }
+  ASSERT_EQ(cache->GetStats().refreshes, 1u);
+
+  Resolve(*cache, ioc);
+  ASSERT_EQ(cache->GetStats().refreshes, 2u);
+}
+
+TEST(ResolverCacheTest, WaitingLookupsEndWhenTheirResolutionIsAbandoned) {
+  boost::asio::io_context ioc;
+  auto cache = std::make_shared<ResolverCache>();
+  utilities::Deadline deadline;
+  bool failed = false;
+  {
+    // The first lookup resolves on an io_context destroyed before the
+    // resolution completes, while a lookup on another waits for it.
+    boost::asio::io_context short_lived;
+    boost::asio::spawn(
+        short_lived, [&](boost::asio::yield_context yield) {
+          cache->Resolve("localhost", "443", timeout, deadline, short_lived, yield);
+        });
+    short_lived.run_one();
+    boost::asio::spawn(
+        ioc, [&](boost::asio::yield_context yield) {
+          try {
+            cache->Resolve("localhost", "443", timeout, deadline, ioc, yield);
+          } catch (const boost::system::system_error &) {
+            failed = true;
+          }
+        });
+    ioc.run_one();
+  }
+  ioc.run();
+
+  ASSERT_TRUE(failed);
+  ASSERT_EQ(cache->GetStats().resolutions, 0u);
+}
+
+namespace {
+// A cache that fails to start resolutions once told to.
+class FailingResolverCache : public ResolverCache {
+ public:
+  FailingResolverCache()
+      : ResolverCache(std::chrono::seconds(0), std::chrono::minutes(10), std::chrono::seconds(0)) {}
+
+  bool failing = false;
+
+ protected:
+  void StartResolution(boost::asio::ip::tcp::resolver &resolver, const std::string &host,
+                       const std::string &port, ResolutionHandler handler) override {
+    if (failing) {
+      throw boost::system::system_error(boost::asio::error::no_memory);
+    }
+    ResolverCache::StartResolution(resolver, host, port, std::move(handler));
+  }
+};
+}  // namespace
+
+TEST(ResolverCacheTest, RefreshesAgainAfterARefreshFailsToStart) {
+  boost::asio::io_context ioc;
+  auto cache = std::make_shared<FailingResolverCache>();
+  Resolve(*cache, ioc);
+
+  // The stale results are served even though the refresh fails to start.
+  cache->failing = true;
+  Resolve(*cache, ioc);
+  ASSERT_EQ(cache->GetStats().refreshes, 1u);
+
+  cache->failing = false;
+  Resolve(*cache, ioc);
+  ASSERT_EQ(cache->GetStats().refreshes, 2u);
+}
+
+namespace {
+// Wait for a resolution another lookup started on an io_context that is never
+// run, so that it never completes, and return how the wait ended.
+boost::system::error_code WaitForAStalledResolution(
+    std::chrono::steady_clock::duration timeout,
+    utilities::Deadline &deadline, bool cancel) {
+  auto cache = std::make_shared<ResolverCache>();
+  // Outlives the io_context, with which the stalled lookup is destroyed.
+  utilities::Deadline never;
+  boost::asio::io_context stalled;
+  boost::asio::spawn(stalled, [&](boost::asio::yield_context yield) {
+    cache->Resolve("localhost", "443", std::chrono::seconds(5), never, stalled, yield);
+  });
+  stalled.run_one();
+
+  boost::asio::io_context ioc;
+  boost::system::error_code ec;
+  boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+    try {
+      cache->Resolve("localhost", "443", timeout, deadline, ioc, yield);
+    } catch (const boost::system::system_error &e) {
+      ec = e.code();
+    }
+  });
+  if (cancel) {
+    // Runs once the lookup is waiting.
+    boost::asio::post(ioc, [&deadline]() { deadline.Cancel(); });
+  }
+  ioc.run();
+  return ec;
+}
+}  // namespace
+
+TEST(ResolverCacheTest, WaitingLookupsEndAtTheirTimeout) {
+  utilities::Deadline deadline;
+  auto ec = WaitForAStalledResolution(std::chrono::milliseconds(10), deadline, false);
+  ASSERT_EQ(ec, boost::asio::error::timed_out);
+}
+
+TEST(ResolverCacheTest, WaitingLookupsEndAtTheirDeadline) {
+  utilities::Deadline deadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+  auto ec = WaitForAStalledResolution(std::chrono::seconds(5), deadline, false);
+  ASSERT_EQ(ec, boost::asio::error::timed_out);
+}
+
+TEST(ResolverCacheTest, WaitingLookupsEndWhenTheirCallIsCancelled) {
+  utilities::Deadline deadline;
+  auto ec = WaitForAStalledResolution(std::chrono::seconds(5), deadline, true);
+  ASSERT_EQ(ec, boost::asio::error::operation_aborted);
+}
+
+namespace {
+// A cache whose resolutions never complete, as when getaddrinfo hangs.
+class StalledResolverCache : public ResolverCache {
+ public:
+  // The handlers of the stalled resolutions, which the test destroys.
+  std::vector<ResolutionHandler> handlers;
+
+ protected:
+  void StartResolution(boost::asio::ip::tcp::resolver &, const std::string &,
+                       const std::string &,
+                       ResolutionHandler handler) override {
+    handlers.push_back(std::move(handler));
+  }
+};
+
+// Look up a host whose resolution stalls, and return how the lookup ended.
+boost::system::error_code ResolveStalledHost(
+    std::chrono::steady_clock::duration timeout,
+    utilities::Deadline &deadline, bool cancel) {
+  auto cache = std::make_shared<StalledResolverCache>();
+  boost::asio::io_context ioc;
+  boost::system::error_code ec;
+  boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+    try {
+      cache->Resolve("localhost", "443", timeout, deadline, ioc, yield);
+    } catch (const boost::system::system_error &e) {
+      ec = e.code();
+    }
+  });
+  if (cancel) {
+    // Runs once the lookup is waiting.
+    boost::asio::post(ioc, [&deadline]() { deadline.Cancel(); });
+  }
+  ioc.run();
+  EXPECT_EQ(cache->handlers.size(), 1u);
+  cache->handlers.clear();
+  return ec;
+}
+}  // namespace
+
+TEST(ResolverCacheTest, LookupsEndAtTheirTimeoutWhenResolutionStalls) {
+  utilities::Deadline deadline;
+  auto ec = ResolveStalledHost(std::chrono::milliseconds(10), deadline, false);
+  ASSERT_EQ(ec, boost::asio::error::timed_out);
+}
+
+TEST(ResolverCacheTest, LookupsEndAtTheirDeadlineWhenResolutionStalls) {
+  utilities::Deadline deadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+  auto ec = ResolveStalledHost(std::chrono::seconds(5), deadline, false);
+  ASSERT_EQ(ec, boost::asio::error::timed_out);
+}
+
+TEST(ResolverCacheTest, LookupsEndWhenTheirCallIsCancelledWhileResolutionStalls) {
+  utilities::Deadline deadline;
+  auto ec = ResolveStalledHost(std::chrono::seconds(5), deadline, true);
+  ASSERT_EQ(ec, boost::asio::error::operation_aborted);
+}
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
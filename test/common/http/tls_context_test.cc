@@ -0,0 +1,90 @@
+#include "src/common/http/tls_context.h"
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <thread>
+#include "gtest/gtest.h"
+#include "test/common/http/certificate.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+
+namespace ssl = boost::asio::ssl;
+using tcp = boost::asio::ip::tcp;
+
+class TlsContextTest : public ::testing::Test {
+ protected:
+  boost::asio::io_context ioc_;
+  ssl::context server_context_;
+  tcp::acceptor acceptor_;
+
+  TlsContextTest()
+      : server_context_(ssl::context::tls_server),
+        acceptor_(ioc_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)) {
+    server_context_.use_certificate_chain(boost::asio::buffer(certificate, sizeof(certificate) - 1));
+    server_context_.use_private_key(boost::asio::buffer(private_key, sizeof(private_key) - 1), ssl::context::pem);
+  }
+
+  // Connect to the test server, which writes a single byte after its handshake. Reading the byte also processes any
+  // session ticket the server sent after the handshake.
+  // Returns the protocol version negotiated.
+  int Connect(TlsContext &client) {
+    std::thread server([this]() {
+      ssl::stream<tcp::socket> stream(ioc_, server_context_);
+      acceptor_.accept(stream.next_layer());
+      stream.handshake(ssl::stream_base::server);
+      boost::asio::write(stream, boost::asio::buffer("x", 1));
+      boost::system::error_code ec;
+      stream.shutdown(ec);
+    });
+
+    ssl::stream<tcp::socket> stream(ioc_, client.Context());
+    stream.next_layer().connect(acceptor_.local_endpoint());
+    client.PrepareResumption(stream.native_handle());
+    stream.handshake(ssl::stream_base::client);
+    client.RecordHandshake(stream.native_handle());
+    auto version = SSL_version(stream.native_handle());
+    char byte;
+    boost::asio::read(stream, boost::asio::buffer(&byte, 1));
+    boost::system::error_code ec;
+    stream.shutdown(ec);
+    server.join();
+    return version;
+  }
+};
+
+TEST_F(TlsContextTest, ResumesSessions) {
+  TlsContext client;
+  client.Context().add_certificate_authority(boost::asio::buffer(certificate, sizeof(certificate) - 1));
+
+  auto stats = client.GetStats();
+  ASSERT_EQ(stats.full_handshakes, 0u);
+  ASSERT_EQ(stats.resumed_handshakes, 0u);
+
+  // Sessions are only issued after the handshake in TLS 1.3, which is negotiated when the server supports it.
+  ASSERT_EQ(Connect(client), TLS1_3_VERSION);
+  stats = client.GetStats();
+  ASSERT_EQ(stats.full_handshakes, 1u);
+  ASSERT_EQ(stats.resumed_handshakes, 0u);
+
+  Connect(client);
+  stats = client.GetStats();
+  ASSERT_EQ(stats.full_handshakes, 1u);
+  ASSERT_EQ(stats.resumed_handshakes, 1u);
+}
+
+TEST_F(TlsContextTest, ResumesTls12Sessions) {
+  SSL_CTX_set_max_proto_version(server_context_.native_handle(), TLS1_2_VERSION);
+  TlsContext client;
+  client.Context().add_certificate_authority(boost::asio::buffer(certificate, sizeof(certificate) - 1));
+
+  ASSERT_EQ(Connect(client), TLS1_2_VERSION);
+  Connect(client);
+  auto stats = client.GetStats();
+  ASSERT_EQ(stats.full_handshakes, 1u);
+  ASSERT_EQ(stats.resumed_handshakes, 1u);
+}
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,44 @@
+#include "src/common/metrics/metrics_server.h"
+#include <boost/beast.hpp>
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace authservice {
+namespace common {
+namespace metrics {
+namespace {
+boost::beast::http::response<boost::beast::http::string_body> Get(uint16_t port, const char *target) {
+  boost::asio::io_context ioc;
+  boost::beast::tcp_stream stream(ioc);
+  stream.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), port));
+  boost::beast::http::request<boost::beast::http::empty_body> request(boost::beast::http::verb::get, target, 11);
+  boost::beast::http::write(stream, request);
+  boost::beast::flat_buffer buffer;
+  boost::beast::http::response<boost::beast::http::string_body> response;
+  boost::beast::http::read(stream, buffer, response);
+  return response;
+}
+}  // namespace
+
+TEST(MetricsServerTest, ServesMetrics) {
+  Registry registry;
+  registry.GetCounter("requests_total", "Requests.").Increment();
+  MetricsServer server("127.0.0.1", 0, registry);
+
+  auto response = Get(server.Port(), "/metrics");
+  ASSERT_EQ(response.result(), boost::beast::http::status::ok);
+  ASSERT_EQ(response[boost::beast::http::field::content_type], "text/plain; version=0.0.4");
+  ASSERT_THAT(response.body(), ::testing::HasSubstr("requests_total 1\n"));
+}
+
+TEST(MetricsServerTest, RejectsOtherPaths) {
+  Registry registry;
+  MetricsServer server("127.0.0.1", 0, registry);
+
+  auto response = Get(server.Port(), "/other");
+  ASSERT_EQ(response.result(), boost::beast::http::status::not_found);
+}
+
+}  // namespace metrics
+}  // namespace common
+}  // namespace authservice
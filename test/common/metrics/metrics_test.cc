@@ -0,0 +1,84 @@
+#include "src/common/metrics/metrics.h"
+#include <thread>
+#include <vector>
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace authservice {
+namespace common {
+namespace metrics {
+
+TEST(MetricsTest, CounterSumsAllThreads) {
+  Counter counter;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&counter]() {
+      for (int j = 0; j < 1000; ++j) {
+        counter.Increment();
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(counter.Value(), 8000);
+}
+
+TEST(MetricsTest, HistogramBucketsObservations) {
+  Histogram histogram;
+  histogram.Observe(std::chrono::nanoseconds(500));
+  histogram.Observe(std::chrono::microseconds(1));
+  histogram.Observe(std::chrono::milliseconds(3));
+  histogram.Observe(std::chrono::seconds(20));
+
+  auto snapshot = histogram.Collect();
+  ASSERT_EQ(snapshot.count, 4);
+  // Bounds are inclusive.
+  ASSERT_EQ(snapshot.buckets[0], 2);
+  ASSERT_EQ(snapshot.buckets[11], 1);
+  ASSERT_EQ(snapshot.buckets[Histogram::bucket_count], 1);
+  ASSERT_DOUBLE_EQ(snapshot.sum_seconds, 20.0030015);
+}
+
+TEST(MetricsTest, RegistryReturnsTheSameSeries) {
+  Registry registry;
+  auto &first = registry.GetCounter("requests_total", "Requests.", {{"chain", "a"}});
+  auto &second = registry.GetCounter("requests_total", "Requests.", {{"chain", "a"}});
+  auto &other = registry.GetCounter("requests_total", "Requests.", {{"chain", "b"}});
+  ASSERT_EQ(&first, &second);
+  ASSERT_NE(&first, &other);
+  ASSERT_THROW(registry.GetHistogram("requests_total", "Requests."), std::runtime_error);
+}
+
+TEST(MetricsTest, SerializesTextFormat) {
+  Registry registry;
+  registry.GetCounter("requests_total", "Requests.", {{"chain", "a\"b"}}).Increment(3);
+  registry.GetHistogram("duration_seconds", "Durations.").Observe(std::chrono::milliseconds(1));
+
+  auto text = registry.Serialize();
+  ASSERT_THAT(text, ::testing::HasSubstr("# HELP requests_total Requests.\n"
+                                         "# TYPE requests_total counter\n"
+                                         "requests_total{chain=\"a\\\"b\"} 3\n"));
+  ASSERT_THAT(text, ::testing::HasSubstr("# TYPE duration_seconds histogram\n"));
+  ASSERT_THAT(text, ::testing::HasSubstr("duration_seconds_bucket{le=\"0.0005\"} 0\n"
+                                         "duration_seconds_bucket{le=\"0.001\"} 1\n"));
+  ASSERT_THAT(text, ::testing::HasSubstr("duration_seconds_bucket{le=\"+Inf\"} 1\n"
+                                         "duration_seconds_sum 0.001\n"
+                                         "duration_seconds_count 1\n"));
+}
+
+TEST(MetricsTest, SumsCallbacksUntilRemoved) {
+  Registry registry;
+  auto first = registry.AddCallback(Registry::Type::gauge, "entries", "Entries.", {}, []() { return 2; });
+  {
+    auto second = registry.AddCallback(Registry::Type::gauge, "entries", "Entries.", {}, []() { return 3; });
+    ASSERT_THAT(registry.Serialize(), ::testing::HasSubstr("# TYPE entries gauge\nentries 5\n"));
+  }
+  ASSERT_THAT(registry.Serialize(), ::testing::HasSubstr("entries 2\n"));
+  first = CallbackHandle();
+  ASSERT_EQ(registry.Serialize(), "");
+}
+
+}  // namespace metrics
+}  // namespace common
+}  // namespace authservice
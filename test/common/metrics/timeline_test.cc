@@ -0,0 +1,83 @@
+#include "src/common/metrics/timeline.h"
+#include <sstream>
+#include <thread>
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "spdlog/sinks/ostream_sink.h"
+
+namespace authservice {
+namespace common {
+namespace metrics {
+
+TEST(TimelineTest, DropsMarksBeyondCapacity) {
+  Timeline timeline;
+  for (size_t i = 0; i < Timeline::capacity + 3; ++i) {
+    timeline.Record(Stage::matched);
+  }
+  ASSERT_EQ(timeline.Count(), Timeline::capacity);
+  timeline.Reset();
+  ASSERT_EQ(timeline.Count(), 0);
+}
+
+TEST(TimelineTest, CurrentIsPerThread) {
+  Timeline timeline;
+  Timeline::SetCurrent(&timeline);
+  ASSERT_EQ(Timeline::Current(), &timeline);
+  std::thread([]() { ASSERT_EQ(Timeline::Current(), nullptr); }).join();
+  Timeline::SetCurrent(nullptr);
+  ASSERT_EQ(Timeline::Current(), nullptr);
+}
+
+TEST(TimelineTest, RecordObservesTimeFromPreviousMark) {
+  Registry registry;
+  TimelineRecorder recorder(registry, 1, nullptr);
+  Timeline timeline;
+  timeline.Record(Stage::received);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  timeline.Record(Stage::matched);
+  timeline.Record(Stage::completed);
+  recorder.Record(timeline);
+
+  auto matched = registry.GetHistogram("authservice_stage_duration_seconds", "", {{"stage", "matched"}}).Collect();
+  ASSERT_EQ(matched.count, 1);
+  ASSERT_GE(matched.sum_seconds, 0.002);
+  auto completed = registry.GetHistogram("authservice_stage_duration_seconds", "", {{"stage", "completed"}}).Collect();
+  ASSERT_EQ(completed.count, 1);
+  // The first mark only starts the timeline.
+  auto received = registry.GetHistogram("authservice_stage_duration_seconds", "", {{"stage", "received"}}).Collect();
+  ASSERT_EQ(received.count, 0);
+}
+
+TEST(TimelineTest, WritesSampledTimelines) {
+  std::ostringstream out;
+  auto sink = std::make_shared<spdlog::logger>("timelines", std::make_shared<spdlog::sinks::ostream_sink_mt>(out));
+  sink->set_pattern("%v");
+  Registry registry;
+  TimelineRecorder recorder(registry, 3, sink);
+  Timeline timeline;
+  timeline.Record(Stage::received);
+  timeline.Record(Stage::sent);
+  for (int i = 0; i < 7; ++i) {
+    recorder.Record(timeline);
+  }
+
+  std::istringstream lines(out.str());
+  std::string line;
+  int count = 0;
+  while (std::getline(lines, line)) {
+    ++count;
+    ASSERT_THAT(line, ::testing::MatchesRegex(
+                          "\\{\"start_unix_micros\":[0-9]+,\"marks\":\\[\\{\"stage\":\"received\",\"nanoseconds\":0\\},"
+                          "\\{\"stage\":\"sent\",\"nanoseconds\":[0-9]+\\}\\]\\}"));
+  }
+  ASSERT_EQ(count, 2);
+}
+
+TEST(TimelineTest, ToJsonOfEmptyTimeline) {
+  Timeline timeline;
+  ASSERT_EQ(TimelineRecorder::ToJson(timeline), "{\"start_unix_micros\":0,\"marks\":[]}");
+}
+
+}  // namespace metrics
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,135 @@
+#include "src/common/session/session_cache.h"
+
+#include <atomic>
+#include <thread>
+
+#include "absl/time/clock.h"
+#include "gtest/gtest.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+namespace {
+SessionCache::Loader Returning(const std::string &value, int &calls) {
+  return [value, &calls](absl::Time &) -> absl::optional<std::string> {
+    ++calls;
+    return value;
+  };
+}
+}  // namespace
+
+TEST(SessionCacheTest, LoadsOnMissAndServesHits) {
+  SessionCache cache(1024 * 1024, absl::Hours(1));
+  auto calls = 0;
+
+  ASSERT_EQ(*cache.Get("cookie", Returning("token", calls)), "token");
+  ASSERT_EQ(*cache.Get("cookie", Returning("other", calls)), "token");
+  ASSERT_EQ(calls, 1);
+
+  auto stats = cache.GetStats();
+  ASSERT_EQ(stats.hits, 1u);
+  ASSERT_EQ(stats.misses, 1u);
+  ASSERT_EQ(stats.evictions, 0u);
+}
+
+TEST(SessionCacheTest, CountsInTheSeriesItIsGiven) {
+  metrics::Counter hits, misses, evictions;
+  SessionCache::Metrics series = {&hits, &misses, &evictions};
+  auto calls = 0;
+  {
+    SessionCache cache(1024 * 1024, absl::Hours(1), SessionCache::default_shards, series);
+    cache.Get("cookie", Returning("token", calls));
+    cache.Get("cookie", Returning("token", calls));
+  }
+  // A cache replacing the first, as on a reload, keeps counting from where it stopped.
+  SessionCache cache(1024 * 1024, absl::Hours(1), SessionCache::default_shards, series);
+  cache.Get("cookie", Returning("token", calls));
+
+  ASSERT_EQ(hits.Value(), 1u);
+  ASSERT_EQ(misses.Value(), 2u);
+  ASSERT_EQ(evictions.Value(), 0u);
+}
+
+TEST(SessionCacheTest, DoesNotCacheAbsentValues) {
+  SessionCache cache(1024 * 1024, absl::Hours(1));
+  auto calls = 0;
+  SessionCache::Loader absent = [&calls](absl::Time &) {
+    ++calls;
+    return absl::optional<std::string>();
+  };
+
+  ASSERT_FALSE(cache.Get("cookie", absent).has_value());
+  ASSERT_FALSE(cache.Get("cookie", absent).has_value());
+  ASSERT_EQ(calls, 2);
+}
+
+TEST(SessionCacheTest, ReloadsExpiredEntries) {
+  SessionCache cache(1024 * 1024, absl::Hours(1));
+  auto calls = 0;
+  SessionCache::Loader expired = [&calls](absl::Time &expiry) {
+    ++calls;
+    expiry = absl::Now() - absl::Seconds(1);
+    return absl::optional<std::string>("token");
+  };
+
+  ASSERT_EQ(*cache.Get("cookie", expired), "token");
+  ASSERT_EQ(*cache.Get("cookie", expired), "token");
+  ASSERT_EQ(calls, 2);
+}
+
+TEST(SessionCacheTest, EvictsLeastRecentlyUsed) {
+  // Room for two small entries in a single shard.
+  SessionCache cache(400, absl::Hours(1), 1);
+  auto calls = 0;
+
+  cache.Get("a", Returning("1", calls));
+  cache.Get("b", Returning("2", calls));
+  cache.Get("a", Returning("1", calls));
+  cache.Get("c", Returning("3", calls));
+  ASSERT_EQ(calls, 3);
+  ASSERT_EQ(cache.GetStats().evictions, 1u);
+
+  // b was least recently used, so it was evicted while a was kept.
+  cache.Get("a", Returning("1", calls));
+  ASSERT_EQ(calls, 3);
+  cache.Get("b", Returning("2", calls));
+  ASSERT_EQ(calls, 4);
+}
+
+TEST(SessionCacheTest, CoalescesConcurrentMisses) {
+  SessionCache cache(1024 * 1024, absl::Hours(1));
+  std::atomic<int> calls(0);
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  SessionCache::Loader slow = [&calls, released](absl::Time &) {
+    ++calls;
+    released.wait();
+    return absl::optional<std::string>("token");
+  };
+
+  std::vector<std::thread> threads;
+  std::vector<absl::optional<std::string>> results(8);
+  for (size_t i = 0; i < results.size(); ++i) {
+    threads.emplace_back([&cache, &slow, &results, i]() {
+      results[i] = cache.Get("cookie", slow);
+    });
+  }
+  // Let every thread reach the cache before the single load completes.
+  while (cache.GetStats().misses < results.size()) {
+    std::this_thread::yield();
+  }
+  release.set_value();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(calls, 1);
+  for (const auto &result : results) {
+    ASSERT_EQ(*result, "token");
+  }
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
@@ -23,6 +23,58 @@ TEST(TokenEncryptorTest, SealAndOpen) {
               plaintext);
   }
 }
+
+TEST(TokenEncryptorTest, SealAndOpenV1) {
+  auto encryptor = TokenEncryptor::Create("secret", EncryptionAlg::AES256GCM,
+                                          HKDFHash::SHA256, TokenFormat::V1);
+  auto ciphertext = encryptor->Encrypt("token");
+  ASSERT_EQ(ciphertext.find('.'), std::string::npos);
+  ASSERT_EQ(encryptor->Decrypt(ciphertext), absl::optional<std::string>("token"));
+}
+
+TEST(TokenEncryptorTest, DecryptsBothFormats) {
+  auto v1 = TokenEncryptor::Create("secret", EncryptionAlg::AES256GCM,
+                                   HKDFHash::SHA256, TokenFormat::V1);
+  auto v2 = TokenEncryptor::Create("secret", EncryptionAlg::AES256GCM,
+                                   HKDFHash::SHA256, TokenFormat::V2);
+  ASSERT_EQ(v2->Decrypt(v1->Encrypt("token")),
+            absl::optional<std::string>("token"));
+  ASSERT_EQ(v1->Decrypt(v2->Encrypt("token")),
+            absl::optional<std::string>("token"));
+}
+
+TEST(TokenEncryptorTest, ProducesV1ByDefault) {
+  auto encryptor = TokenEncryptor::Create("secret");
+  ASSERT_EQ(encryptor->Encrypt("token").find('.'), std::string::npos);
+}
+
+TEST(TokenEncryptorTest, V2IsVersionedAndShorter) {
+  auto v1 = TokenEncryptor::Create("secret", EncryptionAlg::AES256GCM,
+                                   HKDFHash::SHA256, TokenFormat::V1);
+  auto v2 = TokenEncryptor::Create("secret", EncryptionAlg::AES256GCM,
+                                   HKDFHash::SHA256, TokenFormat::V2);
+  std::string token(256, 't');
+  auto v1_ciphertext = v1->Encrypt(token);
+  auto v2_ciphertext = v2->Encrypt(token);
+  ASSERT_EQ(v2_ciphertext.substr(0, 3), "v2.");
+  ASSERT_LT(v2_ciphertext.size() + 32, v1_ciphertext.size());
+  // Random GCM nonces make every encryption of the same token different.
+  ASSERT_NE(v2_ciphertext, v2->Encrypt(token));
+}
+
+TEST(TokenEncryptorTest, V2RejectsTamperedTokens) {
+  auto encryptor = TokenEncryptor::Create("secret", EncryptionAlg::AES256GCM,
+                                          HKDFHash::SHA256, TokenFormat::V2);
+  auto ciphertext = encryptor->Encrypt("token");
+
+  auto tampered = ciphertext;
+  tampered[10] = tampered[10] == 'A' ? 'B' : 'A';
+  ASSERT_FALSE(encryptor->Decrypt(tampered).has_value());
+  ASSERT_FALSE(encryptor->Decrypt("v2.").has_value());
+  ASSERT_FALSE(encryptor->Decrypt("v2.!!!").has_value());
+  ASSERT_FALSE(TokenEncryptor::Create("other-secret")->Decrypt(ciphertext).has_value());
+}
+
 }  // namespace session
 }  // namespace common
 }  // namespace authservice
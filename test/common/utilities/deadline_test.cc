@@ -0,0 +1,42 @@
+#include "src/common/utilities/deadline.h"
+#include "gtest/gtest.h"
+
+namespace authservice {
+namespace common {
+namespace utilities {
+
+TEST(DeadlineTest, CancelRunsRegisteredCallbacks) {
+  Deadline deadline;
+  int calls = 0;
+  auto registration = deadline.OnCancel([&calls]() { ++calls; });
+  ASSERT_EQ(calls, 0);
+
+  deadline.Cancel();
+  deadline.Cancel();
+  ASSERT_TRUE(deadline.Expired());
+  ASSERT_EQ(calls, 1);
+}
+
+TEST(DeadlineTest, CancelSkipsCallbacksNoLongerRegistered) {
+  Deadline deadline;
+  int calls = 0;
+  {
+    auto registration = deadline.OnCancel([&calls]() { ++calls; });
+  }
+
+  deadline.Cancel();
+  ASSERT_EQ(calls, 0);
+}
+
+TEST(DeadlineTest, OnCancelRunsCallbackOfCancelledCall) {
+  Deadline deadline;
+  deadline.Cancel();
+  int calls = 0;
+
+  auto registration = deadline.OnCancel([&calls]() { ++calls; });
+  ASSERT_EQ(calls, 1);
+}
+
+}  // namespace utilities
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,99 @@
+#include "src/config/config_watcher.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "gtest/gtest.h"
+
+namespace authservice {
+namespace config {
+namespace {
+std::string ReadFixture() {
+  std::ifstream file("test/fixtures/valid-config.json");
+  std::stringstream buf;
+  buf << file.rdbuf();
+  return buf.str();
+}
+
+void WriteFile(const std::string &path, const std::string &contents) {
+  std::ofstream file(path, std::ios::trunc);
+  file << contents;
+}
+
+// Wait for a condition, polling it for up to five seconds.
+template <typename Condition>
+bool WaitFor(Condition condition) {
+  for (int i = 0; i < 500 && !condition(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return condition();
+}
+
+class ConfigWatcherTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char directory[] = "/tmp/config_watcher_test.XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    directory_ = directory;
+    path_ = directory_ + "/config.json";
+    WriteFile(path_, ReadFixture());
+  }
+
+  void TearDown() override {
+    unlink(path_.c_str());
+    rmdir(directory_.c_str());
+  }
+
+  std::string directory_;
+  std::string path_;
+};
+}  // namespace
+
+TEST_F(ConfigWatcherTest, AppliesChangedConfig) {
+  std::mutex mutex;
+  std::vector<int32_t> ports;
+  ConfigWatcher watcher(path_, [&](const Config &config) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ports.push_back(config.listen_port());
+  });
+
+  auto changed = ReadFixture();
+  auto port = changed.find("10003");
+  ASSERT_NE(port, std::string::npos);
+  changed.replace(port, 5, "10004");
+  WriteFile(path_, changed);
+
+  ASSERT_TRUE(WaitFor([&watcher]() { return watcher.GetStats().reloads == 1; }));
+  std::lock_guard<std::mutex> lock(mutex);
+  ASSERT_EQ(ports, std::vector<int32_t>{10004});
+  ASSERT_EQ(watcher.GetStats().failures, 0);
+}
+
+TEST_F(ConfigWatcherTest, RejectsInvalidConfig) {
+  std::atomic<int> applied(0);
+  ConfigWatcher watcher(path_, [&applied](const Config &) { ++applied; });
+
+  WriteFile(path_, "{\"chains\": [");
+
+  ASSERT_TRUE(WaitFor([&watcher]() { return watcher.GetStats().failures == 1; }));
+  ASSERT_EQ(applied, 0);
+  ASSERT_EQ(watcher.GetStats().reloads, 0);
+}
+
+TEST_F(ConfigWatcherTest, CountsFailedCallbacks) {
+  ConfigWatcher watcher(path_, [](const Config &) { throw std::runtime_error("cannot build chains"); });
+
+  // Replace the file as an editor would, rather than writing it in place.
+  auto replacement = directory_ + "/config.json.tmp";
+  WriteFile(replacement, ReadFixture() + "\n");
+  ASSERT_EQ(rename(replacement.c_str(), path_.c_str()), 0);
+
+  ASSERT_TRUE(WaitFor([&watcher]() { return watcher.GetStats().failures == 1; }));
+  ASSERT_EQ(watcher.GetStats().reloads, 0);
+}
+
+}  // namespace config
+}  // namespace authservice
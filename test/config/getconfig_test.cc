@@ -53,6 +53,49 @@ TEST(GetConfigTest, ReturnsTheConfig) {
   ASSERT_EQ(oidc.access_token().header(), "x-access-token");
 }
 
+TEST(GetConfigTest, GetConfiguredLogLevel) {
+  authservice::config::Config config;
+  ASSERT_EQ(GetConfiguredLogLevel(config), spdlog::level::level_enum::info);
+
+  config.set_log_level("trace");
+  ASSERT_EQ(GetConfiguredLogLevel(config), spdlog::level::level_enum::trace);
+}
+
+TEST(GetConfigTest, GetConfiguredCompletionQueues) {
+  authservice::config::Config config;
+  ASSERT_GE(GetConfiguredCompletionQueues(config), 1u);
+
+  config.set_completion_queues(3);
+  ASSERT_EQ(GetConfiguredCompletionQueues(config), 3u);
+}
+
+TEST(GetConfigTest, GetConfiguredPendingRequests) {
+  authservice::config::Config config;
+  ASSERT_EQ(GetConfiguredPendingRequests(config), 16u);
+
+  config.set_pending_requests(64);
+  ASSERT_EQ(GetConfiguredPendingRequests(config), 64u);
+}
+
+TEST(GetConfigTest, GetConfiguredLogQueue) {
+  authservice::config::Config config;
+  ASSERT_EQ(GetConfiguredLogQueueSize(config), 8192u);
+  ASSERT_EQ(GetConfiguredLogOverflowPolicy(config), spdlog::async_overflow_policy::block);
+
+  config.set_log_queue_size(1024);
+  config.set_log_overflow_policy("drop");
+  ASSERT_EQ(GetConfiguredLogQueueSize(config), 1024u);
+  ASSERT_EQ(GetConfiguredLogOverflowPolicy(config), spdlog::async_overflow_policy::overrun_oldest);
+}
+
+TEST(GetConfigTest, GetConfiguredTimelineSampleRate) {
+  authservice::config::Config config;
+  ASSERT_EQ(GetConfiguredTimelineSampleRate(config), 1000u);
+
+  config.mutable_metrics()->set_timelines_sample_rate(10);
+  ASSERT_EQ(GetConfiguredTimelineSampleRate(config), 10u);
+}
+
 TEST(GetConfigTest, ValidateOidcConfigThrowsForInvalidConfig) {
   ASSERT_THROW(GetConfig("test/fixtures/invalid-config.json"),
                std::runtime_error);
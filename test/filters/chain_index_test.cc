@@ -0,0 +1,144 @@
+#include "src/filters/chain_index.h"
+#include <random>
+#include "gtest/gtest.h"
+#include "src/filters/filter_chain.h"
+
+namespace authservice {
+namespace filters {
+namespace {
+config::FilterChain *AddChain(config::Config &config, const char *header, const char *prefix,
+                              const char *equality) {
+  auto chain = config.add_chains();
+  chain->set_name("chain" + std::to_string(config.chains_size() - 1));
+  if (header != nullptr) {
+    chain->mutable_match()->set_header(header);
+    if (prefix != nullptr) {
+      chain->mutable_match()->set_prefix(prefix);
+    } else {
+      chain->mutable_match()->set_equality(equality);
+    }
+  }
+  return chain;
+}
+
+::envoy::service::auth::v2::CheckRequest Request(
+    std::initializer_list<std::pair<const std::string, std::string>> headers) {
+  ::envoy::service::auth::v2::CheckRequest request;
+  auto map = request.mutable_attributes()->mutable_request()->mutable_http()->mutable_headers();
+  for (const auto &header : headers) {
+    map->insert({header.first, header.second});
+  }
+  return request;
+}
+}  // namespace
+
+TEST(ChainIndexTest, Empty) {
+  config::Config config;
+  ChainIndex index(config.chains());
+  auto request = Request({{"x-tenant", "a"}});
+  ASSERT_FALSE(index.Find(&request).has_value());
+}
+
+TEST(ChainIndexTest, FindsEqualityAndPrefixMatches) {
+  config::Config config;
+  AddChain(config, "x-tenant", nullptr, "tenant1");
+  AddChain(config, "x-tenant", "group-", nullptr);
+  AddChain(config, "x-other", nullptr, "tenant1");
+  ChainIndex index(config.chains());
+
+  auto equal = Request({{"x-tenant", "tenant1"}});
+  ASSERT_EQ(index.Find(&equal), absl::make_optional<size_t>(0));
+  auto prefixed = Request({{"x-tenant", "group-a"}});
+  ASSERT_EQ(index.Find(&prefixed), absl::make_optional<size_t>(1));
+  auto other = Request({{"x-other", "tenant1"}});
+  ASSERT_EQ(index.Find(&other), absl::make_optional<size_t>(2));
+  auto longer = Request({{"x-tenant", "tenant12"}});
+  ASSERT_FALSE(index.Find(&longer).has_value());
+  auto missing = Request({{"x-unknown", "tenant1"}});
+  ASSERT_FALSE(index.Find(&missing).has_value());
+}
+
+TEST(ChainIndexTest, FirstMatchWins) {
+  config::Config config;
+  AddChain(config, "x-tenant", "abc", nullptr);
+  AddChain(config, "x-tenant", "ab", nullptr);
+  AddChain(config, "x-tenant", nullptr, "abcd");
+  AddChain(config, "x-tenant", "a", nullptr);
+  AddChain(config, nullptr, nullptr, nullptr);
+  AddChain(config, "x-tenant", nullptr, "xyz");
+  ChainIndex index(config.chains());
+
+  auto longest = Request({{"x-tenant", "abcd"}});
+  ASSERT_EQ(index.Find(&longest), absl::make_optional<size_t>(0));
+  auto shorter = Request({{"x-tenant", "abd"}});
+  ASSERT_EQ(index.Find(&shorter), absl::make_optional<size_t>(1));
+  auto shortest = Request({{"x-tenant", "a"}});
+  ASSERT_EQ(index.Find(&shortest), absl::make_optional<size_t>(3));
+  // The catch-all chain precedes the equality match.
+  auto any = Request({{"x-tenant", "xyz"}});
+  ASSERT_EQ(index.Find(&any), absl::make_optional<size_t>(4));
+}
+
+TEST(ChainIndexTest, FindsChainNamedByContextExtension) {
+  config::Config config;
+  AddChain(config, "x-tenant", nullptr, "tenant1");
+  AddChain(config, "x-tenant", nullptr, "tenant2");
+  ChainIndex index(config.chains(), "authservice-chain");
+
+  auto named = Request({{"x-tenant", "tenant1"}});
+  (*named.mutable_attributes()->mutable_context_extensions())["authservice-chain"] = "chain1";
+  ASSERT_EQ(index.Find(&named), absl::make_optional<size_t>(1));
+
+  // Unknown names and other extensions fall back to matching headers.
+  auto unknown = Request({{"x-tenant", "tenant1"}});
+  (*unknown.mutable_attributes()->mutable_context_extensions())["authservice-chain"] = "chain9";
+  ASSERT_EQ(index.Find(&unknown), absl::make_optional<size_t>(0));
+  auto other = Request({{"x-tenant", "tenant2"}});
+  (*other.mutable_attributes()->mutable_context_extensions())["other"] = "chain0";
+  ASSERT_EQ(index.Find(&other), absl::make_optional<size_t>(1));
+}
+
+TEST(ChainIndexTest, AgreesWithMatches) {
+  const char *headers[] = {"x-a", "x-b", "x-c"};
+  const char *values[] = {"", "a", "ab", "abc", "b", "ba", "bab", "c"};
+  std::mt19937 random(42);
+  auto pick = [&random](size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(random); };
+
+  for (int round = 0; round < 50; ++round) {
+    config::Config config;
+    std::vector<std::unique_ptr<FilterChainImpl>> chains;
+    auto count = 1 + pick(20);
+    for (size_t i = 0; i < count; ++i) {
+      auto header = headers[pick(3)];
+      auto value = values[pick(8)];
+      switch (pick(5)) {
+        case 0:
+          AddChain(config, nullptr, nullptr, nullptr);
+          break;
+        case 1:
+        case 2:
+          AddChain(config, header, value, nullptr);
+          break;
+        default:
+          AddChain(config, header, nullptr, value);
+      }
+      chains.emplace_back(new FilterChainImpl(config.chains(static_cast<int>(i))));
+    }
+    ChainIndex index(config.chains());
+
+    for (int lookup = 0; lookup < 20; ++lookup) {
+      auto request = Request({{headers[pick(3)], values[pick(8)]}, {headers[pick(3)], values[pick(8)]}});
+      absl::optional<size_t> expected;
+      for (size_t i = 0; i < chains.size(); ++i) {
+        if (chains[i]->Matches(&request)) {
+          expected = i;
+          break;
+        }
+      }
+      ASSERT_EQ(index.Find(&request), expected);
+    }
+  }
+}
+
+}  // namespace filters
+}  // namespace authservice
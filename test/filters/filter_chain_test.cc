@@ -1,6 +1,9 @@
 #include "src/filters/filter_chain.h"
+#include <future>
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "src/filters/pipe.h"
+#include "test/common/http/mocks.h"
 
 namespace authservice {
 namespace filters {
@@ -59,15 +62,43 @@ TEST(FilterChainTest, MatchesEquality) {
   ASSERT_TRUE(chain2.Matches(&request2));
 }
 
-TEST(FilterChainTest, New) {
+TEST(FilterChainTest, Instance) {
       auto configuration = std::unique_ptr<authservice::config::FilterChain>(new authservice::config::FilterChain);
       auto filter_config = configuration->mutable_filters()->Add();
       filter_config->mutable_oidc()->set_jwks("some-value");
       filter_config->mutable_oidc()->set_cryptor_secret("some-secret");
 
       FilterChainImpl chain(*configuration);
-      auto instance = chain.New();
-      ASSERT_TRUE(dynamic_cast<Pipe*>(instance.get()) != nullptr);
+      auto &instance = chain.Instance();
+      ASSERT_TRUE(dynamic_cast<Pipe*>(&instance) != nullptr);
+      // The instance is built once and shared across requests.
+      ASSERT_EQ(&instance, &chain.Instance());
+}
+
+TEST(FilterChainTest, FetchesKeysWithTheGivenHttpClient) {
+  auto configuration = std::unique_ptr<authservice::config::FilterChain>(new authservice::config::FilterChain);
+  auto filter_config = configuration->mutable_filters()->Add();
+  filter_config->mutable_oidc()->mutable_jwks_uri()->set_hostname("acme-idp.tld");
+  filter_config->mutable_oidc()->mutable_jwks_fetcher()->set_refresh_interval(3600);
+  filter_config->mutable_oidc()->mutable_jwks_fetcher()->set_min_refetch_interval(3600);
+  filter_config->mutable_oidc()->set_cryptor_secret("some-secret");
+
+  std::promise<void> fetched;
+  auto http = std::make_shared<common::http::http_mock>();
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_, ::testing::_, ::testing::_, ::testing::_))
+      .WillOnce(::testing::InvokeWithoutArgs([&fetched]() {
+        fetched.set_value();
+        return common::http::response_t();
+      }));
+
+  FilterChainImpl chain(*configuration, http);
+  ASSERT_EQ(fetched.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+}
+
+TEST(FilterChainTest, UnsupportedFilterType) {
+      auto configuration = std::unique_ptr<authservice::config::FilterChain>(new authservice::config::FilterChain);
+      configuration->mutable_filters()->Add();
+      ASSERT_THROW(FilterChainImpl chain(*configuration), std::runtime_error);
 }
 
 }  // namespace filters
@@ -0,0 +1,216 @@
+#include "src/filters/oidc/jwks_provider.h"
+#include <future>
+#include <mutex>
+#include <set>
+#include <thread>
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "test/common/http/mocks.h"
+
+namespace authservice {
+namespace filters {
+namespace oidc {
+namespace {
+const char *jwks = R"({"keys":[{"kty":"RSA","alg":"RS256","use":"sig","kid":"key1","e":"AQAB","n":"nzyis1ZjfNB0bBgKFMSvvkTtwlvBsaJq7S5wA-kzeVOVpVWwkWdVha4s38XM_pa_yr47av7-z3VTmvDRyAHcaT92whREFpLv9cj5lTeJSibyr_Mrm_YtjCZVWgaOYIhwrXwKLqPr_11inWsAkfIytvHWTxZYEcXLgAXFuUuaS3uF9gEiNQwzGTU1v0FqkqTBr4B8nW3HCN47XUu0t8Y0e-lf4s4OxQawWD79J9_5d3Ry0vbV3Am1FtGJiJvOwRsIfVChDpYStTcHTCMqtvWbV6L11BWkpzGXSW4Hv43qa-GSYOD2QU68Mb59oSk2OB-BtOLpJofmbGEGgvmwyCI9Mw"}]})";
+
+// Respond with the key set after a short delay, so concurrent refetches overlap.
+common::http::response_t KeySetResponse() {
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  common::http::response_t response(
+      new beast::http::response<beast::http::string_body>(beast::http::status::ok, 11));
+  response->body() = jwks;
+  return response;
+}
+
+void WaitForKeys(JwksProvider &provider) {
+  for (int i = 0; i < 500 && provider.Keys() == nullptr; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_NE(provider.Keys(), nullptr);
+}
+
+// Call Refetch from the given number of co-routines at once.
+void Refetch(JwksProvider &provider, size_t concurrency) {
+  boost::asio::io_context ioc;
+  common::utilities::Deadline deadline(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+  for (size_t i = 0; i < concurrency; ++i) {
+    boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+      provider.Refetch(deadline, ioc, yield);
+    });
+  }
+  ioc.run();
+}
+}  // namespace
+
+TEST(JwksProviderTest, StaticKeys) {
+  auto provider = StaticJwksProvider::Create(jwks);
+  ASSERT_NE(provider->Keys(), nullptr);
+  ASSERT_EQ(provider->Keys()->getStatus(), google::jwt_verify::Status::Ok);
+}
+
+TEST(JwksProviderTest, FetchesKeysAtStartup) {
+  auto http = std::make_shared<common::http::http_mock>();
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_, ::testing::_, ::testing::_, ::testing::_))
+      .WillOnce(::testing::InvokeWithoutArgs(KeySetResponse));
+
+  RemoteJwksProvider provider(authservice::config::common::Endpoint(), http, std::chrono::hours(1),
+                              std::chrono::hours(1), std::make_shared<JwksRefresher>());
+  WaitForKeys(provider);
+  ASSERT_EQ(provider.Keys()->getStatus(), google::jwt_verify::Status::Ok);
+}
+
+TEST(JwksProviderTest, ConcurrentRefetchesShareOneFetch) {
+  auto http = std::make_shared<common::http::http_mock>();
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_, ::testing::_, ::testing::_, ::testing::_))
+      .Times(2)
+      .WillRepeatedly(::testing::InvokeWithoutArgs(KeySetResponse));
+
+  RemoteJwksProvider provider(authservice::config::common::Endpoint(), http, std::chrono::hours(1),
+                              std::chrono::seconds(0), std::make_shared<JwksRefresher>());
+  WaitForKeys(provider);
+  auto initial = provider.Keys();
+
+  Refetch(provider, 8);
+  ASSERT_NE(provider.Keys(), initial);
+}
+
+TEST(JwksProviderTest, RefetchesAreRateLimited) {
+  auto http = std::make_shared<common::http::http_mock>();
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_, ::testing::_, ::testing::_, ::testing::_))
+      .WillOnce(::testing::InvokeWithoutArgs(KeySetResponse));
+
+  RemoteJwksProvider provider(authservice::config::common::Endpoint(), http, std::chrono::hours(1),
+                              std::chrono::hours(1), std::make_shared<JwksRefresher>());
+  WaitForKeys(provider);
+  auto initial = provider.Keys();
+
+  Refetch(provider, 1);
+  ASSERT_EQ(provider.Keys(), initial);
+}
+
+TEST(JwksProviderTest, RefetchStopsWaitingAtTheDeadline) {
+  auto http = std::make_shared<common::http::http_mock>();
+  std::promise<void> refetching;
+  std::promise<void> done;
+  auto finished = done.get_future().share();
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_, ::testing::_, ::testing::_, ::testing::_))
+      .WillOnce(::testing::InvokeWithoutArgs(KeySetResponse))
+      .WillOnce(::testing::InvokeWithoutArgs([&refetching, finished]() {
+        refetching.set_value();
+        finished.wait();
+        return KeySetResponse();
+      }));
+
+  RemoteJwksProvider provider(authservice::config::common::Endpoint(), http, std::chrono::hours(1),
+                              std::chrono::seconds(0), std::make_shared<JwksRefresher>());
+  WaitForKeys(provider);
+
+  boost::asio::io_context ioc;
+  common::utilities::Deadline deadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(100));
+  boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) { provider.Refetch(deadline, ioc, yield); });
+  auto started = std::chrono::steady_clock::now();
+  ioc.run();
+  ASSERT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(5));
+
+  refetching.get_future().wait();
+  done.set_value();
+}
+
+TEST(JwksProviderTest, RefetchStopsWaitingWhenTheCallIsCancelled) {
+  auto http = std::make_shared<common::http::http_mock>();
+  std::promise<void> refetching;
+  std::promise<void> done;
+  auto finished = done.get_future().share();
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_, ::testing::_, ::testing::_, ::testing::_))
+      .WillOnce(::testing::InvokeWithoutArgs(KeySetResponse))
+      .WillOnce(::testing::InvokeWithoutArgs([&refetching, finished]() {
+        refetching.set_value();
+        finished.wait();
+        return KeySetResponse();
+      }));
+
+  RemoteJwksProvider provider(authservice::config::common::Endpoint(), http, std::chrono::hours(1),
+                              std::chrono::seconds(0), std::make_shared<JwksRefresher>());
+  WaitForKeys(provider);
+
+  boost::asio::io_context ioc;
+  common::utilities::Deadline deadline;
+  boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) { provider.Refetch(deadline, ioc, yield); });
+  std::thread canceller([&deadline]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    deadline.Cancel();
+  });
+  auto started = std::chrono::steady_clock::now();
+  ioc.run();
+  ASSERT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(5));
+  canceller.join();
+
+  refetching.get_future().wait();
+  done.set_value();
+}
+
+TEST(JwksProviderTest, ProvidersShareTheRefresherThread) {
+  auto refresher = std::make_shared<JwksRefresher>();
+  auto http = std::make_shared<common::http::http_mock>();
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_, ::testing::_, ::testing::_, ::testing::_))
+      .Times(2)
+      .WillRepeatedly(::testing::Invoke([&](const authservice::config::common::Endpoint &,
+                                            const std::map<absl::string_view, absl::string_view> &,
+                                            const common::utilities::Deadline &, boost::asio::io_context &ioc,
+                                            boost::asio::yield_context) {
+        EXPECT_EQ(&ioc, &refresher->Context());
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.insert(std::this_thread::get_id());
+        return KeySetResponse();
+      }));
+
+  RemoteJwksProvider first(authservice::config::common::Endpoint(), http, std::chrono::hours(1),
+                           std::chrono::hours(1), refresher);
+  RemoteJwksProvider second(authservice::config::common::Endpoint(), http, std::chrono::hours(1),
+                            std::chrono::hours(1), refresher);
+  WaitForKeys(first);
+  WaitForKeys(second);
+  ASSERT_EQ(threads.size(), 1u);
+}
+
+TEST(JwksProviderTest, DestructionAbandonsFetchInProgress) {
+  auto refresher = std::make_shared<JwksRefresher>();
+  auto http = std::make_shared<common::http::http_mock>();
+  std::promise<void> fetching;
+  std::promise<void> abandoned;
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_, ::testing::_, ::testing::_, ::testing::_))
+      .WillOnce(::testing::Invoke([&fetching, &abandoned](const authservice::config::common::Endpoint &,
+                                                          const std::map<absl::string_view, absl::string_view> &,
+                                                          const common::utilities::Deadline &deadline,
+                                                          boost::asio::io_context &ioc,
+                                                          boost::asio::yield_context yield) {
+        // A request to an OIDC Provider that does not answer, given up when
+        // its deadline is cancelled as the HTTP client does.
+        boost::asio::steady_timer unanswered(ioc, std::chrono::hours(1));
+        auto registration = deadline.OnCancel([&ioc, &unanswered]() {
+          boost::asio::post(ioc, [&unanswered]() { unanswered.cancel(); });
+        });
+        fetching.set_value();
+        boost::system::error_code ec;
+        unanswered.async_wait(yield[ec]);
+        abandoned.set_value();
+        return common::http::response_t();
+      }));
+
+  auto started = std::chrono::steady_clock::now();
+  {
+    RemoteJwksProvider provider(authservice::config::common::Endpoint(), http, std::chrono::hours(1),
+                                std::chrono::hours(1), refresher);
+    fetching.get_future().wait();
+  }
+  // Neither the destruction nor the fetch waits for the endpoint, and the
+  // refresher keeps running for other providers.
+  abandoned.get_future().wait();
+  ASSERT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(5));
+}
+
+}  // namespace oidc
+}  // namespace filters
+}  // namespace authservice
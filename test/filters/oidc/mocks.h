@@ -11,6 +11,8 @@ class TokenResponseParserMock final : public TokenResponseParser {
                      absl::optional<TokenResponse>(const std::string &client_id,
                          const std::string &nonce,
                          const std::string &raw));
+
+  using TokenResponseParser::Parse;
 };
 }  // namespace oidc
 }  // namespace filters
@@ -1,10 +1,12 @@
 #include "src/filters/oidc/oidc_filter.h"
+#include <algorithm>
 #include <regex>
 #include "absl/strings/str_join.h"
 #include "google/rpc/code.pb.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "src/common/http/headers.h"
+#include "src/common/metrics/timeline.h"
 #include "test/common/http/mocks.h"
 #include "test/common/session/mocks.h"
 #include "test/filters/oidc/mocks.h"
@@ -477,7 +479,7 @@ void RetrieveTokenWithoutAccessToken(config::oidc::OIDCConfig &oidcConfig, std::
   auto raw_http = common::http::response_t(
       new beast::http::response<beast::http::string_body>());
   raw_http->result(beast::http::status::ok);
-  EXPECT_CALL(*mocked_http, Post(_, _, _, _, _))
+  EXPECT_CALL(*mocked_http, Post(_, _, _, _, _, _))
       .WillOnce(Return(ByMove(std::move(raw_http))));
   OidcFilter filter(common::http::ptr_t(mocked_http), oidcConfig, parser_mock,
                     cryptor_mock);
@@ -553,7 +555,7 @@ TEST_F(OidcFilterTest, RetrieveTokenWithAccessToken) {
   auto raw_http = common::http::response_t(
       new beast::http::response<beast::http::string_body>());
   raw_http->result(beast::http::status::ok);
-  EXPECT_CALL(*mocked_http, Post(_, _, _, _, _))
+  EXPECT_CALL(*mocked_http, Post(_, _, _, _, _, _))
       .WillOnce(Return(ByMove(std::move(raw_http))));
   OidcFilter filter(common::http::ptr_t(mocked_http), config_, parser_mock,
                     cryptor_mock);
@@ -619,7 +621,7 @@ TEST_F(OidcFilterTest, RetrieveTokenMissingAccessToken) {
   auto raw_http = common::http::response_t(
       new beast::http::response<beast::http::string_body>());
   raw_http->result(beast::http::status::ok);
-  EXPECT_CALL(*mocked_http, Post(_, _, _, _, _))
+  EXPECT_CALL(*mocked_http, Post(_, _, _, _, _, _))
       .WillOnce(Return(ByMove(std::move(raw_http))));
   OidcFilter filter(common::http::ptr_t(mocked_http), config_, parser_mock,
                     cryptor_mock);
@@ -869,7 +871,7 @@ TEST_F(OidcFilterTest, RetrieveTokenBrokenPipe) {
   auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
   auto *http_mock = new common::http::http_mock();
   auto raw_http = common::http::response_t();
-  EXPECT_CALL(*http_mock, Post(_, _, _, _, _))
+  EXPECT_CALL(*http_mock, Post(_, _, _, _, _, _))
       .WillOnce(Return(ByMove(std::move(raw_http))));
   OidcFilter filter(common::http::ptr_t(http_mock), config_, parser_mock,
                     cryptor_mock);
@@ -915,7 +917,7 @@ TEST_F(OidcFilterTest, RetrieveTokenInvalidResponse) {
   auto *http_mock = new common::http::http_mock();
   auto raw_http = common::http::response_t(
       (new beast::http::response<beast::http::string_body>()));
-  EXPECT_CALL(*http_mock, Post(_, _, _, _, _))
+  EXPECT_CALL(*http_mock, Post(_, _, _, _, _, _))
       .WillOnce(Return(ByMove(std::move(raw_http))));
   OidcFilter filter(common::http::ptr_t(http_mock), config_, parser_mock,
                     cryptor_mock);
@@ -953,6 +955,130 @@ TEST_F(OidcFilterTest, RetrieveTokenInvalidResponse) {
   );
 }
 
+TEST_F(OidcFilterTest, TryProcessValidIdToken) {
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  OidcFilter filter(common::http::ptr_t(), config_, parser_mock, cryptor_mock);
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("https");
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-id-token-cookie=valid"});
+  EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+      .WillOnce(Return(absl::optional<std::string>("secret")));
+
+  Deferral deferral;
+  auto status = filter.TryProcess(&request, &response, &deferral);
+  ASSERT_TRUE(status.has_value());
+  ASSERT_EQ(*status, google::rpc::Code::OK);
+
+  ASSERT_THAT(
+    response.ok_response().headers(),
+    ContainsHeaders({
+      {common::http::headers::Authorization, StrEq("Bearer secret")},
+    })
+  );
+}
+
+TEST_F(OidcFilterTest, DecryptsEachCookieOnce) {
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  OidcFilter filter(common::http::ptr_t(), config_, parser_mock, cryptor_mock);
+  ::envoy::service::auth::v2::CheckRequest request;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("https");
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-id-token-cookie=valid"});
+  EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+      .WillOnce(Return(absl::optional<std::string>("secret")));
+
+  for (auto i = 0; i < 3; ++i) {
+    ::envoy::service::auth::v2::CheckResponse response;
+    Deferral deferral;
+    auto status = filter.TryProcess(&request, &response, &deferral);
+    ASSERT_TRUE(status.has_value());
+    ASSERT_EQ(*status, google::rpc::Code::OK);
+    ASSERT_THAT(
+      response.ok_response().headers(),
+      ContainsHeaders({
+        {common::http::headers::Authorization, StrEq("Bearer secret")},
+      })
+    );
+  }
+
+  auto stats = filter.GetSessionCache().GetStats();
+  ASSERT_EQ(stats.misses, 1u);
+  ASSERT_EQ(stats.hits, 2u);
+}
+
+TEST_F(OidcFilterTest, TryProcessDefersCallbackRequest) {
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  OidcFilter filter(common::http::ptr_t(), config_, parser_mock, cryptor_mock);
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("https");
+  httpRequest->set_host(callback_host_);
+  std::vector<absl::string_view> parts = {config_.callback().path().c_str(),
+                                          "code=value&state=expectedstate"};
+  httpRequest->set_path(absl::StrJoin(parts, "?"));
+
+  Deferral deferral;
+  auto status = filter.TryProcess(&request, &response, &deferral);
+  // The token exchange needs I/O so must be left to ProcessDeferred, without
+  // having touched the response.
+  ASSERT_FALSE(status.has_value());
+  ASSERT_EQ(response.ByteSizeLong(), 0);
+}
+
+TEST_F(OidcFilterTest, ProcessDecryptsTheCookiesOfACallbackOnce) {
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  auto *http_mock = new common::http::http_mock();
+  EXPECT_CALL(*http_mock, Post(_, _, _, _, _, _))
+      .WillOnce(Return(ByMove(common::http::response_t())));
+  OidcFilter filter(common::http::ptr_t(http_mock), config_, parser_mock,
+                    cryptor_mock);
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("https");
+  httpRequest->set_host(callback_host_);
+  std::vector<absl::string_view> parts = {config_.callback().path().c_str(),
+                                          "code=value&state=expectedstate"};
+  httpRequest->set_path(absl::StrJoin(parts, "?"));
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-state-cookie=valid; "
+       "__Host-cookie-prefix-authservice-id-token-cookie=expired"});
+  EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+      .WillOnce(Return(
+          absl::optional<std::string>("expectedstate;expectednonce")));
+  EXPECT_CALL(*cryptor_mock, Decrypt("expired"))
+      .WillOnce(Return(absl::nullopt));
+
+  common::metrics::Timeline timeline;
+  common::metrics::Timeline::SetCurrent(&timeline);
+  auto code = filter.Process(&request, &response);
+  common::metrics::Timeline::SetCurrent(nullptr);
+  ASSERT_EQ(code, google::rpc::Code::INTERNAL);
+
+  auto decrypted = std::count_if(
+      timeline.Marks().begin(), timeline.Marks().begin() + timeline.Count(),
+      [](const common::metrics::Timeline::Mark &mark) {
+        return mark.stage == common::metrics::Stage::cookies_decrypted;
+      });
+  ASSERT_EQ(decrypted, 1);
+}
+
 }  // namespace oidc
 }  // namespace filters
 }  // namespace authservice
@@ -1,12 +1,277 @@
 #include "src/filters/pipe.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
 #include "gtest/gtest.h"
 
 namespace authservice {
 namespace filters {
+namespace {
+
+// A filter that only succeeds once `expected` requests are inside Process at
+// the same time. If the pipe serialized requests it would time out.
+class RendezvousFilter final : public Filter {
+ private:
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  size_t expected_;
+  size_t arrived_ = 0;
+
+ public:
+  explicit RendezvousFilter(size_t expected) : expected_(expected) {}
+
+  google::rpc::Code Process(
+      const ::envoy::service::auth::v2::CheckRequest *,
+      ::envoy::service::auth::v2::CheckResponse *,
+      const common::utilities::Deadline &,
+      boost::asio::io_context &,
+      boost::asio::yield_context) override {
+    std::unique_lock<std::mutex> lock(mtx_);
+    ++arrived_;
+    cv_.notify_all();
+    if (cv_.wait_for(lock, std::chrono::seconds(10),
+                     [this] { return arrived_ >= expected_; })) {
+      return google::rpc::Code::OK;
+    }
+    return google::rpc::Code::DEADLINE_EXCEEDED;
+  }
+
+  using Filter::Process;
+
+  absl::string_view Name() const override { return "rendezvous"; }
+};
+
+class NamedFilter final : public Filter {
+ private:
+  std::string name_;
+  google::rpc::Code code_;
+  bool synchronous_;
+
+ public:
+  NamedFilter(std::string name, google::rpc::Code code, bool synchronous = true)
+      : name_(std::move(name)), code_(code), synchronous_(synchronous) {}
+
+  // The number of times each method has been called
+  std::atomic<int> tried{0};
+  std::atomic<int> processed{0};
+  std::atomic<int> resumed{0};
+
+  absl::optional<google::rpc::Code> TryProcess(
+      const ::envoy::service::auth::v2::CheckRequest *,
+      ::envoy::service::auth::v2::CheckResponse *response,
+      Deferral *) override {
+    ++tried;
+    if (!synchronous_) {
+      return absl::nullopt;
+    }
+    response->mutable_ok_response()->add_headers()->mutable_header()->set_key(name_);
+    return code_;
+  }
+
+  google::rpc::Code Process(
+      const ::envoy::service::auth::v2::CheckRequest *,
+      ::envoy::service::auth::v2::CheckResponse *,
+      const common::utilities::Deadline &,
+      boost::asio::io_context &,
+      boost::asio::yield_context) override {
+    ++processed;
+    return code_;
+  }
+
+  google::rpc::Code ProcessDeferred(
+      const ::envoy::service::auth::v2::CheckRequest *,
+      ::envoy::service::auth::v2::CheckResponse *,
+      const Deferral &,
+      const common::utilities::Deadline &,
+      boost::asio::io_context &,
+      boost::asio::yield_context) override {
+    ++resumed;
+    return code_;
+  }
+
+  using Filter::Process;
+
+  absl::string_view Name() const override { return name_; }
+};
+
+}  // namespace
+
 TEST(PipeTest, Name) {
   Pipe pipe;
   ASSERT_EQ(pipe.Name().compare("pipe"), 0);
 }
 
+TEST(PipeTest, ProcessEmpty) {
+  Pipe pipe;
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  ASSERT_EQ(pipe.Process(&request, &response), google::rpc::Code::OK);
+  ASSERT_EQ(response.status().code(), google::rpc::Code::OK);
+}
+
+TEST(PipeTest, ProcessStopsAtFirstNonOkFilter) {
+  Pipe pipe;
+  pipe.AddFilter(FilterPtr(new NamedFilter("first", google::rpc::Code::OK)))
+      ->AddFilter(FilterPtr(new NamedFilter("second", google::rpc::Code::UNAUTHENTICATED)))
+      ->AddFilter(FilterPtr(new NamedFilter("third", google::rpc::Code::INTERNAL)));
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  ASSERT_EQ(pipe.Process(&request, &response), google::rpc::Code::UNAUTHENTICATED);
+  ASSERT_EQ(response.status().message(), "second");
+}
+
+TEST(PipeTest, Remove) {
+  Pipe pipe;
+  pipe.AddFilter(FilterPtr(new NamedFilter("deny", google::rpc::Code::PERMISSION_DENIED)))
+      ->AddFilter(FilterPtr(new NamedFilter("deny", google::rpc::Code::PERMISSION_DENIED)))
+      ->AddFilter(FilterPtr(new NamedFilter("allow", google::rpc::Code::OK)));
+  pipe.Remove("deny");
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  ASSERT_EQ(pipe.Process(&request, &response), google::rpc::Code::OK);
+}
+
+TEST(PipeTest, TryProcess) {
+  Pipe pipe;
+  pipe.AddFilter(FilterPtr(new NamedFilter("first", google::rpc::Code::OK)))
+      ->AddFilter(FilterPtr(new NamedFilter("second", google::rpc::Code::PERMISSION_DENIED)));
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  Deferral deferral;
+  auto result = pipe.TryProcess(&request, &response, &deferral);
+  ASSERT_TRUE(result.has_value());
+  ASSERT_EQ(*result, google::rpc::Code::PERMISSION_DENIED);
+  ASSERT_EQ(response.status().message(), "second");
+}
+
+TEST(PipeTest, TryProcessDefersWhenAnyFilterNeedsIo) {
+  auto first = new NamedFilter("first", google::rpc::Code::OK);
+  auto second = new NamedFilter("second", google::rpc::Code::OK, false);
+  auto third = new NamedFilter("third", google::rpc::Code::OK);
+  Pipe pipe;
+  pipe.AddFilter(FilterPtr(first))->AddFilter(FilterPtr(second))->AddFilter(FilterPtr(third));
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  Deferral deferral;
+  ASSERT_FALSE(pipe.TryProcess(&request, &response, &deferral).has_value());
+  ASSERT_EQ(deferral.filter, 1u);
+  // Headers added by the first filter are kept for ProcessDeferred.
+  ASSERT_EQ(response.ok_response().headers_size(), 1);
+  ASSERT_EQ(third->tried, 0);
+
+  boost::asio::io_context ioc;
+  common::utilities::Deadline deadline;
+  google::rpc::Code result = google::rpc::Code::INTERNAL;
+  boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+    result = pipe.ProcessDeferred(&request, &response, deferral, deadline, ioc, yield);
+  });
+  ioc.run();
+  ASSERT_EQ(result, google::rpc::Code::OK);
+  ASSERT_EQ(response.status().code(), google::rpc::Code::OK);
+  ASSERT_EQ(response.ok_response().headers_size(), 1);
+  // Carries on at the filter that deferred rather than starting over.
+  ASSERT_EQ(first->tried, 1);
+  ASSERT_EQ(first->processed, 0);
+  ASSERT_EQ(second->resumed, 1);
+  ASSERT_EQ(second->processed, 0);
+  ASSERT_EQ(third->processed, 1);
+}
+
+TEST(PipeTest, ProcessRunsEachFilterOnceWhenOneNeedsIo) {
+  auto first = new NamedFilter("first", google::rpc::Code::OK);
+  auto second = new NamedFilter("second", google::rpc::Code::OK, false);
+  Pipe pipe;
+  pipe.AddFilter(FilterPtr(first))->AddFilter(FilterPtr(second));
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+
+  // The synchronous Process finishes deferred requests in a co-routine.
+  ASSERT_EQ(pipe.Process(&request, &response), google::rpc::Code::OK);
+  ASSERT_EQ(first->tried + first->processed + first->resumed, 1);
+  ASSERT_EQ(second->tried, 1);
+  ASSERT_EQ(second->resumed, 1);
+  ASSERT_EQ(second->processed, 0);
+}
+
+TEST(PipeTest, ProcessStopsOnceTheDeadlineExpires) {
+  Pipe pipe;
+  pipe.AddFilter(FilterPtr(new NamedFilter("first", google::rpc::Code::OK, false)));
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  boost::asio::io_context ioc;
+  google::rpc::Code result = google::rpc::Code::OK;
+
+  common::utilities::Deadline expired(std::chrono::steady_clock::now());
+  boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+    result = pipe.Process(&request, &response, expired, ioc, yield);
+  });
+  ioc.run();
+  ASSERT_EQ(result, google::rpc::Code::DEADLINE_EXCEEDED);
+
+  common::utilities::Deadline cancelled;
+  cancelled.Cancel();
+  ioc.restart();
+  boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+    result = pipe.Process(&request, &response, cancelled, ioc, yield);
+  });
+  ioc.run();
+  ASSERT_EQ(result, google::rpc::Code::CANCELLED);
+}
+
+TEST(PipeTest, ConcurrentProcessIsNotSerialized) {
+  const size_t concurrency = 16;
+  Pipe pipe;
+  pipe.AddFilter(FilterPtr(new RendezvousFilter(concurrency)));
+
+  std::vector<google::rpc::Code> results(concurrency);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < concurrency; ++i) {
+    threads.emplace_back([&pipe, &results, i] {
+      ::envoy::service::auth::v2::CheckRequest request;
+      ::envoy::service::auth::v2::CheckResponse response;
+      results[i] = pipe.Process(&request, &response);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto result : results) {
+    ASSERT_EQ(result, google::rpc::Code::OK);
+  }
+}
+
+TEST(PipeTest, ConcurrentProcessAndModify) {
+  const size_t readers = 8;
+  const size_t iterations = 2000;
+  Pipe pipe;
+  pipe.AddFilter(FilterPtr(new NamedFilter("allow", google::rpc::Code::OK)));
+
+  std::atomic<bool> failed(false);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < readers; ++i) {
+    threads.emplace_back([&pipe, &failed] {
+      for (size_t j = 0; j < iterations; ++j) {
+        ::envoy::service::auth::v2::CheckRequest request;
+        ::envoy::service::auth::v2::CheckResponse response;
+        if (pipe.Process(&request, &response) != google::rpc::Code::OK) {
+          failed = true;
+        }
+      }
+    });
+  }
+  // Writers publish new snapshots while readers are processing.
+  threads.emplace_back([&pipe] {
+    for (size_t j = 0; j < iterations; ++j) {
+      pipe.AddFilter(FilterPtr(new NamedFilter("transient", google::rpc::Code::OK)));
+      pipe.Remove("transient");
+    }
+  });
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ASSERT_FALSE(failed);
+}
+
 }  // namespace filters
 }  // namespace authservice
@@ -0,0 +1,176 @@
+#include "src/service/async_service_impl.h"
+#include <chrono>
+#include <future>
+#include <thread>
+#include "bench/requests.h"
+#include "gtest/gtest.h"
+#include "src/config/get_config.h"
+
+namespace authservice {
+namespace service {
+namespace {
+const char *jwks = R"({"keys":[{"kty":"RSA","alg":"RS256","use":"sig","kid":"key1","e":"AQAB","n":"nzyis1ZjfNB0bBgKFMSvvkTtwlvBsaJq7S5wA-kzeVOVpVWwkWdVha4s38XM_pa_yr47av7-z3VTmvDRyAHcaT92whREFpLv9cj5lTeJSibyr_Mrm_YtjCZVWgaOYIhwrXwKLqPr_11inWsAkfIytvHWTxZYEcXLgAXFuUuaS3uF9gEiNQwzGTU1v0FqkqTBr4B8nW3HCN47XUu0t8Y0e-lf4s4OxQawWD79J9_5d3Ry0vbV3Am1FtGJiJvOwRsIfVChDpYStTcHTCMqtvWbV6L11BWkpzGXSW4Hv43qa-GSYOD2QU68Mb59oSk2OB-BtOLpJofmbGEGgvmwyCI9Mw"}]})";
+
+/**
+ * An OIDC Provider that accepts a connection and never answers on it, so that exchanging an authorization code hangs
+ * until the request is abandoned.
+ */
+class UnresponsiveIdp {
+ public:
+  UnresponsiveIdp()
+      : acceptor_(ioc_, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)), socket_(ioc_) {
+    acceptor_.async_accept(socket_, [this](const boost::system::error_code &ec) {
+      if (!ec) {
+        Read();
+      }
+    });
+    thread_ = std::thread([this]() { ioc_.run(); });
+  }
+
+  ~UnresponsiveIdp() {
+    ioc_.stop();
+    thread_.join();
+  }
+
+  uint16_t Port() const { return acceptor_.local_endpoint().port(); }
+
+  /**
+   * Wait for the client to close the connection.
+   * @return whether it did within the timeout.
+   */
+  bool WaitForClose(std::chrono::steady_clock::duration timeout) {
+    return closed_.get_future().wait_for(timeout) == std::future_status::ready;
+  }
+
+ private:
+  void Read() {
+    socket_.async_read_some(boost::asio::buffer(buffer_), [this](const boost::system::error_code &ec, size_t) {
+      if (ec) {
+        closed_.set_value();
+        return;
+      }
+      Read();
+    });
+  }
+
+  boost::asio::io_context ioc_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+  boost::asio::ip::tcp::socket socket_;
+  char buffer_[1024];
+  std::promise<void> closed_;
+  std::thread thread_;
+};
+
+// A port nothing is listening on.
+int FreePort() {
+  boost::asio::io_context ioc;
+  boost::asio::ip::tcp::acceptor acceptor(
+      ioc, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+  return acceptor.local_endpoint().port();
+}
+
+// The test configuration, listening on a free port, with its token endpoint on the given port.
+std::unique_ptr<config::Config> Config(int idp_port) {
+  auto config = config::GetConfig("test/fixtures/valid-config.json");
+  config->set_listen_port(FreePort());
+  config->set_threads(1);
+  auto oidc = config->mutable_chains(0)->mutable_filters(0)->mutable_oidc();
+  oidc->mutable_token()->set_hostname("127.0.0.1");
+  oidc->mutable_token()->set_port(idp_port);
+  oidc->set_jwks(jwks);
+  return config;
+}
+
+// Wait for the service to count an abandoned call.
+AsyncAuthServiceImpl::Stats WaitForAbandonedCall(const AsyncAuthServiceImpl &service) {
+  auto stats = service.GetStats();
+  for (int i = 0; i < 500 && stats.deadline_exceeded + stats.cancelled == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    stats = service.GetStats();
+  }
+  return stats;
+}
+
+/**
+ * Serves the given configuration, making callback requests whose authorization code the IdP never exchanges.
+ */
+class Server {
+ public:
+  explicit Server(const config::Config &config)
+      : service_(config),
+        requests_(config),
+        stub_(Authorization::NewStub(grpc::CreateChannel(config::GetConfiguredAddress(config),
+                                                         grpc::InsecureChannelCredentials()))) {
+    runner_ = std::thread([this]() { service_.Run(); });
+  }
+
+  ~Server() {
+    service_.Shutdown();
+    runner_.join();
+  }
+
+  grpc::Status Callback(grpc::ClientContext &context, CheckResponse &response) {
+    auto request = requests_.Build(bench::RequestKind::callback);
+    return stub_->Check(&context, request, &response);
+  }
+
+  const AsyncAuthServiceImpl &Service() const { return service_; }
+
+ private:
+  AsyncAuthServiceImpl service_;
+  bench::RequestFactory requests_;
+  std::unique_ptr<Authorization::StubInterface> stub_;
+  std::thread runner_;
+};
+}  // namespace
+
+TEST(AsyncAuthServiceImplTest, AbandonsCallsWhoseDeadlinePassed) {
+  UnresponsiveIdp idp;
+  Server server(*Config(idp.Port()));
+
+  grpc::ClientContext context;
+  context.set_deadline(std::chrono::system_clock::now() + std::chrono::milliseconds(500));
+  CheckResponse response;
+  ASSERT_EQ(server.Callback(context, response).error_code(), grpc::StatusCode::DEADLINE_EXCEEDED);
+
+  // Well within the token endpoint's request timeout.
+  ASSERT_TRUE(idp.WaitForClose(std::chrono::seconds(5)));
+  auto stats = WaitForAbandonedCall(server.Service());
+  ASSERT_EQ(stats.deadline_exceeded, 1u);
+  ASSERT_EQ(stats.cancelled, 0u);
+}
+
+TEST(AsyncAuthServiceImplTest, AbandonsCancelledCalls) {
+  UnresponsiveIdp idp;
+  Server server(*Config(idp.Port()));
+
+  grpc::ClientContext context;
+  std::thread canceller([&context]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    context.TryCancel();
+  });
+  CheckResponse response;
+  auto status = server.Callback(context, response);
+  canceller.join();
+  ASSERT_EQ(status.error_code(), grpc::StatusCode::CANCELLED);
+
+  ASSERT_TRUE(idp.WaitForClose(std::chrono::seconds(5)));
+  auto stats = WaitForAbandonedCall(server.Service());
+  ASSERT_EQ(stats.deadline_exceeded, 0u);
+  ASSERT_EQ(stats.cancelled, 1u);
+}
+
+TEST(AsyncAuthServiceImplTest, DeniesRequestsTheFiltersFailed) {
+  // Nothing listens on the token endpoint, so exchanging the authorization code fails.
+  Server server(*Config(FreePort()));
+
+  grpc::ClientContext context;
+  context.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(10));
+  CheckResponse response;
+  // The call succeeds, carrying the decision, so that an Envoy allowing requests when the service fails still denies it.
+  ASSERT_TRUE(server.Callback(context, response).ok());
+  ASSERT_EQ(response.status().code(), google::rpc::Code::INTERNAL);
+}
+
+}  // namespace service
+}  // namespace authservice
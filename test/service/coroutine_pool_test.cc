@@ -0,0 +1,73 @@
+#include "src/service/coroutine_pool.h"
+#include <atomic>
+#include <thread>
+#include "gtest/gtest.h"
+
+namespace authservice {
+namespace service {
+
+TEST(CoroutinePoolTest, RunsPostedJobs) {
+  boost::asio::io_context io_context;
+  CoroutinePool pool(io_context, 0);
+  auto work = std::make_shared<boost::asio::io_context::work>(io_context);
+  std::vector<std::thread> threads;
+  for (auto i = 0; i < 4; ++i) {
+    threads.emplace_back([&io_context]() { io_context.run(); });
+  }
+
+  std::atomic<int> ran(0);
+  for (auto i = 0; i < 1000; ++i) {
+    pool.Post([&ran](boost::asio::yield_context) { ++ran; });
+  }
+
+  pool.Stop();
+  work.reset();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(ran, 1000);
+}
+
+TEST(CoroutinePoolTest, ReusesIdleCoroutines) {
+  boost::asio::io_context io_context;
+  CoroutinePool pool(io_context, 0);
+
+  auto ran = 0;
+  for (auto i = 0; i < 10; ++i) {
+    pool.Post([&ran](boost::asio::yield_context) { ++ran; });
+    io_context.poll();
+  }
+
+  ASSERT_EQ(ran, 10);
+  ASSERT_EQ(pool.Size(), 1u);
+
+  pool.Stop();
+  io_context.run();
+}
+
+TEST(CoroutinePoolTest, GrowsWhenAllCoroutinesAreBusy) {
+  boost::asio::io_context io_context;
+  CoroutinePool pool(io_context, 0);
+
+  // Each job suspends until the timer is cancelled, so both must be running at once.
+  boost::asio::steady_timer blocker(io_context, boost::asio::steady_timer::time_point::max());
+  auto finished = 0;
+  for (auto i = 0; i < 2; ++i) {
+    pool.Post([&blocker, &finished](boost::asio::yield_context yield) {
+      boost::system::error_code ec;
+      blocker.async_wait(yield[ec]);
+      ++finished;
+    });
+  }
+  io_context.poll();
+  ASSERT_EQ(pool.Size(), 2u);
+  ASSERT_EQ(finished, 0);
+
+  blocker.cancel();
+  pool.Stop();
+  io_context.run();
+  ASSERT_EQ(finished, 2);
+}
+
+}  // namespace service
+}  // namespace authservice
@@ -1,6 +1,11 @@
 #include "src/service/service_impl.h"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include "src/common/metrics/timeline.h"
 #include "src/config/get_config.h"
 #include "gtest/gtest.h"
+#include "test/common/http/mocks.h"
 
 namespace authservice {
 namespace service {
@@ -42,5 +47,137 @@ TEST(ServiceImplTest, CheckMatchedRequest) {
   EXPECT_TRUE(status.ok());
 }
 
+TEST(ServiceImplTest, TryCheckMatchedRequestWithoutIo) {
+  AuthServiceImpl service(
+          *config::GetConfig("test/fixtures/valid-config.json"));
+
+  ::envoy::service::auth::v2::CheckResponse response;
+  ::envoy::service::auth::v2::CheckRequest request;
+
+  request.mutable_attributes()->mutable_request()->mutable_http()->set_scheme(
+      "https");
+  auto request_headers = request.mutable_attributes()
+      ->mutable_request()
+      ->mutable_http()
+      ->mutable_headers();
+  request_headers->insert({"x-tenant-identifier", "tenant1"});
+
+  // Redirecting an unauthenticated request to the IdP needs no I/O.
+  auto status = service.TryCheck(nullptr, &request, &response);
+  ASSERT_TRUE(status.has_value());
+  EXPECT_TRUE(status->ok());
+  EXPECT_EQ(response.status().code(), google::rpc::Code::UNAUTHENTICATED);
+}
+
+TEST(ServiceImplTest, CheckCarriesOnFromTryCheck) {
+  AuthServiceImpl service(
+          *config::GetConfig("test/fixtures/valid-config.json"));
+
+  ::envoy::service::auth::v2::CheckResponse response;
+  ::envoy::service::auth::v2::CheckRequest request;
+  auto http = request.mutable_attributes()->mutable_request()->mutable_http();
+  http->set_scheme("https");
+  http->set_host("google4");
+  http->set_path("/path4?code=value&state=expectedstate");
+  http->mutable_headers()->insert({"x-tenant-identifier", "tenant1"});
+
+  common::metrics::Timeline timeline;
+  common::metrics::Timeline::SetCurrent(&timeline);
+  // Exchanging the authorization code needs I/O.
+  AuthServiceImpl::Deferred deferred;
+  ASSERT_FALSE(service.TryCheck(nullptr, &request, &response, &deferred).has_value());
+  ASSERT_NE(deferred.chains, nullptr);
+  // The timeline is carried on in the deferral rather than left current.
+  common::metrics::Timeline::SetCurrent(nullptr);
+
+  // Abandoned before the exchange starts, so that no I/O is attempted.
+  common::utilities::Deadline deadline;
+  deadline.Cancel();
+  boost::asio::io_context ioc;
+  ::grpc::Status status;
+  boost::asio::spawn(ioc, [&](boost::asio::yield_context yield) {
+    status = service.Check(nullptr, &request, &response, deferred, deadline, ioc, yield);
+  });
+  ioc.run();
+  EXPECT_EQ(status.error_code(), ::grpc::StatusCode::CANCELLED);
+  EXPECT_EQ(common::metrics::Timeline::Current(), nullptr);
+
+  // The request was matched once, by TryCheck, and the check recorded as processed on its timeline.
+  auto Marked = [&timeline](common::metrics::Stage stage) {
+    return std::count_if(
+        timeline.Marks().begin(), timeline.Marks().begin() + timeline.Count(),
+        [stage](const common::metrics::Timeline::Mark &mark) { return mark.stage == stage; });
+  };
+  EXPECT_EQ(Marked(common::metrics::Stage::matched), 1);
+  EXPECT_EQ(Marked(common::metrics::Stage::processed), 1);
+}
+
+TEST(ServiceImplTest, ReloadReplacesChains) {
+  auto config = config::GetConfig("test/fixtures/valid-config.json");
+  AuthServiceImpl service(*config);
+
+  ::envoy::service::auth::v2::CheckRequest request;
+  request.mutable_attributes()->mutable_request()->mutable_http()->set_scheme(
+      "https");
+  auto request_headers = request.mutable_attributes()
+      ->mutable_request()
+      ->mutable_http()
+      ->mutable_headers();
+  request_headers->insert({"x-tenant-identifier", "tenant1"});
+
+  // The chain no longer matches the request once the new configuration is published.
+  config->mutable_chains(0)->mutable_match()->set_equality("tenant2");
+  service.Reload(*config);
+
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto status = service.TryCheck(nullptr, &request, &response);
+  ASSERT_TRUE(status.has_value());
+  EXPECT_TRUE(status->ok());
+  EXPECT_FALSE(response.has_status());
+}
+
+TEST(ServiceImplTest, ReloadKeepsUnchangedChains) {
+  // Each chain built fetches its key set once, from the jwks_uri of its configuration.
+  std::mutex mutex;
+  std::map<std::string, int> fetches;
+  auto http = std::make_shared<common::http::http_mock>();
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_, ::testing::_, ::testing::_, ::testing::_))
+      .WillRepeatedly(::testing::Invoke(
+          [&](const config::common::Endpoint &endpoint, const std::map<absl::string_view, absl::string_view> &,
+              const common::utilities::Deadline &, boost::asio::io_context &, boost::asio::yield_context) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++fetches[endpoint.path()];
+            return nullptr;
+          }));
+  auto Fetches = [&](const std::string &path) {
+    for (int i = 0; i < 500; ++i) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fetches[path] > 0) {
+          return fetches[path];
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return 0;
+  };
+
+  auto config = config::GetConfig("test/fixtures/valid-config.json");
+  auto jwks_uri = config->mutable_chains(0)->mutable_filters(0)->mutable_oidc()->mutable_jwks_uri();
+  jwks_uri->set_scheme("https");
+  jwks_uri->set_hostname("acme-idp.tld");
+  jwks_uri->set_port(443);
+  jwks_uri->set_path("/jwks");
+  AuthServiceImpl service(*config, http);
+  ASSERT_EQ(Fetches("/jwks"), 1);
+
+  service.Reload(*config);
+  jwks_uri->set_path("/rotated");
+  service.Reload(*config);
+  ASSERT_EQ(Fetches("/rotated"), 1);
+  // The first reload kept the chain, and the second rebuilt it.
+  EXPECT_EQ(Fetches("/jwks"), 1);
+}
+
 }  // namespace service
 }  // namespace authservice